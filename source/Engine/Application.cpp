@@ -61,6 +61,7 @@ public:
 #include <Engine/Diagnostics/Memory.h>
 #include <Engine/Diagnostics/MemoryPools.h>
 #include <Engine/Filesystem/Directory.h>
+#include <Engine/Rendering/TextureAtlas.h>
 #include <Engine/ResourceTypes/ResourceManager.h>
 #include <Engine/TextFormats/XML/XMLParser.h>
 #include <Engine/TextFormats/XML/XMLNode.h>
@@ -69,6 +70,10 @@ public:
 #include <Engine/Media/MediaSource.h>
 #include <Engine/Media/MediaPlayer.h>
 
+#ifdef USING_OPENGL
+    #include <Engine/Rendering/GL/GLRenderer.h>
+#endif
+
 #ifdef IOS
 extern "C" {
     #include <Engine/Platforms/iOS/MediaPlayer.h>
@@ -418,6 +423,13 @@ PUBLIC STATIC void Application::GetPerformanceSnapshot() {
             // double RenderTime;
         }
 
+        #ifdef USING_OPENGL
+        if (Graphics::Renderer && !strcmp(Graphics::Renderer, "opengl")) {
+            Log::Print(Log::LOG_IMPORTANT, "Renderer Performance Snapshot:");
+            GLRenderer::PrintBatchStats();
+        }
+        #endif
+
         // Object Performance Snapshot
         double totalUpdateEarly = 0.0;
         double totalUpdate = 0.0;
@@ -515,6 +527,7 @@ PRIVATE STATIC void Application::Restart() {
         Graphics::DisposeTexture(tex);
     });
     Graphics::SpriteSheetTextureMap->Clear();
+    TextureAtlas::Dispose();
 
     ScriptManager::LoadAllClasses = false;
     ScriptEntity::DisableAutoAnimate = false;
@@ -1205,8 +1218,9 @@ PUBLIC STATIC void Application::Run(int argc, char* args[]) {
 }
 
 PUBLIC STATIC void Application::Cleanup() {
-    ResourceManager::Dispose();
+    // Audio streams may still be reading from the data packs
     AudioManager::Dispose();
+    ResourceManager::Dispose();
     InputManager::Dispose();
 
     Graphics::Dispose();
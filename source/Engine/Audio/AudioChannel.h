@@ -21,6 +21,10 @@ struct AudioChannel {
     float          Volume = 0.0f;
     void*          Origin = nullptr;
 
+    bool           Active = false;
+    int            Prev[ChannelList_Count];
+    int            Next[ChannelList_Count];
+
     ~AudioChannel() {
         delete Playback;
         Playback = nullptr;
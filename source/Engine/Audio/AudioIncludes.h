@@ -2,6 +2,15 @@
 #define ENGINE_AUDIO_AUDIOINCLUDES_H
 
 #define AUDIO_FIRST_LOAD_SAMPLE_BOOST 4
+// How much the decoder thread keeps decoded ahead of a streaming playback,
+// in multiples of what the playback reads at once
+#define AUDIO_DECODE_AHEAD 4
+
+// Samples read around each output sample when resampling (the sinc filter
+// uses all of them, linear interpolation only the two in the middle)
+#define AUDIO_RESAMPLE_TAPS 8
+#define AUDIO_RESAMPLE_HISTORY (AUDIO_RESAMPLE_TAPS / 2 - 1)
+#define AUDIO_RESAMPLE_LOOKAHEAD (AUDIO_RESAMPLE_TAPS / 2)
 
 enum {
     MusicFade_None,
@@ -9,4 +18,15 @@ enum {
     MusicFade_In
 };
 
+// Must be a power of two
+#define AUDIO_CHANNEL_BUCKETS 256
+
+// The lists each sound channel is linked into
+enum {
+    ChannelList_State, // Active or free channels
+    ChannelList_Sound, // Channels in the same sound bucket
+    ChannelList_Origin, // Channels in the same origin bucket
+    ChannelList_Count
+};
+
 #endif /* ENGINE_AUDIO_AUDIOINCLUDES_H */
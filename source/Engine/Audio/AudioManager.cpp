@@ -12,12 +12,17 @@ public:
     static bool                 AudioEnabled;
 
     static Uint8                BytesPerSample;
-    static Uint8*               MixBuffer;
-    static size_t               MixBufferSize;
+    static float*               MixBus;
+    static size_t               MixBusSize;
+    static int                  ResampleMode;
 
     static deque<AudioChannel*> MusicStack;
     static AudioChannel*        SoundArray;
     static int                  SoundArrayLength;
+    static int                  ActiveChannels;
+    static int                  FreeChannels;
+    static int                  SoundBuckets[AUDIO_CHANNEL_BUCKETS];
+    static int                  OriginBuckets[AUDIO_CHANNEL_BUCKETS];
 
     static float                MasterVolume;
     static float                MusicVolume;
@@ -25,15 +30,28 @@ public:
 
     static float                LowPassFilter;
 
+    static int                  PreDecodeLimit;
+
     static Uint8*               AudioQueue;
     static size_t               AudioQueueSize;
     static size_t               AudioQueueMaxSize;
 
+    static SDL_Thread*          DecoderThread;
+    static SDL_sem*             DecoderWake;
+    static bool                 DecoderQuit;
+    static vector<AudioPlayback*> StreamingPlaybacks;
+    static vector<AudioPlayback*> StartedPlaybacks;
+    static vector<AudioChannel*> FinishedMusic;
+
     enum {
         REQUEST_EOF = 0,
         REQUEST_ERROR = -1,
         REQUEST_CONVERTING = -2,
     };
+    enum {
+        RESAMPLE_LINEAR,
+        RESAMPLE_SINC,
+    };
 };
 #endif
 
@@ -43,17 +61,30 @@ public:
 #include <Engine/Diagnostics/Log.h>
 #include <Engine/Diagnostics/Memory.h>
 
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define AUDIO_SIMD_SSE2
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define AUDIO_SIMD_NEON
+    #include <arm_neon.h>
+#endif
+
 SDL_AudioDeviceID    AudioManager::Device;
 SDL_AudioSpec        AudioManager::DeviceFormat;
 bool                 AudioManager::AudioEnabled = false;
 
 Uint8                AudioManager::BytesPerSample;
-Uint8*               AudioManager::MixBuffer;
-size_t               AudioManager::MixBufferSize;
+float*               AudioManager::MixBus = NULL;
+size_t               AudioManager::MixBusSize = 0;
+int                  AudioManager::ResampleMode = AudioManager::RESAMPLE_LINEAR;
 
 deque<AudioChannel*> AudioManager::MusicStack;
 AudioChannel*        AudioManager::SoundArray = NULL;
 int                  AudioManager::SoundArrayLength = 512;
+int                  AudioManager::ActiveChannels = -1;
+int                  AudioManager::FreeChannels = -1;
+int                  AudioManager::SoundBuckets[AUDIO_CHANNEL_BUCKETS];
+int                  AudioManager::OriginBuckets[AUDIO_CHANNEL_BUCKETS];
 
 float                AudioManager::MasterVolume = 1.0f;
 float                AudioManager::MusicVolume = 1.0f;
@@ -61,10 +92,19 @@ float                AudioManager::SoundVolume = 1.0f;
 
 float                AudioManager::LowPassFilter = 0.0f;
 
+int                  AudioManager::PreDecodeLimit = 1024;
+
 Uint8*               AudioManager::AudioQueue = NULL;
 size_t               AudioManager::AudioQueueSize = 0;
 size_t               AudioManager::AudioQueueMaxSize = 0;
 
+SDL_Thread*          AudioManager::DecoderThread = NULL;
+SDL_sem*             AudioManager::DecoderWake = NULL;
+bool                 AudioManager::DecoderQuit = false;
+vector<AudioPlayback*> AudioManager::StreamingPlaybacks;
+vector<AudioPlayback*> AudioManager::StartedPlaybacks;
+vector<AudioChannel*> AudioManager::FinishedMusic;
+
 enum {
     FILTER_TYPE_LOW_PASS,
     FILTER_TYPE_HIGH_PASS,
@@ -85,6 +125,40 @@ Sint16 mZy[2 * 2]; // 2 per channel
 float  mZxF[2 * 2]; // 2 per channel
 float  mZyF[2 * 2]; // 2 per channel
 
+// Windowed sinc filter for resampling, with the taps for each fraction of a
+// sample. Each tap is stored twice, so it can be multiplied with a left and
+// right sample at once.
+#define SINC_PHASES 256
+#define SINC_PHASE_SHIFT 8
+float  SincTable[SINC_PHASES * AUDIO_RESAMPLE_TAPS * 2];
+
+PRIVATE STATIC void  AudioManager::CalculateSincTable() {
+    double radius = AUDIO_RESAMPLE_TAPS / 2;
+    for (int phase = 0; phase < SINC_PHASES; phase++) {
+        double fraction = (double)phase / SINC_PHASES;
+        double taps[AUDIO_RESAMPLE_TAPS];
+        double sum = 0.0;
+        for (int t = 0; t < AUDIO_RESAMPLE_TAPS; t++) {
+            // Lanczos window
+            double x = (t - AUDIO_RESAMPLE_HISTORY) - fraction;
+            double value = 1.0;
+            if (x != 0.0) {
+                double px = M_PI * x;
+                value = sin(px) / px * sin(px / radius) / (px / radius);
+            }
+            taps[t] = value;
+            sum += value;
+        }
+
+        // Normalize so that each phase keeps the volume the same
+        float* out = &SincTable[phase * AUDIO_RESAMPLE_TAPS * 2];
+        for (int t = 0; t < AUDIO_RESAMPLE_TAPS; t++) {
+            out[t * 2 + 0] = (float)(taps[t] / sum);
+            out[t * 2 + 1] = (float)(taps[t] / sum);
+        }
+    }
+}
+
 PUBLIC STATIC void   AudioManager::CalculateCoeffs() {
     double theta = 2.0 * M_PI * mNormalizedFreq; // normalized frequency has been precalculated as fc/fs
     double d = 0.5 * (1.0 / mQuality) * sin(theta);
@@ -154,10 +228,23 @@ PUBLIC STATIC float  AudioManager::ProcessSampleFloat(float inSample, int channe
 
 PUBLIC STATIC void   AudioManager::Init() {
     CalculateCoeffs();
+    CalculateSincTable();
+
+    // In kilobytes of samples in the device format
+    Application::Settings->GetInteger("audio", "preDecodeLimit", &PreDecodeLimit);
+
+    char resampler[16];
+    if (Application::Settings->GetString("audio", "resampler", resampler, sizeof resampler)) {
+        if (!strcmp(resampler, "sinc"))
+            ResampleMode = RESAMPLE_SINC;
+        else
+            ResampleMode = RESAMPLE_LINEAR;
+    }
 
     SoundArray = (AudioChannel*)Memory::Calloc(SoundArrayLength, sizeof(AudioChannel));
     for (int i = 0; i < SoundArrayLength; i++)
         SoundArray[i].Paused = true;
+    InitChannelLists();
 
     SDL_AudioSpec Want;
     memset(&Want, 0, sizeof(Want));
@@ -204,15 +291,189 @@ PUBLIC STATIC void   AudioManager::Init() {
 
     BytesPerSample = ((DeviceFormat.format & 0xFF) >> 3) * DeviceFormat.channels;
 
-    if (DeviceFormat.channels == 2) {
-        MixBufferSize = DeviceFormat.samples;
-        MixBuffer = (Uint8*)Memory::Malloc(MixBufferSize * BytesPerSample);
-    }
+    MixBusSize = DeviceFormat.samples * DeviceFormat.channels;
+    MixBus = (float*)Memory::TrackedMalloc("AudioManager::MixBus", MixBusSize * sizeof(float));
 
     // AudioQueueMaxSize = DeviceFormat.samples * DeviceFormat.channels * (SDL_AUDIO_BITSIZE(DeviceFormat.format) >> 3);
     AudioQueueMaxSize = 0x1000;
     AudioQueueSize    = 0;
     AudioQueue        = (Uint8*)Memory::Calloc(8, AudioQueueMaxSize);
+
+    if (AudioEnabled)
+        StartDecoder();
+}
+
+// Decoder thread
+// Music is streamed, and decoding it in the audio callback takes long
+// enough to make it miss its deadline. The decoder thread decodes ahead
+// for every streaming playback instead (see AudioPlayback::StartStreaming),
+// and wakes up whenever the callback reads from one of them.
+//
+// Each streaming playback has a SoundFormat of its own, which only this
+// thread touches once it streams, and only this thread uses the list of
+// streaming playbacks, so decoding never holds a lock anyone else waits on.
+// New streaming playbacks and finished music are handed over in lists kept
+// under the audio device lock, which this thread only holds long enough to
+// swap them out. Streaming music is only ever deleted here (see
+// DeleteMusic), so a playback can't go away while it's being decoded.
+PRIVATE STATIC int   AudioManager::DecoderThreadFunc(void* data) {
+    vector<AudioChannel*> finished;
+    vector<AudioPlayback*> started;
+    while (!DecoderQuit) {
+        SDL_SemWaitTimeout(DecoderWake, 20);
+
+        AudioManager::Lock();
+        finished.swap(FinishedMusic);
+        started.swap(StartedPlaybacks);
+        AudioManager::Unlock();
+
+        StreamingPlaybacks.insert(StreamingPlaybacks.end(), started.begin(), started.end());
+        started.clear();
+        for (size_t i = 0; i < finished.size(); i++)
+            delete finished[i];
+        finished.clear();
+
+        bool decoded = true;
+        while (decoded && !DecoderQuit) {
+            decoded = false;
+            for (size_t i = 0; i < StreamingPlaybacks.size(); i++) {
+                if (StreamingPlaybacks[i]->Decode())
+                    decoded = true;
+            }
+        }
+    }
+    return 0;
+}
+PRIVATE STATIC void  AudioManager::StartDecoder() {
+    DecoderWake = SDL_CreateSemaphore(0);
+    if (!DecoderWake) {
+        Log::Print(Log::LOG_ERROR, "Could not create audio decoder thread: %s", SDL_GetError());
+        return;
+    }
+
+    // So the callback doesn't have to allocate when music ends
+    FinishedMusic.reserve(16);
+
+    DecoderQuit = false;
+    DecoderThread = SDL_CreateThread(AudioManager::DecoderThreadFunc, "AudioManager::DecoderThreadFunc", NULL);
+    if (!DecoderThread)
+        Log::Print(Log::LOG_ERROR, "Could not create audio decoder thread: %s", SDL_GetError());
+}
+PRIVATE STATIC void  AudioManager::StopDecoder() {
+    if (DecoderThread) {
+        DecoderQuit = true;
+        SDL_SemPost(DecoderWake);
+        SDL_WaitThread(DecoderThread, NULL);
+        DecoderThread = NULL;
+    }
+
+    StreamingPlaybacks.insert(StreamingPlaybacks.end(), StartedPlaybacks.begin(), StartedPlaybacks.end());
+    StartedPlaybacks.clear();
+
+    for (size_t i = 0; i < FinishedMusic.size(); i++)
+        delete FinishedMusic[i];
+    FinishedMusic.clear();
+    StreamingPlaybacks.clear();
+
+    if (DecoderWake) {
+        SDL_DestroySemaphore(DecoderWake);
+        DecoderWake = NULL;
+    }
+}
+PUBLIC STATIC void   AudioManager::WakeDecoder() {
+    if (DecoderWake)
+        SDL_SemPost(DecoderWake);
+}
+// The audio device has to be locked.
+PUBLIC STATIC void   AudioManager::AddStreamingPlayback(AudioPlayback* playback) {
+    StartedPlaybacks.push_back(playback);
+    AudioManager::WakeDecoder();
+}
+// Only called on the decoder thread, or once it has stopped.
+PUBLIC STATIC void   AudioManager::RemoveStreamingPlayback(AudioPlayback* playback) {
+    for (size_t i = 0; i < StreamingPlaybacks.size(); i++) {
+        if (StreamingPlaybacks[i] == playback) {
+            StreamingPlaybacks.erase(StreamingPlaybacks.begin() + i);
+            break;
+        }
+    }
+}
+
+// Sound channels
+// Every channel is either in the active list (it has a sound that hasn't
+// stopped, paused or not) or in the free list, so the callback only goes
+// through the active ones and a free one can be found right away. Active
+// channels are also hashed into fixed buckets by their sound and by their
+// origin, so that looking up the channels playing a sound, or started by an
+// entity, only goes through the few that share its bucket.
+static void LinkChannel(AudioChannel* channels, int index, int list, int* head) {
+    AudioChannel* channel = &channels[index];
+    channel->Prev[list] = -1;
+    channel->Next[list] = *head;
+    if (*head != -1)
+        channels[*head].Prev[list] = index;
+    *head = index;
+}
+static void UnlinkChannel(AudioChannel* channels, int index, int list, int* head) {
+    AudioChannel* channel = &channels[index];
+    if (channel->Prev[list] != -1)
+        channels[channel->Prev[list]].Next[list] = channel->Next[list];
+    else
+        *head = channel->Next[list];
+    if (channel->Next[list] != -1)
+        channels[channel->Next[list]].Prev[list] = channel->Prev[list];
+
+    channel->Prev[list] = -1;
+    channel->Next[list] = -1;
+}
+
+PRIVATE STATIC Uint32 AudioManager::GetChannelBucket(void* key) {
+    uintptr_t value = (uintptr_t)key;
+    return (Uint32)(value ^ (value >> 8) ^ (value >> 16)) & (AUDIO_CHANNEL_BUCKETS - 1);
+}
+PRIVATE STATIC void  AudioManager::InitChannelLists() {
+    ActiveChannels = -1;
+    FreeChannels = -1;
+    for (int i = 0; i < AUDIO_CHANNEL_BUCKETS; i++) {
+        SoundBuckets[i] = -1;
+        OriginBuckets[i] = -1;
+    }
+
+    // Linked backwards, so the first channels are handed out first
+    for (int i = SoundArrayLength - 1; i >= 0; i--) {
+        SoundArray[i].Active = false;
+        for (int list = 0; list < ChannelList_Count; list++) {
+            SoundArray[i].Prev[list] = -1;
+            SoundArray[i].Next[list] = -1;
+        }
+        LinkChannel(SoundArray, i, ChannelList_State, &FreeChannels);
+    }
+}
+PRIVATE STATIC void  AudioManager::ActivateChannel(int index) {
+    AudioChannel* channel = &SoundArray[index];
+    if (channel->Active)
+        return;
+
+    UnlinkChannel(SoundArray, index, ChannelList_State, &FreeChannels);
+    LinkChannel(SoundArray, index, ChannelList_State, &ActiveChannels);
+    LinkChannel(SoundArray, index, ChannelList_Sound, &SoundBuckets[GetChannelBucket(channel->Audio)]);
+    LinkChannel(SoundArray, index, ChannelList_Origin, &OriginBuckets[GetChannelBucket(channel->Origin)]);
+    channel->Active = true;
+}
+PRIVATE STATIC void  AudioManager::DeactivateChannel(int index) {
+    AudioChannel* channel = &SoundArray[index];
+    if (!channel->Active)
+        return;
+
+    UnlinkChannel(SoundArray, index, ChannelList_State, &ActiveChannels);
+    UnlinkChannel(SoundArray, index, ChannelList_Sound, &SoundBuckets[GetChannelBucket(channel->Audio)]);
+    UnlinkChannel(SoundArray, index, ChannelList_Origin, &OriginBuckets[GetChannelBucket(channel->Origin)]);
+    LinkChannel(SoundArray, index, ChannelList_State, &FreeChannels);
+    channel->Active = false;
+}
+PRIVATE STATIC void  AudioManager::StopChannel(int index) {
+    SoundArray[index].Stopped = true;
+    AudioManager::DeactivateChannel(index);
 }
 
 PUBLIC STATIC void   AudioManager::ClampParams(float& pan, float& speed, float& volume) {
@@ -236,8 +497,13 @@ PRIVATE STATIC void   AudioManager::UpdateChannelPlayer(AudioPlayback* playback,
         playback->OwnsSoundData = true;
     }
 
+    // Sounds decoded ahead of time are played straight from their samples
+    playback->SharedSamples = sound->DeviceSamples;
+    playback->SharedSampleCount = sound->DeviceSampleCount;
+    playback->SharedSampleIndex = 0;
+
     SoundFormat* srcSndData = sound->SoundData;
-    if (srcSndData)
+    if (srcSndData && !sound->DeviceSamples)
         srcSndData->CopySamples(playback->SoundData);
     else {
         playback->SoundData->Samples.clear();
@@ -258,6 +524,9 @@ PUBLIC STATIC void   AudioManager::SetSound(int channel, ISound* sound, bool loo
 
     AudioManager::ClampParams(pan, speed, volume);
 
+    // Its sound and origin buckets may change
+    AudioManager::DeactivateChannel(channel);
+
     audio->Audio = sound;
     audio->Stopped = false;
     audio->Paused = false;
@@ -269,6 +538,8 @@ PUBLIC STATIC void   AudioManager::SetSound(int channel, ISound* sound, bool loo
     audio->Speed = (Uint32)(speed * 0x10000);
     audio->Volume = volume;
 
+    AudioManager::ActivateChannel(channel);
+
     int requiredSamples = AudioManager::DeviceFormat.samples * AUDIO_FIRST_LOAD_SAMPLE_BOOST;
     if (playback == nullptr) {
         playback = new AudioPlayback(sound->Format, requiredSamples, sound->BytesPerSample, AudioManager::BytesPerSample);
@@ -290,15 +561,13 @@ PUBLIC STATIC int    AudioManager::PlaySound(ISound* music) {
     return AudioManager::PlaySound(music, false, 0, 0.0f, 1.0f, 1.0f, nullptr);
 }
 PUBLIC STATIC int    AudioManager::PlaySound(ISound* music, bool loop, int loopPoint, float pan, float speed, float volume, void* origin) {
-    for (int i = 0; i < SoundArrayLength; i++) {
-        AudioChannel* audio = &SoundArray[i];
-        if (!audio->Audio || audio->Stopped) {
-            AudioManager::SetSound(i, music, loop, loopPoint, pan, speed, volume, origin);
-            return i;
-        }
-    }
+    AudioManager::Lock();
+    int channel = FreeChannels;
+    if (channel != -1)
+        AudioManager::SetSound(channel, music, loop, loopPoint, pan, speed, volume, origin);
+    AudioManager::Unlock();
 
-    return -1;
+    return channel;
 }
 
 PUBLIC STATIC void   AudioManager::PushMusic(ISound* music, bool loop, Uint32 lp, float pan, float speed, float volume, double fadeInAfterFinished) {
@@ -330,25 +599,41 @@ PUBLIC STATIC void   AudioManager::PushMusicAt(ISound* music, double at, bool lo
     newms->FadeTimer = 1.0;
     newms->FadeTimerMax = 1.0;
 
+    if (loop)
+        newms->Playback->LoopIndex = (Sint32)lp;
+
     int start_sample = (int)std::ceil(at * music->Format.freq);
 
     newms->Playback->Seek(start_sample);
     if (newms->Playback->ConversionStream)
         SDL_AudioStreamClear(newms->Playback->ConversionStream);
 
-    if (loop)
-        newms->Playback->LoopIndex = (Sint32)lp;
+    // Only once it's been seeked, since the decoder thread owns its sound
+    // data from here on
+    if (DecoderThread && newms->Playback->OwnsSoundData)
+        newms->Playback->StartStreaming();
 
     MusicStack.push_front(newms);
 
     AudioManager::Unlock();
 }
+// Streaming music is left for the decoder thread to delete, since it may be
+// decoding it right now. The audio device has to be locked.
+PRIVATE STATIC void  AudioManager::DeleteMusic(AudioChannel* audio) {
+    if (DecoderThread && audio->Playback && audio->Playback->Streaming) {
+        FinishedMusic.push_back(audio);
+        AudioManager::WakeDecoder();
+    }
+    else
+        delete audio;
+}
 PUBLIC STATIC void   AudioManager::RemoveMusic(ISound* music) {
     AudioManager::Lock();
     for (size_t i = 0; i < MusicStack.size(); i++) {
         if (MusicStack[i]->Audio == music) {
-            delete MusicStack[i];
+            AudioManager::DeleteMusic(MusicStack[i]);
             MusicStack.erase(MusicStack.begin() + i);
+            i--;
         }
     }
     AudioManager::Unlock();
@@ -367,7 +652,7 @@ PUBLIC STATIC bool   AudioManager::IsPlayingMusic(ISound* music) {
 PUBLIC STATIC void   AudioManager::ClearMusic() {
     AudioManager::Lock();
     for (size_t i = 0; i < MusicStack.size(); i++) {
-        delete MusicStack[i];
+        AudioManager::DeleteMusic(MusicStack[i]);
     }
     MusicStack.clear();
     AudioManager::Unlock();
@@ -375,7 +660,7 @@ PUBLIC STATIC void   AudioManager::ClearMusic() {
 PUBLIC STATIC void   AudioManager::ClearSounds() {
     AudioManager::Lock();
     for (int i = 0; i < SoundArrayLength; i++) {
-        SoundArray[i].Stopped = true;
+        AudioManager::StopChannel(i);
         if (SoundArray[i].Playback) {
             delete SoundArray[i].Playback;
             SoundArray[i].Playback = NULL;
@@ -407,7 +692,7 @@ PUBLIC STATIC double AudioManager::GetMusicPosition(ISound* music) {
     double position = 0.0;
     for (size_t i = 0; i < MusicStack.size(); i++) {
         if (MusicStack[i]->Audio == music) {
-            position = MusicStack[i]->Playback->SoundData->GetPosition();
+            position = MusicStack[i]->Playback->GetPosition();
             break;
         }
     }
@@ -424,19 +709,13 @@ PUBLIC STATIC void   AudioManager::Unlock() {
 
 PUBLIC STATIC int    AudioManager::GetFreeChannel() {
     AudioManager::Lock();
-    int channel = -1;
-    for (int i = 0; i < SoundArrayLength; i++) {
-        if (SoundArray[i].Stopped) {
-            channel = i;
-            break;
-        }
-    }
+    int channel = FreeChannels;
     AudioManager::Unlock();
     return channel;
 }
 PUBLIC STATIC void   AudioManager::AlterChannel(int channel, float pan, float speed, float volume) {
     AudioManager::Lock();
-    if (!SoundArray[channel].Stopped && !SoundArray[channel].Paused) {
+    if (SoundArray[channel].Active && !SoundArray[channel].Paused) {
         AudioManager::ClampParams(pan, speed, volume);
         SoundArray[channel].Pan = pan;
         SoundArray[channel].Speed = (Uint32)(speed * 0x10000);
@@ -447,17 +726,19 @@ PUBLIC STATIC void   AudioManager::AlterChannel(int channel, float pan, float sp
 PUBLIC STATIC bool   AudioManager::AudioIsPlaying(int channel) {
     bool isPlaying = false;
     AudioManager::Lock();
-    isPlaying = !SoundArray[channel].Stopped && !SoundArray[channel].Paused;
+    isPlaying = SoundArray[channel].Active && !SoundArray[channel].Paused;
     AudioManager::Unlock();
     return isPlaying;
 }
 PUBLIC STATIC bool   AudioManager::AudioIsPlaying(ISound* audio) {
     bool isPlaying = false;
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++) {
+    for (int i = SoundBuckets[GetChannelBucket(audio)]; i != -1; i = SoundArray[i].Next[ChannelList_Sound]) {
         AudioChannel* channel = &SoundArray[i];
-        if (!channel->Stopped && !channel->Paused && channel->Audio == audio)
+        if (!channel->Paused && channel->Audio == audio) {
             isPlaying = true;
+            break;
+        }
     }
     AudioManager::Unlock();
     return isPlaying;
@@ -469,7 +750,7 @@ PUBLIC STATIC void   AudioManager::AudioUnpause(int channel) {
 }
 PUBLIC STATIC void   AudioManager::AudioUnpause(ISound* audio) {
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++) {
+    for (int i = SoundBuckets[GetChannelBucket(audio)]; i != -1; i = SoundArray[i].Next[ChannelList_Sound]) {
         if (SoundArray[i].Audio == audio)
             SoundArray[i].Paused = false;
     }
@@ -482,7 +763,7 @@ PUBLIC STATIC void   AudioManager::AudioPause(int channel) {
 }
 PUBLIC STATIC void   AudioManager::AudioPause(ISound* audio) {
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++) {
+    for (int i = SoundBuckets[GetChannelBucket(audio)]; i != -1; i = SoundArray[i].Next[ChannelList_Sound]) {
         if (SoundArray[i].Audio == audio)
             SoundArray[i].Paused = true;
     }
@@ -490,93 +771,310 @@ PUBLIC STATIC void   AudioManager::AudioPause(ISound* audio) {
 }
 PUBLIC STATIC void   AudioManager::AudioStop(int channel) {
     AudioManager::Lock();
-    SoundArray[channel].Stopped = true;
+    AudioManager::StopChannel(channel);
     AudioManager::Unlock();
 }
 PUBLIC STATIC void   AudioManager::AudioStop(ISound* audio) {
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++) {
+    for (int i = SoundBuckets[GetChannelBucket(audio)], next; i != -1; i = next) {
+        next = SoundArray[i].Next[ChannelList_Sound];
         if (SoundArray[i].Audio == audio)
-            SoundArray[i].Stopped = true;
+            AudioManager::StopChannel(i);
     }
     AudioManager::Unlock();
 }
 PUBLIC STATIC void   AudioManager::AudioUnpauseAll() {
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++)
+    for (int i = ActiveChannels; i != -1; i = SoundArray[i].Next[ChannelList_State])
         SoundArray[i].Paused = false;
     AudioManager::Unlock();
 }
 PUBLIC STATIC void   AudioManager::AudioPauseAll() {
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++)
+    for (int i = ActiveChannels; i != -1; i = SoundArray[i].Next[ChannelList_State])
         SoundArray[i].Paused = true;
     AudioManager::Unlock();
 }
 PUBLIC STATIC void   AudioManager::AudioStopAll() {
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++)
-        SoundArray[i].Stopped = true;
+    while (ActiveChannels != -1)
+        AudioManager::StopChannel(ActiveChannels);
     AudioManager::Unlock();
 }
 
 PUBLIC STATIC bool   AudioManager::IsOriginPlaying(void* origin, ISound* audio) {
     bool isPlaying = false;
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++) {
+    for (int i = OriginBuckets[GetChannelBucket(origin)]; i != -1; i = SoundArray[i].Next[ChannelList_Origin]) {
         AudioChannel* channel = &SoundArray[i];
-        if (!channel->Stopped && !channel->Paused && channel->Audio == audio && channel->Origin == origin)
+        if (!channel->Paused && channel->Audio == audio && channel->Origin == origin) {
             isPlaying = true;
+            break;
+        }
     }
     AudioManager::Unlock();
     return isPlaying;
 }
 PUBLIC STATIC void   AudioManager::StopOriginSound(void* origin, ISound* audio) {
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++) {
+    for (int i = OriginBuckets[GetChannelBucket(origin)], next; i != -1; i = next) {
+        next = SoundArray[i].Next[ChannelList_Origin];
         if (SoundArray[i].Audio == audio && SoundArray[i].Origin == origin)
-            SoundArray[i].Stopped = true;
+            AudioManager::StopChannel(i);
     }
     AudioManager::Unlock();
 }
 PUBLIC STATIC void   AudioManager::StopAllOriginSounds(void* origin) {
     AudioManager::Lock();
-    for (int i = 0; i < SoundArrayLength; i++) {
+    for (int i = OriginBuckets[GetChannelBucket(origin)], next; i != -1; i = next) {
+        next = SoundArray[i].Next[ChannelList_Origin];
         if (SoundArray[i].Origin == origin)
-            SoundArray[i].Stopped = true;
+            AudioManager::StopChannel(i);
     }
     AudioManager::Unlock();
 }
 
-PUBLIC STATIC void   AudioManager::MixAudioLR(Uint8* dest, Uint8* src, size_t len, float volumeL, float volumeR) {
-#define DEFINE_STREAM_PTR(type) type* src##type; type* dest##type
-#define PAN_STREAM_PTR(type) \
-    src##type = (type*)(src); \
-    dest##type = (type*)(dest); \
-    for (Uint32 o = 0; o < len; o++) { \
-        dest##type[0] = (type)(src##type[0] * volumeL); \
-        dest##type[1] = (type)(src##type[1] * volumeR); \
-        src##type += 2; \
-        dest##type += 2; \
+// Sample conversion
+// Sounds are read in the device's format, then mixed together in float on
+// the mix bus, which is converted back to the device's format once at the
+// end. count is the number of samples, not frames.
+PRIVATE STATIC void  AudioManager::ConvertToFloat(Uint8* src, float* dest, size_t count) {
+    size_t i = 0;
+    switch (DeviceFormat.format) {
+        case AUDIO_U8:
+            for (; i < count; i++)
+                dest[i] = ((int)src[i] - 0x80) * (1.0f / 0x80);
+            break;
+        case AUDIO_S8:
+            for (; i < count; i++)
+                dest[i] = ((Sint8*)src)[i] * (1.0f / 0x80);
+            break;
+        case AUDIO_U16SYS:
+            for (; i < count; i++)
+                dest[i] = ((int)((Uint16*)src)[i] - 0x8000) * (1.0f / 0x8000);
+            break;
+        case AUDIO_S16SYS: {
+            Sint16* in = (Sint16*)src;
+#if defined(AUDIO_SIMD_SSE2)
+            __m128 scale = _mm_set1_ps(1.0f / 0x8000);
+            for (; i + 8 <= count; i += 8) {
+                __m128i v = _mm_loadu_si128((__m128i*)&in[i]);
+                __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+                __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+                _mm_storeu_ps(&dest[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+                _mm_storeu_ps(&dest[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+            }
+#elif defined(AUDIO_SIMD_NEON)
+            float32x4_t scale = vdupq_n_f32(1.0f / 0x8000);
+            for (; i + 8 <= count; i += 8) {
+                int16x8_t v = vld1q_s16(&in[i]);
+                vst1q_f32(&dest[i], vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+                vst1q_f32(&dest[i + 4], vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+            }
+#endif
+            for (; i < count; i++)
+                dest[i] = in[i] * (1.0f / 0x8000);
+            break;
+        }
+        case AUDIO_S32SYS:
+            for (; i < count; i++)
+                dest[i] = (float)(((Sint32*)src)[i] * (1.0 / 0x80000000U));
+            break;
+        case AUDIO_F32SYS:
+            memcpy(dest, src, count * sizeof(float));
+            break;
+        default:
+            memset(dest, 0, count * sizeof(float));
+            break;
     }
-
-    DEFINE_STREAM_PTR(Uint8);
-    DEFINE_STREAM_PTR(Sint8);
-    DEFINE_STREAM_PTR(Uint16);
-    DEFINE_STREAM_PTR(Sint16);
-    DEFINE_STREAM_PTR(Sint32);
-    DEFINE_STREAM_PTR(float);
-
+}
+PRIVATE STATIC void  AudioManager::ConvertFromFloat(float* src, Uint8* dest, size_t count) {
+#define CLIP_SAMPLE(sample) ((sample) < -1.0f ? -1.0f : (sample) > 1.0f ? 1.0f : (sample))
+    size_t i = 0;
     switch (DeviceFormat.format) {
-        case AUDIO_U8: PAN_STREAM_PTR(Uint8); break;
-        case AUDIO_S8: PAN_STREAM_PTR(Sint8); break;
-        case AUDIO_U16SYS: PAN_STREAM_PTR(Uint16); break;
-        case AUDIO_S16SYS: PAN_STREAM_PTR(Sint16); break;
-        case AUDIO_S32SYS: PAN_STREAM_PTR(Sint32); break;
-        case AUDIO_F32SYS: PAN_STREAM_PTR(float); break;
+        case AUDIO_U8:
+            for (; i < count; i++)
+                dest[i] = (Uint8)((int)(CLIP_SAMPLE(src[i]) * 0x7F) + 0x80);
+            break;
+        case AUDIO_S8:
+            for (; i < count; i++)
+                ((Sint8*)dest)[i] = (Sint8)(CLIP_SAMPLE(src[i]) * 0x7F);
+            break;
+        case AUDIO_U16SYS:
+            for (; i < count; i++)
+                ((Uint16*)dest)[i] = (Uint16)((int)(CLIP_SAMPLE(src[i]) * 0x7FFF) + 0x8000);
+            break;
+        case AUDIO_S16SYS: {
+            Sint16* out = (Sint16*)dest;
+#if defined(AUDIO_SIMD_SSE2)
+            __m128 scale = _mm_set1_ps(0x7FFF);
+            __m128 min = _mm_set1_ps(-1.0f);
+            __m128 max = _mm_set1_ps(1.0f);
+            for (; i + 8 <= count; i += 8) {
+                __m128 lo = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[i]), min), max);
+                __m128 hi = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[i + 4]), min), max);
+                __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(_mm_mul_ps(lo, scale)), _mm_cvttps_epi32(_mm_mul_ps(hi, scale)));
+                _mm_storeu_si128((__m128i*)&out[i], packed);
+            }
+#elif defined(AUDIO_SIMD_NEON)
+            float32x4_t scale = vdupq_n_f32(0x7FFF);
+            float32x4_t min = vdupq_n_f32(-1.0f);
+            float32x4_t max = vdupq_n_f32(1.0f);
+            for (; i + 8 <= count; i += 8) {
+                float32x4_t lo = vminq_f32(vmaxq_f32(vld1q_f32(&src[i]), min), max);
+                float32x4_t hi = vminq_f32(vmaxq_f32(vld1q_f32(&src[i + 4]), min), max);
+                int16x4_t lo16 = vqmovn_s32(vcvtq_s32_f32(vmulq_f32(lo, scale)));
+                int16x4_t hi16 = vqmovn_s32(vcvtq_s32_f32(vmulq_f32(hi, scale)));
+                vst1q_s16(&out[i], vcombine_s16(lo16, hi16));
+            }
+#endif
+            for (; i < count; i++)
+                out[i] = (Sint16)(CLIP_SAMPLE(src[i]) * 0x7FFF);
+            break;
+        }
+        case AUDIO_S32SYS:
+            for (; i < count; i++)
+                ((Sint32*)dest)[i] = (Sint32)(CLIP_SAMPLE(src[i]) * 2147483647.0);
+            break;
+        case AUDIO_F32SYS:
+            for (; i < count; i++)
+                ((float*)dest)[i] = CLIP_SAMPLE(src[i]);
+            break;
+        default:
+            memset(dest, 0, count * BytesPerSample / DeviceFormat.channels);
+            break;
     }
-#undef DEFINE_STREAM_PTR
-#undef PAN_STREAM_PTR
+#undef CLIP_SAMPLE
+}
+
+// Resampling
+// Each function adds count frames to the mix bus, reading from src at the
+// given 16.16 position and moving forward by speed after each frame, and
+// returns the position it stopped at. src must have AUDIO_RESAMPLE_HISTORY
+// frames before the position and AUDIO_RESAMPLE_LOOKAHEAD frames after the
+// last one read. Panning only applies to stereo, so other layouts use
+// volumeL for every channel.
+static Uint32 ResampleLinear(float* bus, float* src, int channels, Uint32 position, Uint32 speed, int count, float volumeL, float volumeR) {
+    for (int i = 0; i < count; i++) {
+        float* a = &src[(position >> 16) * channels];
+        float* b = a + channels;
+        float t = (position & 0xFFFF) * (1.0f / 0x10000);
+        for (int c = 0; c < channels; c++) {
+            float gain = c == 1 ? volumeR : volumeL;
+            bus[c] += (a[c] + (b[c] - a[c]) * t) * gain;
+        }
+        bus += channels;
+        position += speed;
+    }
+    return position;
+}
+static Uint32 ResampleSinc(float* bus, float* src, int channels, Uint32 position, Uint32 speed, int count, float volumeL, float volumeR) {
+    for (int i = 0; i < count; i++) {
+        float* s = &src[((position >> 16) - AUDIO_RESAMPLE_HISTORY) * channels];
+        float* taps = &SincTable[((position & 0xFFFF) >> (16 - SINC_PHASE_SHIFT)) * AUDIO_RESAMPLE_TAPS * 2];
+        for (int c = 0; c < channels; c++) {
+            float gain = c == 1 ? volumeR : volumeL;
+            float sum = 0.0f;
+            for (int t = 0; t < AUDIO_RESAMPLE_TAPS; t++)
+                sum += s[t * channels + c] * taps[t * 2];
+            bus[c] += sum * gain;
+        }
+        bus += channels;
+        position += speed;
+    }
+    return position;
+}
+#if defined(AUDIO_SIMD_SSE2)
+// Two stereo frames at a time
+static Uint32 ResampleLinearStereoSSE2(float* bus, float* src, Uint32 position, Uint32 speed, int count, float volumeL, float volumeR) {
+    __m128 gain = _mm_setr_ps(volumeL, volumeR, volumeL, volumeR);
+    __m128 zero = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        Uint32 position2 = position + speed;
+        float* a0 = &src[(position >> 16) * 2];
+        float* a1 = &src[(position2 >> 16) * 2];
+        __m128 a = _mm_loadh_pi(_mm_loadl_pi(zero, (__m64*)a0), (__m64*)a1);
+        __m128 b = _mm_loadh_pi(_mm_loadl_pi(zero, (__m64*)(a0 + 2)), (__m64*)(a1 + 2));
+        float t0 = (position & 0xFFFF) * (1.0f / 0x10000);
+        float t1 = (position2 & 0xFFFF) * (1.0f / 0x10000);
+        __m128 t = _mm_setr_ps(t0, t0, t1, t1);
+
+        __m128 mixed = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+        _mm_storeu_ps(&bus[i * 2], _mm_add_ps(_mm_loadu_ps(&bus[i * 2]), _mm_mul_ps(mixed, gain)));
+        position = position2 + speed;
+    }
+    return ResampleLinear(&bus[i * 2], src, 2, position, speed, count - i, volumeL, volumeR);
+}
+static Uint32 ResampleSincStereoSSE2(float* bus, float* src, Uint32 position, Uint32 speed, int count, float volumeL, float volumeR) {
+    __m128 gain = _mm_setr_ps(volumeL, volumeR, 0.0f, 0.0f);
+    for (int i = 0; i < count; i++) {
+        float* s = &src[((position >> 16) - AUDIO_RESAMPLE_HISTORY) * 2];
+        float* taps = &SincTable[((position & 0xFFFF) >> (16 - SINC_PHASE_SHIFT)) * AUDIO_RESAMPLE_TAPS * 2];
+        __m128 sum = _mm_setzero_ps();
+        for (int t = 0; t < AUDIO_RESAMPLE_TAPS * 2; t += 4)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&s[t]), _mm_loadu_ps(&taps[t])));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+
+        __m128 out = _mm_loadl_pi(_mm_setzero_ps(), (__m64*)&bus[i * 2]);
+        _mm_storel_pi((__m64*)&bus[i * 2], _mm_add_ps(out, _mm_mul_ps(sum, gain)));
+        position += speed;
+    }
+    return position;
+}
+#elif defined(AUDIO_SIMD_NEON)
+static Uint32 ResampleLinearStereoNEON(float* bus, float* src, Uint32 position, Uint32 speed, int count, float volumeL, float volumeR) {
+    float gainValues[2] = { volumeL, volumeR };
+    float32x2_t gain = vld1_f32(gainValues);
+    for (int i = 0; i < count; i++) {
+        float* a = &src[(position >> 16) * 2];
+        float32x2_t va = vld1_f32(a);
+        float32x2_t vb = vld1_f32(a + 2);
+        float t = (position & 0xFFFF) * (1.0f / 0x10000);
+
+        float32x2_t mixed = vmla_n_f32(va, vsub_f32(vb, va), t);
+        vst1_f32(&bus[i * 2], vmla_f32(vld1_f32(&bus[i * 2]), mixed, gain));
+        position += speed;
+    }
+    return position;
+}
+static Uint32 ResampleSincStereoNEON(float* bus, float* src, Uint32 position, Uint32 speed, int count, float volumeL, float volumeR) {
+    float gainValues[2] = { volumeL, volumeR };
+    float32x2_t gain = vld1_f32(gainValues);
+    for (int i = 0; i < count; i++) {
+        float* s = &src[((position >> 16) - AUDIO_RESAMPLE_HISTORY) * 2];
+        float* taps = &SincTable[((position & 0xFFFF) >> (16 - SINC_PHASE_SHIFT)) * AUDIO_RESAMPLE_TAPS * 2];
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        for (int t = 0; t < AUDIO_RESAMPLE_TAPS * 2; t += 4)
+            sum = vmlaq_f32(sum, vld1q_f32(&s[t]), vld1q_f32(&taps[t]));
+
+        float32x2_t frame = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+        vst1_f32(&bus[i * 2], vmla_f32(vld1_f32(&bus[i * 2]), frame, gain));
+        position += speed;
+    }
+    return position;
+}
+#endif
+static Uint32 Resample(float* bus, float* src, int channels, Uint32 position, Uint32 speed, int count, float volumeL, float volumeR) {
+    if (AudioManager::ResampleMode == AudioManager::RESAMPLE_SINC) {
+#if defined(AUDIO_SIMD_SSE2)
+        if (channels == 2)
+            return ResampleSincStereoSSE2(bus, src, position, speed, count, volumeL, volumeR);
+#elif defined(AUDIO_SIMD_NEON)
+        if (channels == 2)
+            return ResampleSincStereoNEON(bus, src, position, speed, count, volumeL, volumeR);
+#endif
+        return ResampleSinc(bus, src, channels, position, speed, count, volumeL, volumeR);
+    }
+
+#if defined(AUDIO_SIMD_SSE2)
+    if (channels == 2)
+        return ResampleLinearStereoSSE2(bus, src, position, speed, count, volumeL, volumeR);
+#elif defined(AUDIO_SIMD_NEON)
+    if (channels == 2)
+        return ResampleLinearStereoNEON(bus, src, position, speed, count, volumeL, volumeR);
+#endif
+    return ResampleLinear(bus, src, channels, position, speed, count, volumeL, volumeR);
 }
 
 PRIVATE STATIC bool  AudioManager::HandleFading(AudioChannel* audio) {
@@ -599,131 +1097,134 @@ PRIVATE STATIC bool  AudioManager::HandleFading(AudioChannel* audio) {
     }
     return false;
 }
-PUBLIC STATIC bool   AudioManager::AudioPlayMix(AudioChannel* audio, Uint8* stream, int len, float volume) {
+// Reads the next samples of a channel into its float buffer, first dropping
+// the ones the resampler won't need anymore.
+PRIVATE STATIC int   AudioManager::FillMixSamples(AudioChannel* audio, AudioPlayback* playback) {
+    int channels = DeviceFormat.channels;
+
+    Uint32 drop = (playback->MixPosition >> 16) - AUDIO_RESAMPLE_HISTORY;
+    if (drop > playback->MixSampleCount)
+        drop = playback->MixSampleCount;
+    if (drop) {
+        playback->MixSampleCount -= drop;
+        playback->MixPosition -= drop << 16;
+        memmove(playback->MixSamples, &playback->MixSamples[drop * channels], playback->MixSampleCount * channels * sizeof(float));
+    }
+
+    if (playback->MixEnded)
+        return REQUEST_EOF;
+
+    float* dest = &playback->MixSamples[playback->MixSampleCount * channels];
+
+    int bytes = playback->RequestSamples(DeviceFormat.samples, audio->Loop, audio->LoopPoint);
+    if (bytes == REQUEST_EOF) {
+        // Follow the last samples with silence, so they can still be played
+        memset(dest, 0, AUDIO_RESAMPLE_LOOKAHEAD * channels * sizeof(float));
+        playback->MixSampleCount += AUDIO_RESAMPLE_LOOKAHEAD;
+        playback->MixEnded = true;
+        return 1;
+    }
+    if (bytes < 0)
+        return bytes;
+
+    AudioManager::ConvertToFloat(playback->BufferData, dest, playback->BufferedSamples * channels);
+    playback->MixSampleCount += playback->BufferedSamples;
+    playback->BufferedSamples = 0;
+    return bytes;
+}
+// Mixes frames of a channel into the mix bus. Returns true when the channel
+// is done playing.
+PUBLIC STATIC bool   AudioManager::AudioPlayMix(AudioChannel* audio, float* bus, int frames, float volume) {
     if (AudioManager::HandleFading(audio))
         return true;
 
     AudioPlayback* playback = audio->Playback;
-    if (!playback || !audio->Playback->SoundData)
+    if (!playback || !playback->SoundData || !playback->MixSamples)
         return false;
 
-    int bytesPerSample = BytesPerSample;
-    int bytes = playback->BufferedSamples * bytesPerSample;
-
-    int advanceAccumulator = 0;
-    int advanceReadIndex = 0;
-    int advance = 0;
-    int speed = audio->Speed;
-
-    // Read more bytes
-    if (bytes == 0) {
-        bytes = playback->RequestSamples(DeviceFormat.samples, audio->Loop, audio->LoopPoint);
-    }
-    else {
-        advanceReadIndex = len - bytes;
-    }
-
-    int mixVolume;
+    float gain = MasterVolume * volume;
     if (audio->Fading)
-        mixVolume = (int)(SDL_MIX_MAXVOLUME * MasterVolume * volume * (audio->FadeTimer / audio->FadeTimerMax));
-    else
-        mixVolume = (int)(SDL_MIX_MAXVOLUME * MasterVolume * volume);
-
-    float volumeL = 1.0f;
-    float volumeR = 1.0f;
+        gain *= (float)(audio->FadeTimer / audio->FadeTimerMax);
 
-    bool doPanning = audio->Pan != 0.0f && DeviceFormat.channels == 2;
-    if (doPanning) {
+    float volumeL = gain;
+    float volumeR = gain;
+    if (audio->Pan != 0.0f && DeviceFormat.channels == 2) {
         if (audio->Pan < 0.f)
-            volumeR += audio->Pan;
+            volumeR *= 1.0f + audio->Pan;
         else
-            volumeL -= audio->Pan;
+            volumeL *= 1.0f - audio->Pan;
     }
 
-    switch (bytes) {
-        // End of file
-        case REQUEST_EOF:
-            return true; // Stop playing audio.
-        // Waiting
-        case REQUEST_CONVERTING:
-            break;
-        // Error
-        case REQUEST_ERROR:
-            break;
-        // Normal
-        default:
-            if (speed == 0x10000) {
-                if (!doPanning)
-                    SDL_MixAudioFormat(stream, playback->Buffer, DeviceFormat.format, (Uint32)bytes, mixVolume);
-                else {
-                    Uint32 mixAdvance = MixBufferSize * bytesPerSample;
-                    for (Uint32 o = 0; o < len; o += mixAdvance) {
-                        AudioManager::MixAudioLR(MixBuffer, playback->Buffer + advanceReadIndex, MixBufferSize, volumeL, volumeR);
-                        SDL_MixAudioFormat(stream + o, MixBuffer, DeviceFormat.format, mixAdvance, mixVolume);
-                        advanceReadIndex += mixAdvance;
-                    }
-                }
-
-                playback->BufferedSamples -= bytes / bytesPerSample;
-            }
-            else for (Uint32 o = 0; o < len; o += bytesPerSample) {
-                advanceAccumulator += speed;
-                advance = advanceAccumulator >> 16;
-                advanceAccumulator &= 0xFFFF;
-
-                if (doPanning) {
-                    AudioManager::MixAudioLR(MixBuffer, playback->Buffer + advanceReadIndex, 1, volumeL, volumeR);
-                    SDL_MixAudioFormat(stream + o, MixBuffer, DeviceFormat.format, (Uint32)bytesPerSample, mixVolume);
-                }
-                else
-                    SDL_MixAudioFormat(stream + o, playback->Buffer + advanceReadIndex, DeviceFormat.format, (Uint32)bytesPerSample, mixVolume);
-
-                advanceReadIndex += advance * bytesPerSample;
-                if (playback->BufferedSamples <= advance) {
-                    playback->BufferedSamples = 0;
-                    advanceReadIndex = 0;
-
-                    bytes = playback->RequestSamples(DeviceFormat.samples, audio->Loop, audio->LoopPoint);
-                }
-                else
-                    playback->BufferedSamples -= advance;
-            }
+    int channels = DeviceFormat.channels;
+    Uint32 speed = audio->Speed;
+    int mixed = 0;
+    while (mixed < frames) {
+        // The furthest the read position can be with enough samples after it
+        Sint64 limit = (((Sint64)playback->MixSampleCount - AUDIO_RESAMPLE_LOOKAHEAD) << 16) - 1;
+        if ((Sint64)playback->MixPosition > limit) {
+            int result = AudioManager::FillMixSamples(audio, playback);
+            if (result == REQUEST_EOF)
+                return true; // Stop playing audio.
+            // Waiting or error, so try again next time
+            if (result < 0)
+                break;
+            continue;
+        }
+
+        int count = frames - mixed;
+        if (speed) {
+            Sint64 available = (limit - playback->MixPosition) / speed + 1;
+            if (available < count)
+                count = (int)available;
+        }
+
+        playback->MixPosition = Resample(&bus[mixed * channels], playback->MixSamples, channels, playback->MixPosition, speed, count, volumeL, volumeR);
+        mixed += count;
     }
     return false;
 }
 
 PUBLIC STATIC void   AudioManager::AudioCallback(void* data, Uint8* stream, int len) {
-    memset(stream, 0x00, len);
-
-    if (AudioManager::AudioQueueSize >= (size_t)len) {
-        SDL_MixAudioFormat(stream, AudioManager::AudioQueue, DeviceFormat.format, (Uint32)len, (int)(SDL_MIX_MAXVOLUME * MasterVolume));
+    size_t frames = len / BytesPerSample;
+    if (frames * DeviceFormat.channels > MixBusSize)
+        frames = MixBusSize / DeviceFormat.channels;
 
-        AudioManager::AudioQueueSize -= len;
-        if (AudioManager::AudioQueueSize > 0)
-            memmove(AudioManager::AudioQueue, AudioManager::AudioQueue + len, AudioManager::AudioQueueSize);
-    }
+    size_t samples = frames * DeviceFormat.channels;
+    memset(MixBus, 0, samples * sizeof(float));
 
     // Make track system
     if (MusicStack.size() > 0) {
         AudioChannel* audio = MusicStack.front();
         if (!audio->Paused) {
-            if (AudioManager::AudioPlayMix(audio, stream, len, audio->Volume * MusicVolume)) {
-                delete audio;
+            if (AudioManager::AudioPlayMix(audio, MixBus, (int)frames, audio->Volume * MusicVolume)) {
+                AudioManager::DeleteMusic(audio);
                 MusicStack.pop_front();
             }
         }
     }
 
-    for (int i = 0; i < SoundArrayLength; i++) {
+    for (int i = ActiveChannels, next; i != -1; i = next) {
         AudioChannel* audio = &SoundArray[i];
-        if (!audio->Audio || audio->Stopped || audio->Paused)
+        next = audio->Next[ChannelList_State];
+        if (audio->Paused)
             continue;
 
-        if (AudioManager::AudioPlayMix(audio, stream, len, audio->Volume * SoundVolume)) {
-            audio->Stopped = true;
+        if (AudioManager::AudioPlayMix(audio, MixBus, (int)frames, audio->Volume * SoundVolume)) {
+            AudioManager::StopChannel(i);
         }
     }
 
+    memset(stream, 0x00, len);
+    AudioManager::ConvertFromFloat(MixBus, stream, samples);
+
+    if (AudioManager::AudioQueueSize >= (size_t)len) {
+        SDL_MixAudioFormat(stream, AudioManager::AudioQueue, DeviceFormat.format, (Uint32)len, (int)(SDL_MIX_MAXVOLUME * MasterVolume));
+
+        AudioManager::AudioQueueSize -= len;
+        if (AudioManager::AudioQueueSize > 0)
+            memmove(AudioManager::AudioQueue, AudioManager::AudioQueue + len, AudioManager::AudioQueueSize);
+    }
+
     if (LowPassFilter > 0.0) {
         size_t channels = 2;
         if (SDL_AUDIO_ISFLOAT(DeviceFormat.format)) {
@@ -750,10 +1251,12 @@ PUBLIC STATIC void   AudioManager::AudioCallback(void* data, Uint8* stream, int
 }
 
 PUBLIC STATIC void   AudioManager::Dispose() {
+    SDL_PauseAudioDevice(Device, 1);
+    StopDecoder();
+
     Memory::Free(SoundArray);
     Memory::Free(AudioQueue);
-    Memory::Free(MixBuffer);
+    Memory::Free(MixBus);
 
-    SDL_PauseAudioDevice(Device, 1);
     SDL_CloseAudioDevice(Device);
 }
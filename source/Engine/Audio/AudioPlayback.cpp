@@ -8,6 +8,7 @@ class AudioPlayback {
 public:
     Uint8*           Buffer = NULL;
     Uint8*           UnconvertedSampleBuffer = NULL;
+    Uint8*           BufferData = NULL;
     Uint32           BufferedSamples = 0;
     SDL_AudioSpec    Format;
     size_t           BytesPerSample = 0;
@@ -17,6 +18,23 @@ public:
     SoundFormat*     SoundData = NULL;
     bool             OwnsSoundData = false;
     Sint32           LoopIndex = -1;
+
+    Uint8*           SharedSamples = NULL;
+    Uint32           SharedSampleCount = 0;
+    Uint32           SharedSampleIndex = 0;
+
+    float*           MixSamples = NULL;
+    Uint32           MixSampleCount = 0;
+    Uint32           MixPosition = 0;
+    bool             MixEnded = false;
+
+    bool             Streaming = false;
+    Uint8*           DecodeBuffer = NULL;
+    Uint32           DecodeBufferSamples = 0;
+    SDL_atomic_t     DecodeRead;
+    SDL_atomic_t     DecodeWrite;
+    SDL_atomic_t     DecodeEnded;
+    SDL_atomic_t     DecodePosition;
 };
 #endif
 
@@ -31,7 +49,10 @@ PUBLIC      AudioPlayback::AudioPlayback(SDL_AudioSpec format, size_t requiredSa
 
     // Create sample buffers
     Buffer = (Uint8*)Memory::TrackedMalloc("Playback::Buffer", requiredSamples * deviceBytesPerSample);
+    BufferData = Buffer;
     UnconvertedSampleBuffer = (Uint8*)Memory::TrackedMalloc("Playback::UnconvertedSampleBuffer", requiredSamples * audioBytesPerSample);
+    MixSamples = (float*)Memory::TrackedMalloc("Playback::MixSamples", GetMixSamplesSize(requiredSamples));
+    ResetMix();
 
     // Create sound conversion stream
     CreateConversionStream(format);
@@ -43,11 +64,15 @@ PUBLIC void AudioPlayback::Change(SDL_AudioSpec format, size_t requiredSamples,
     size_t bufSize = requiredSamples * deviceBytesPerSample;
     if (bufSize > RequiredSamples * DeviceBytesPerSample)
         Buffer = (Uint8*)Memory::Realloc(Buffer, bufSize);
+    BufferData = Buffer;
 
     bufSize = requiredSamples * audioBytesPerSample;
     if (bufSize > RequiredSamples * BytesPerSample)
         UnconvertedSampleBuffer = (Uint8*)Memory::Realloc(UnconvertedSampleBuffer, bufSize);
 
+    if (requiredSamples > RequiredSamples)
+        MixSamples = (float*)Memory::Realloc(MixSamples, GetMixSamplesSize(requiredSamples));
+
     Format = format;
     RequiredSamples = requiredSamples;
     BytesPerSample = audioBytesPerSample;
@@ -60,6 +85,21 @@ PUBLIC void AudioPlayback::Change(SDL_AudioSpec format, size_t requiredSamples,
     }
 }
 
+// MixSamples holds the samples the mixer resamples from, already in
+// float, with room for the ones kept around the read position.
+PRIVATE STATIC size_t AudioPlayback::GetMixSamplesSize(size_t requiredSamples) {
+    return (requiredSamples + AUDIO_RESAMPLE_TAPS * 2) * AudioManager::DeviceFormat.channels * sizeof(float);
+}
+PUBLIC void AudioPlayback::ResetMix() {
+    // Start with silence before the first sample, so the resampler
+    // always has the samples it needs behind the read position.
+    MixSampleCount = AUDIO_RESAMPLE_HISTORY;
+    MixPosition = AUDIO_RESAMPLE_HISTORY << 16;
+    MixEnded = false;
+    if (MixSamples)
+        memset(MixSamples, 0, MixSampleCount * AudioManager::DeviceFormat.channels * sizeof(float));
+}
+
 PRIVATE void AudioPlayback::CreateConversionStream(SDL_AudioSpec format) {
     ConversionStream = SDL_NewAudioStream(Format.format, Format.channels, Format.freq, AudioManager::DeviceFormat.format, AudioManager::DeviceFormat.channels, AudioManager::DeviceFormat.freq);
     if (ConversionStream == NULL) {
@@ -75,7 +115,142 @@ PRIVATE void AudioPlayback::CreateConversionStream(SDL_AudioSpec format) {
     }
 }
 
+// Streaming
+// A streaming playback doesn't decode its sound when the audio callback asks
+// for samples. Instead, the decoder thread keeps DecodeBuffer filled ahead
+// of time, and the callback only copies out of it. The buffer is a ring with
+// one reader (the callback) and one writer (the decoder thread), so neither
+// has to wait for the other; DecodeRead and DecodeWrite count the samples
+// each has gone through.
+//
+// Once streaming, the sound data belongs to the decoder thread, so it has
+// to be the playback's own, and it can't be seeked anymore. The audio
+// device has to be locked.
+PUBLIC void AudioPlayback::StartStreaming() {
+    if (Streaming || !SoundData || !OwnsSoundData)
+        return;
+
+    DecodeBufferSamples = RequiredSamples * AUDIO_DECODE_AHEAD;
+    DecodeBuffer = (Uint8*)Memory::TrackedMalloc("Playback::DecodeBuffer", DecodeBufferSamples * BytesPerSample);
+    if (!DecodeBuffer)
+        return;
+
+    SDL_AtomicSet(&DecodeRead, 0);
+    SDL_AtomicSet(&DecodeWrite, 0);
+    SDL_AtomicSet(&DecodeEnded, 0);
+    SDL_AtomicSet(&DecodePosition, (int)SoundData->TellSample());
+    Streaming = true;
+
+    // Decode the first samples right away, so that playback can start
+    // without waiting for the decoder thread
+    while ((Uint32)SDL_AtomicGet(&DecodeWrite) < RequiredSamples) {
+        if (!Decode())
+            break;
+    }
+
+    AudioManager::AddStreamingPlayback(this);
+}
+// Decodes the next samples into the decode buffer, if there's room for them.
+// Only the decoder thread calls this once the playback has started
+// streaming. Returns true if anything was decoded.
+PUBLIC bool AudioPlayback::Decode() {
+    if (!SoundData || SDL_AtomicGet(&DecodeEnded))
+        return false;
+
+    Uint32 read = (Uint32)SDL_AtomicGet(&DecodeRead);
+    Uint32 write = (Uint32)SDL_AtomicGet(&DecodeWrite);
+    Uint32 room = DecodeBufferSamples - (write - read);
+    if (room < RequiredSamples / AUDIO_FIRST_LOAD_SAMPLE_BOOST)
+        return false;
+
+    // Only decode up to the end of the buffer, the rest comes next time
+    Uint32 index = write % DecodeBufferSamples;
+    Uint32 count = DecodeBufferSamples - index;
+    if (count > room)
+        count = room;
+    if (count > AudioManager::DeviceFormat.samples)
+        count = AudioManager::DeviceFormat.samples;
+
+    Uint8* dest = DecodeBuffer + index * BytesPerSample;
+    int num_samples = SoundData->GetSamples(dest, count, LoopIndex);
+    if (num_samples == 0 && LoopIndex >= 0) {
+        SoundData->SeekSample(LoopIndex);
+        num_samples = SoundData->GetSamples(dest, count, LoopIndex);
+    }
+
+    if (num_samples <= 0) {
+        SDL_AtomicSet(&DecodeEnded, 1);
+        return false;
+    }
+
+    SDL_AtomicSet(&DecodeWrite, (int)(write + num_samples));
+    SDL_AtomicSet(&DecodePosition, (int)SoundData->TellSample());
+    return true;
+}
+// Reads decoded samples, either out of the decode buffer or right from the
+// sound if it isn't streaming. Returns 0 at the end of the sound, or -1 if
+// the decoder thread hasn't caught up yet.
+PRIVATE int AudioPlayback::ReadSamples(Uint8* buffer, int count) {
+    if (!Streaming)
+        return SoundData->GetSamples(buffer, count, LoopIndex);
+
+    Uint32 read = (Uint32)SDL_AtomicGet(&DecodeRead);
+    Uint32 write = (Uint32)SDL_AtomicGet(&DecodeWrite);
+    Uint32 available = write - read;
+    if (available == 0) {
+        // Check again, in case the decoder wrote its last samples and
+        // finished after we looked
+        if (SDL_AtomicGet(&DecodeEnded) && (Uint32)SDL_AtomicGet(&DecodeWrite) == write)
+            return 0;
+        AudioManager::WakeDecoder();
+        return -1;
+    }
+
+    if ((Uint32)count > available)
+        count = (int)available;
+
+    Uint32 index = read % DecodeBufferSamples;
+    Uint32 first = DecodeBufferSamples - index;
+    if (first > (Uint32)count)
+        first = (Uint32)count;
+
+    memcpy(buffer, DecodeBuffer + index * BytesPerSample, first * BytesPerSample);
+    if (first < (Uint32)count)
+        memcpy(buffer + first * BytesPerSample, DecodeBuffer, (count - first) * BytesPerSample);
+
+    SDL_AtomicSet(&DecodeRead, (int)(read + count));
+    AudioManager::WakeDecoder();
+    return count;
+}
+PUBLIC double AudioPlayback::GetPosition() {
+    if (!SoundData)
+        return 0.0;
+    if (!Streaming)
+        return SoundData->GetPosition();
+
+    // The decoder is ahead of what was played by what's still buffered.
+    // The position is published after the write count, so reading it first
+    // can only make the result a little early, never past what was played.
+    Sint64 sample = (Sint64)SDL_AtomicGet(&DecodePosition);
+    Uint32 buffered = (Uint32)SDL_AtomicGet(&DecodeWrite) - (Uint32)SDL_AtomicGet(&DecodeRead);
+    sample -= buffered;
+    if (LoopIndex >= 0 && sample < LoopIndex)
+        sample += SoundData->TotalPossibleSamples - LoopIndex;
+    if (sample < 0)
+        sample = 0;
+
+    return (double)sample / SoundData->InputFormat.freq;
+}
+
 PUBLIC void AudioPlayback::Dispose() {
+    if (Streaming) {
+        AudioManager::RemoveStreamingPlayback(this);
+        Streaming = false;
+    }
+    if (DecodeBuffer) {
+        Memory::Free(DecodeBuffer);
+        DecodeBuffer = NULL;
+    }
     if (Buffer) {
         Memory::Free(Buffer);
         Buffer = NULL;
@@ -84,6 +259,10 @@ PUBLIC void AudioPlayback::Dispose() {
         Memory::Free(UnconvertedSampleBuffer);
         UnconvertedSampleBuffer = NULL;
     }
+    if (MixSamples) {
+        Memory::Free(MixSamples);
+        MixSamples = NULL;
+    }
     if (ConversionStream) {
         SDL_FreeAudioStream(ConversionStream);
         ConversionStream = NULL;
@@ -98,20 +277,51 @@ PUBLIC void AudioPlayback::Dispose() {
     }
 }
 
+// Converts a sample index of the sound to one of its device samples
+PRIVATE Uint32 AudioPlayback::GetSharedSampleIndex(int sample) {
+    if (sample <= 0 || Format.freq <= 0)
+        return 0;
+
+    return (Uint32)((Uint64)sample * AudioManager::DeviceFormat.freq / Format.freq);
+}
+
+// Requests samples in the device format. They're put in BufferData, which
+// is usually Buffer, but for sounds that were decoded ahead of time, points
+// right into the sound's samples instead.
 PUBLIC int AudioPlayback::RequestSamples(int samples, bool loop, int sample_to_loop_to) {
+    if (SharedSamples) {
+        if (SharedSampleIndex >= SharedSampleCount && loop)
+            SharedSampleIndex = GetSharedSampleIndex(sample_to_loop_to);
+        if (SharedSampleIndex >= SharedSampleCount)
+            return AudioManager::REQUEST_EOF;
+
+        Uint32 count = SharedSampleCount - SharedSampleIndex;
+        if (count > (Uint32)samples)
+            count = (Uint32)samples;
+
+        BufferData = SharedSamples + SharedSampleIndex * DeviceBytesPerSample;
+        BufferedSamples = count;
+        SharedSampleIndex += count;
+        return (int)(count * DeviceBytesPerSample);
+    }
+
     if (!SoundData)
         return AudioManager::REQUEST_ERROR;
 
+    BufferData = Buffer;
+
     // If the format is the same, no need to convert.
     if (Format.freq == AudioManager::DeviceFormat.freq
     && Format.format == AudioManager::DeviceFormat.format
     && Format.channels == AudioManager::DeviceFormat.channels) {
-        int num_samples = SoundData->GetSamples(Buffer, samples, LoopIndex);
-        if (num_samples == 0 && loop) {
+        int num_samples = ReadSamples(Buffer, samples);
+        if (num_samples == 0 && loop && !Streaming) {
             SoundData->SeekSample(sample_to_loop_to);
-            num_samples = SoundData->GetSamples(Buffer, samples, LoopIndex);
+            num_samples = ReadSamples(Buffer, samples);
         }
 
+        if (num_samples < 0)
+            return AudioManager::REQUEST_CONVERTING;
         if (num_samples == 0)
             return AudioManager::REQUEST_EOF;
 
@@ -129,12 +339,18 @@ PUBLIC int AudioPlayback::RequestSamples(int samples, bool loop, int sample_to_l
     int availableBytes = SDL_AudioStreamAvailable(ConversionStream);
     if (availableBytes < samplesRequestedInBytes) {
         // Load extra samples if we have none
-        int num_samples = SoundData->GetSamples(UnconvertedSampleBuffer, samples * AUDIO_FIRST_LOAD_SAMPLE_BOOST, LoopIndex);
-        if (num_samples == 0 && loop) {
+        int num_samples = ReadSamples(UnconvertedSampleBuffer, samples * AUDIO_FIRST_LOAD_SAMPLE_BOOST);
+        if (num_samples == 0 && loop && !Streaming) {
             SoundData->SeekSample(sample_to_loop_to);
-            num_samples = SoundData->GetSamples(UnconvertedSampleBuffer, samples, LoopIndex);
+            num_samples = ReadSamples(UnconvertedSampleBuffer, samples);
         }
 
+        if (num_samples < 0) {
+            if (availableBytes == 0)
+                return AudioManager::REQUEST_CONVERTING;
+            else
+                goto CONVERT;
+        }
         if (num_samples == 0) {
             if (availableBytes == 0)
                 return AudioManager::REQUEST_EOF;
@@ -168,6 +384,17 @@ PUBLIC void AudioPlayback::Seek(int samples) {
     if (!SoundData)
         return;
 
+    BufferedSamples = 0;
+    ResetMix();
+
+    if (SharedSamples) {
+        SharedSampleIndex = GetSharedSampleIndex(samples);
+        return;
+    }
+    // The decoder thread owns a streaming playback's sound data
+    if (Streaming)
+        return;
+
     SoundData->SeekSample(samples);
 }
 
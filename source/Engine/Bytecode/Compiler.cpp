@@ -12,6 +12,7 @@ public:
     static bool                 ShowWarnings;
     static bool                 WriteDebugInfo;
     static bool                 WriteSourceFilename;
+    static bool                 OptimizeBytecode;
 
     class Compiler* Enclosing = nullptr;
     ObjFunction*    Function = nullptr;
@@ -35,6 +36,7 @@ public:
 #include <Engine/Bytecode/Compiler.h>
 #include <Engine/Bytecode/Bytecode.h>
 #include <Engine/Bytecode/GarbageCollector.h>
+#include <Engine/Bytecode/Optimizer.h>
 #include <Engine/Bytecode/ScriptManager.h>
 #include <Engine/Bytecode/Values.h>
 #include <Engine/IO/FileStream.h>
@@ -50,6 +52,7 @@ HashMap<Token>*      Compiler::TokenMap = NULL;
 bool                 Compiler::ShowWarnings = false;
 bool                 Compiler::WriteDebugInfo = false;
 bool                 Compiler::WriteSourceFilename = false;
+bool                 Compiler::OptimizeBytecode = false;
 
 #define Panic(returnMe) if (parser.PanicMode) { SynchronizeToken(); return returnMe; }
 
@@ -2942,6 +2945,23 @@ PUBLIC STATIC int    Compiler::DebugInstruction(Chunk* chunk, int offset) {
             return SimpleInstruction("OP_INHERIT", offset);
         case OP_METHOD:
             return MethodInstruction("OP_METHOD", chunk, offset);
+        case OP_ADD_LOCAL_LOCAL: {
+            printf("%-16s %9d %d\n", "OP_ADD_LOCAL_LOCAL", chunk->Code[offset + 1], chunk->Code[offset + 2]);
+            return offset + 3;
+        }
+        case OP_LESS_LOCAL_CONSTANT_JUMP_IF_FALSE: {
+            int constant = *(int*)&chunk->Code[offset + 2];
+            uint16_t jump = (uint16_t)(chunk->Code[offset + 6]);
+            jump |= chunk->Code[offset + 7] << 8;
+            printf("%-16s %9d '", "OP_LESS_LOCAL_CONSTANT_JUMP_IF_FALSE", chunk->Code[offset + 1]);
+            Values::PrintValue(NULL, (*chunk->Constants)[constant]);
+            printf("' -> %d\n", offset + 8 + jump);
+            return offset + 8;
+        }
+        case OP_INCREMENT_LOCAL:
+            return LocalInstruction("OP_INCREMENT_LOCAL", chunk, offset);
+        case OP_DECREMENT_LOCAL:
+            return LocalInstruction("OP_DECREMENT_LOCAL", chunk, offset);
         default:
             printf("\x1b[1;93mUnknown opcode %d\x1b[m\n", instruction);
             return offset + 1;
@@ -2969,6 +2989,7 @@ PUBLIC STATIC void   Compiler::Init() {
     Compiler::ShowWarnings = false;
     Compiler::WriteDebugInfo = true;
     Compiler::WriteSourceFilename = true;
+    Compiler::OptimizeBytecode = true;
 }
 PUBLIC STATIC void   Compiler::PrepareCompiling() {
     if (Compiler::TokenMap == NULL) {
@@ -3042,6 +3063,11 @@ PUBLIC bool          Compiler::Compile(const char* filename, const char* source,
     ConsumeToken(TOKEN_EOF, "Expected end of file.");
     Finish();
 
+    if (Compiler::OptimizeBytecode) {
+        for (size_t c = 0; c < Compiler::Functions.size(); c++)
+            Optimizer::OptimizeChunk(&Compiler::Functions[c]->Chunk);
+    }
+
     bool debugCompiler = false;
     Application::Settings->GetBool("dev", "debugCompiler", &debugCompiler);
     if (debugCompiler) {
@@ -4,12 +4,30 @@
 
 class GarbageCollector {
 public:
+    enum CollectorState {
+        STATE_IDLE,
+        STATE_MARK,
+        STATE_SWEEP,
+    };
+
     static vector<Obj*> GrayList;
+    static vector<Obj*> RememberedSet;
     static Obj*         RootObject;
+    static Obj*         YoungObject;
+    static Obj*         SweepObject;
+    static int          State;
+    static bool         MinorCollecting;
 
     static size_t       NextGC;
     static size_t       GarbageSize;
+    static size_t       CycleStartSize;
+    static size_t       YoungSize;
+    static size_t       NurserySize;
     static double       MaxTimeAlotted;
+    static double       CycleTime;
+    static int          CycleSteps;
+    static int          ObjectTypeFreed[MAX_OBJ_TYPE];
+    static int          ObjectTypeCounts[MAX_OBJ_TYPE];
 
     static bool         Print;
     static bool         FilterSweepEnabled;
@@ -24,16 +42,32 @@ public:
 #include <Engine/Bytecode/Compiler.h>
 #include <Engine/Diagnostics/Clock.h>
 #include <Engine/Diagnostics/Log.h>
+#include <Engine/Application.h>
 #include <Engine/Scene.h>
 
 #define GC_HEAP_GROW_FACTOR 2
 
+// How many objects are marked or swept between checks of the time budget
+#define GC_WORK_CHUNK 64
+
 vector<Obj*> GarbageCollector::GrayList;
+vector<Obj*> GarbageCollector::RememberedSet;
 Obj*         GarbageCollector::RootObject;
+Obj*         GarbageCollector::YoungObject = NULL;
+Obj*         GarbageCollector::SweepObject = NULL;
+int          GarbageCollector::State = STATE_IDLE;
+bool         GarbageCollector::MinorCollecting = false;
 
 size_t       GarbageCollector::NextGC = 1024;
 size_t       GarbageCollector::GarbageSize = 0;
+size_t       GarbageCollector::CycleStartSize = 0;
+size_t       GarbageCollector::YoungSize = 0;
+size_t       GarbageCollector::NurserySize = 0x40000; // 256 KiB
 double       GarbageCollector::MaxTimeAlotted = 1.0; // 1ms
+double       GarbageCollector::CycleTime = 0.0;
+int          GarbageCollector::CycleSteps = 0;
+int          GarbageCollector::ObjectTypeFreed[MAX_OBJ_TYPE];
+int          GarbageCollector::ObjectTypeCounts[MAX_OBJ_TYPE];
 
 bool         GarbageCollector::Print = false;
 bool         GarbageCollector::FilterSweepEnabled = false;
@@ -41,14 +75,214 @@ int          GarbageCollector::FilterSweepType = 0;
 
 PUBLIC STATIC void GarbageCollector::Init() {
     GarbageCollector::RootObject = NULL;
+    GarbageCollector::YoungObject = NULL;
+    GarbageCollector::SweepObject = NULL;
+    GarbageCollector::State = STATE_IDLE;
+    GarbageCollector::MinorCollecting = false;
     GarbageCollector::NextGC = 0x100000;
+    GarbageCollector::YoungSize = 0;
+    GarbageCollector::GrayList.clear();
+    GarbageCollector::RememberedSet.clear();
+
+    // A budget of 0 collects everything at once, as soon as it's due.
+    Application::Settings->GetDecimal("dev", "gcTimeBudget", &GarbageCollector::MaxTimeAlotted);
+
+    // A nursery size of 0 turns off minor collections.
+    int nurserySize = (int)GarbageCollector::NurserySize;
+    Application::Settings->GetInteger("dev", "gcNurserySize", &nurserySize);
+    GarbageCollector::NurserySize = nurserySize > 0 ? (size_t)nurserySize : 0;
 }
 
+// Collection is incremental: marking and sweeping are done in slices bounded
+// by MaxTimeAlotted, one slice per Step. Objects are white (not IsDark), gray
+// (IsDark and IsGray, waiting in GrayList) or black (IsDark only).
+// While marking, new objects start out gray, and WriteBarrier re-grays any
+// black object that gets a value stored into it. Roots are not barriered, so
+// they are grayed again and the gray list is emptied in one go right before
+// sweeping starts.
+// Between cycles, objects allocated since the last collection are kept in
+// a separate young list, and are collected on their own once NurserySize
+// bytes of them pile up (see MinorCollect).
+PUBLIC STATIC void GarbageCollector::Step() {
+    if (GarbageCollector::State == STATE_IDLE) {
+        if (GarbageCollector::GarbageSize <= GarbageCollector::NextGC) {
+            if (GarbageCollector::NurserySize && GarbageCollector::YoungSize > GarbageCollector::NurserySize)
+                GarbageCollector::MinorCollect();
+            return;
+        }
+
+        GarbageCollector::StartCycle();
+    }
+
+    double budget = GarbageCollector::MaxTimeAlotted;
+    if (budget <= 0.0) {
+        GarbageCollector::FinishCycle();
+        return;
+    }
+
+    double start = Clock::GetTicks();
+
+    GarbageCollector::CycleSteps++;
+
+    if (GarbageCollector::State == STATE_MARK) {
+        if (!GarbageCollector::Mark(start, budget)) {
+            GarbageCollector::CycleTime += Clock::GetTicks() - start;
+            return;
+        }
+
+        GarbageCollector::FinishMarking();
+    }
+
+    if (GarbageCollector::State == STATE_SWEEP) {
+        if (!GarbageCollector::Sweep(start, budget)) {
+            GarbageCollector::CycleTime += Clock::GetTicks() - start;
+            return;
+        }
+    }
+
+    GarbageCollector::CycleTime += Clock::GetTicks() - start;
+    GarbageCollector::EndCycle();
+}
 PUBLIC STATIC void GarbageCollector::Collect() {
+    // Objects that died during an unfinished cycle may have been marked
+    // already, so finish it first and then do a whole new one.
+    if (GarbageCollector::State != STATE_IDLE)
+        GarbageCollector::FinishCycle();
+
+    GarbageCollector::StartCycle();
+    GarbageCollector::FinishCycle();
+}
+PUBLIC STATIC void GarbageCollector::FinishCycle() {
+    if (GarbageCollector::State == STATE_IDLE)
+        return;
+
+    double start = Clock::GetTicks();
+
+    if (GarbageCollector::State == STATE_MARK)
+        GarbageCollector::FinishMarking();
+
+    GarbageCollector::Sweep(start, 0.0);
+    GarbageCollector::CycleTime += Clock::GetTicks() - start;
+    GarbageCollector::CycleSteps++;
+    GarbageCollector::EndCycle();
+}
+
+PUBLIC STATIC void GarbageCollector::WriteBarrier(Obj* object) {
+    if (!object)
+        return;
+
+    // An old object may now refer to young ones, so the next minor
+    // collection has to look inside it.
+    if (object->IsOld && !object->IsRemembered) {
+        object->IsRemembered = true;
+        RememberedSet.push_back(object);
+    }
+
+    if (GarbageCollector::State != STATE_MARK)
+        return;
+
+    // Only black objects need to be looked at again
+    if (!object->IsDark || object->IsGray)
+        return;
+
+    object->IsGray = true;
+    GrayList.push_back(object);
+}
+PUBLIC STATIC void GarbageCollector::WriteBarrier(VMValue value) {
+    if (!IS_OBJECT(value))
+        return;
+
+    WriteBarrier(AS_OBJECT(value));
+}
+PUBLIC STATIC void GarbageCollector::OnAllocate(Obj* object, size_t size) {
+    object->IsOld = false;
+    object->IsRemembered = false;
+    object->Next = GarbageCollector::YoungObject;
+    GarbageCollector::YoungObject = object;
+    GarbageCollector::YoungSize += size;
+
+    if (GarbageCollector::State == STATE_MARK)
+        GrayObject(object);
+}
+
+// Collects only the young objects. Old objects are assumed to be alive and
+// are not traced, except for the ones in the remembered set, which are the
+// only old objects that can refer to young ones. Young objects that are
+// still reachable are promoted: they are moved to the old list, in place.
+PRIVATE STATIC void GarbageCollector::MinorCollect() {
+    double start = Clock::GetTicks();
+    size_t startSize = GarbageCollector::GarbageSize;
+    int freed = 0, promoted = 0;
+
     GrayList.clear();
+    GarbageCollector::MinorCollecting = true;
+
+    GarbageCollector::GrayRoots();
+    for (size_t i = 0; i < RememberedSet.size(); i++) {
+        BlackenObject(RememberedSet[i]);
+        RememberedSet[i]->IsRemembered = false;
+    }
+    RememberedSet.clear();
+    GarbageCollector::Mark(0.0, 0.0);
+
+    GarbageCollector::MinorCollecting = false;
+
+    for (Obj* object = GarbageCollector::YoungObject, *next; object; object = next) {
+        next = object->Next;
 
-    double grayElapsed = Clock::GetTicks();
+        if (!object->IsDark) {
+            freed++;
+            GarbageCollector::FreeValue(OBJECT_VAL(object));
+        }
+        else {
+            promoted++;
+            object->IsDark = false;
+            object->IsOld = true;
+            object->Next = GarbageCollector::RootObject;
+            GarbageCollector::RootObject = object;
+        }
+    }
+    GarbageCollector::YoungObject = NULL;
+    GarbageCollector::YoungSize = 0;
 
+    Log::Print(Log::LOG_VERBOSE, "%04X: Minor collection freed %d object(s), promoted %d (%d bytes) in %.1f ms", Scene::Frame, freed, promoted, (int)(startSize - GarbageCollector::GarbageSize), Clock::GetTicks() - start);
+}
+// Moves every young object to the old list, so a full cycle sees all of
+// them. Nothing young is left afterwards, so the remembered set is
+// dropped too.
+PRIVATE STATIC void GarbageCollector::PromoteAll() {
+    for (Obj* object = GarbageCollector::YoungObject, *next; object; object = next) {
+        next = object->Next;
+
+        object->IsOld = true;
+        object->Next = GarbageCollector::RootObject;
+        GarbageCollector::RootObject = object;
+    }
+    GarbageCollector::YoungObject = NULL;
+    GarbageCollector::YoungSize = 0;
+
+    for (size_t i = 0; i < RememberedSet.size(); i++)
+        RememberedSet[i]->IsRemembered = false;
+    RememberedSet.clear();
+}
+
+PRIVATE STATIC void GarbageCollector::StartCycle() {
+    GrayList.clear();
+    GarbageCollector::PromoteAll();
+
+    memset(ObjectTypeFreed, 0, sizeof(ObjectTypeFreed));
+    memset(ObjectTypeCounts, 0, sizeof(ObjectTypeCounts));
+
+    GarbageCollector::CycleStartSize = GarbageCollector::GarbageSize;
+    GarbageCollector::CycleTime = 0.0;
+    GarbageCollector::CycleSteps = 0;
+    GarbageCollector::State = STATE_MARK;
+
+    double start = Clock::GetTicks();
+    GarbageCollector::GrayRoots();
+    GarbageCollector::CycleTime += Clock::GetTicks() - start;
+}
+PRIVATE STATIC void GarbageCollector::GrayRoots() {
     // Mark threads (should lock here for safety)
     for (Uint32 t = 0; t < ScriptManager::ThreadCount; t++) {
         VMThread* thread = ScriptManager::Threads + t;
@@ -56,6 +290,7 @@ PUBLIC STATIC void GarbageCollector::Collect() {
         for (VMValue* slot = thread->Stack; slot < thread->StackTop; slot++) {
             GrayValue(*slot);
         }
+        GrayValue(thread->RegisterValue);
         // Mark frame functions
         for (Uint32 i = 0; i < thread->FrameCount; i++) {
             GrayObject(thread->Frames[i].Function);
@@ -104,55 +339,81 @@ PUBLIC STATIC void GarbageCollector::Collect() {
     for (size_t i = 0; i < ScriptManager::ClassImplList.size(); i++) {
         GrayObject(ScriptManager::ClassImplList[i]);
     }
-
-    grayElapsed = Clock::GetTicks() - grayElapsed;
-
-    double blackenElapsed = Clock::GetTicks();
-
-    // Traverse references
-    for (size_t i = 0; i < GrayList.size(); i++) {
-        BlackenObject(GrayList[i]);
+}
+// Returns true once there is nothing left to mark.
+PRIVATE STATIC bool GarbageCollector::Mark(double start, double budget) {
+    int work = 0;
+    while (GrayList.size()) {
+        Obj* object = GrayList.back();
+        GrayList.pop_back();
+        BlackenObject(object);
+
+        if (budget > 0.0 && ++work == GC_WORK_CHUNK) {
+            if (Clock::GetTicks() - start >= budget)
+                return false;
+            work = 0;
+        }
     }
+    return true;
+}
+PRIVATE STATIC void GarbageCollector::FinishMarking() {
+    GarbageCollector::GrayRoots();
+    // Objects remembered during this cycle are kept alive until the next
+    // one, since a minor collection may still read through them.
+    for (size_t i = 0; i < RememberedSet.size(); i++)
+        GrayObject(RememberedSet[i]);
+    GarbageCollector::Mark(0.0, 0.0);
+
+    // Survivors are put back on a fresh list as they're swept. New objects
+    // go to the young list, so the sweep never sees (and never frees) them.
+    GarbageCollector::SweepObject = GarbageCollector::RootObject;
+    GarbageCollector::RootObject = NULL;
+    GarbageCollector::State = STATE_SWEEP;
+}
+// Returns true once every object has been swept.
+PRIVATE STATIC bool GarbageCollector::Sweep(double start, double budget) {
+    int work = 0;
+    while (GarbageCollector::SweepObject != NULL) {
+        Obj* object = GarbageCollector::SweepObject;
+        GarbageCollector::SweepObject = object->Next;
 
-    blackenElapsed = Clock::GetTicks() - blackenElapsed;
-
-    double freeElapsed = Clock::GetTicks();
-
-    int objectTypeFreed[MAX_OBJ_TYPE] = { 0 };
-    int objectTypeCounts[MAX_OBJ_TYPE] = { 0 };
-
-    // Collect the white objects
-    Obj** object = &GarbageCollector::RootObject;
-    while (*object != NULL) {
-        objectTypeCounts[(*object)->Type]++;
-
-        if (!((*object)->IsDark)) {
-            objectTypeFreed[(*object)->Type]++;
+        ObjectTypeCounts[object->Type]++;
 
-            // This object wasn't reached, so remove it from the list and
-            // free it.
-            Obj* unreached = *object;
-            *object = unreached->Next;
+        if (!object->IsDark) {
+            // This object wasn't reached, so free it.
+            ObjectTypeFreed[object->Type]++;
 
-            GarbageCollector::FreeValue(OBJECT_VAL(unreached));
+            GarbageCollector::FreeValue(OBJECT_VAL(object));
         }
         else {
             // This object was reached, so unmark it (for the next GC) and
-            // move on to the next.
-            (*object)->IsDark = false;
-            object = &(*object)->Next;
+            // put it back in the list.
+            object->IsDark = false;
+            object->Next = GarbageCollector::RootObject;
+            GarbageCollector::RootObject = object;
+        }
+
+        if (budget > 0.0 && ++work == GC_WORK_CHUNK) {
+            if (Clock::GetTicks() - start >= budget)
+                return false;
+            work = 0;
         }
     }
+    return true;
+}
+PRIVATE STATIC void GarbageCollector::EndCycle() {
+    GarbageCollector::State = STATE_IDLE;
 
-    freeElapsed = Clock::GetTicks() - freeElapsed;
+    // Young objects made during the cycle were never swept, so they may
+    // still be marked.
+    for (Obj* object = GarbageCollector::YoungObject; object; object = object->Next)
+        object->IsDark = false;
 
-    Log::Print(Log::LOG_VERBOSE, "Sweep: Graying took %.1f ms", grayElapsed);
-    Log::Print(Log::LOG_VERBOSE, "Sweep: Blackening took %.1f ms", blackenElapsed);
-    Log::Print(Log::LOG_VERBOSE, "Sweep: Freeing took %.1f ms", freeElapsed);
+    Log::Print(Log::LOG_VERBOSE, "Sweep: Collection took %.1f ms over %d step(s)", GarbageCollector::CycleTime, GarbageCollector::CycleSteps);
 
 #define LOG_ME(type) \
-    if (objectTypeCounts[type]) \
-        Log::Print(Log::LOG_VERBOSE, "Freed %d " #type " objects out of %d.", objectTypeFreed[type], objectTypeCounts[type])
+    if (ObjectTypeCounts[type]) \
+        Log::Print(Log::LOG_VERBOSE, "Freed %d " #type " objects out of %d.", ObjectTypeFreed[type], ObjectTypeCounts[type])
 
     LOG_ME(OBJ_BOUND_METHOD);
     LOG_ME(OBJ_CLASS);
@@ -170,6 +431,8 @@ PUBLIC STATIC void GarbageCollector::Collect() {
 #undef LOG_ME
 
     GarbageCollector::NextGC = GarbageCollector::GarbageSize + (1024 * 1024);
+
+    Log::Print(Log::LOG_INFO, "%04X: Freed garbage from %u to %u (%d), next GC at %d", Scene::Frame, (Uint32)GarbageCollector::CycleStartSize, (Uint32)GarbageCollector::GarbageSize, (int)(GarbageCollector::GarbageSize - GarbageCollector::CycleStartSize), (int)GarbageCollector::NextGC);
 }
 
 PRIVATE STATIC void GarbageCollector::FreeValue(VMValue value) {
@@ -195,8 +458,10 @@ PRIVATE STATIC void GarbageCollector::GrayObject(void* obj) {
 
     Obj* object = (Obj*)obj;
     if (object->IsDark) return;
+    if (object->IsOld && GarbageCollector::MinorCollecting) return;
 
     object->IsDark = true;
+    object->IsGray = true;
 
     GrayList.push_back(object);
 }
@@ -209,6 +474,8 @@ PRIVATE STATIC void GarbageCollector::GrayHashMap(void* pointer) {
 }
 
 PRIVATE STATIC void GarbageCollector::BlackenObject(Obj* object) {
+    object->IsGray = false;
+
     GrayObject(object->Class);
 
     switch (object->Type) {
@@ -249,7 +516,9 @@ PRIVATE STATIC void GarbageCollector::BlackenObject(Obj* object) {
         }
         case OBJ_INSTANCE: {
             ObjInstance* instance = (ObjInstance*)object;
-            GrayHashMap(instance->Fields);
+            for (int i = 0; i < instance->Shape->SlotCount; i++) {
+                GrayValue(instance->Fields[i]);
+            }
             break;
         }
         case OBJ_ARRAY: {
@@ -0,0 +1,606 @@
+#if INTERFACE
+#include <Engine/Includes/Standard.h>
+#include <Engine/Bytecode/Types.h>
+
+class Optimizer {
+public:
+};
+#endif
+
+#include <Engine/Bytecode/Optimizer.h>
+
+// The optimizer works on a decoded copy of the chunk. Every transform only
+// ever shrinks or keeps the size of the code, so the chunk is re-encoded in
+// place and jump offsets are recomputed from instruction indices afterwards.
+
+#define MAX_INSTRUCTION_SIZE 8
+
+enum {
+    JUMP_NONE = 0,
+    JUMP_FORWARD = 1,
+    JUMP_BACKWARD = -1,
+};
+
+struct OptInstruction {
+    Uint8 Code[MAX_INSTRUCTION_SIZE];
+    int   Length;
+    int   Line;
+    int   Offset;
+    // Jump operand position inside Code, and which way it jumps
+    int   JumpOperand;
+    int   JumpSign;
+    int   Target;
+    bool  IsTarget;
+    bool  Removed;
+};
+
+static Uint16 ReadOperand16(Uint8* code) {
+    return (Uint16)(code[0] | (code[1] << 8));
+}
+static Uint32 ReadOperand32(Uint8* code) {
+    return (Uint32)code[0] | ((Uint32)code[1] << 8) | ((Uint32)code[2] << 16) | ((Uint32)code[3] << 24);
+}
+static void   WriteOperand16(Uint8* code, Uint16 value) {
+    code[0] = value & 0xFF;
+    code[1] = value >> 8 & 0xFF;
+}
+static void   WriteOperand32(Uint8* code, Uint32 value) {
+    code[0] = value & 0xFF;
+    code[1] = value >> 8 & 0xFF;
+    code[2] = value >> 16 & 0xFF;
+    code[3] = value >> 24 & 0xFF;
+}
+
+// Returns -1 for anything the optimizer does not know how to move around.
+static int  GetInstructionLength(Chunk* chunk, int offset, int* jumpOperand, int* jumpSign) {
+    *jumpOperand = -1;
+    *jumpSign = JUMP_NONE;
+
+    switch (chunk->Code[offset]) {
+        case OP_CONSTANT:
+        case OP_DEFINE_GLOBAL:
+        case OP_GET_PROPERTY:
+        case OP_SET_PROPERTY:
+        case OP_HAS_PROPERTY:
+        case OP_GET_GLOBAL:
+        case OP_SET_GLOBAL:
+        case OP_INHERIT:
+        case OP_NEW_ARRAY:
+        case OP_NEW_MAP:
+        case OP_IMPORT:
+        case OP_IMPORT_MODULE:
+        case OP_ADD_ENUM:
+        case OP_NEW_ENUM:
+            return 5;
+        case OP_GET_LOCAL:
+        case OP_SET_LOCAL:
+        case OP_CALL:
+        case OP_COPY:
+        case OP_EVENT:
+        case OP_NEW:
+        case OP_POPN:
+        case OP_INCREMENT_LOCAL:
+        case OP_DECREMENT_LOCAL:
+            return 2;
+        case OP_ADD_LOCAL_LOCAL:
+            return 3;
+        case OP_METHOD:
+        case OP_CLASS:
+            return 6;
+        case OP_INVOKE:
+            return 7;
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+            *jumpOperand = 1;
+            *jumpSign = JUMP_FORWARD;
+            return 3;
+        case OP_JUMP_BACK:
+            *jumpOperand = 1;
+            *jumpSign = JUMP_BACKWARD;
+            return 3;
+        case OP_LESS_LOCAL_CONSTANT_JUMP_IF_FALSE:
+            *jumpOperand = 6;
+            *jumpSign = JUMP_FORWARD;
+            return 8;
+        case OP_WITH: {
+            if (offset + 1 >= chunk->Count)
+                return -1;
+            switch (chunk->Code[offset + 1]) {
+                // WITH_STATE_INIT
+                case 0:
+                    *jumpOperand = 2;
+                    *jumpSign = JUMP_FORWARD;
+                    return 4;
+                // WITH_STATE_ITERATE
+                case 1:
+                    *jumpOperand = 2;
+                    *jumpSign = JUMP_BACKWARD;
+                    return 4;
+                // WITH_STATE_FINISH
+                case 2:
+                    return 4;
+                // WITH_STATE_INIT_SLOTTED
+                case 3:
+                    *jumpOperand = 3;
+                    *jumpSign = JUMP_FORWARD;
+                    return 5;
+            }
+            return -1;
+        }
+        case OP_PRINT_STACK:
+        case OP_RETURN:
+        case OP_POP:
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_MODULO:
+        case OP_NEGATE:
+        case OP_INCREMENT:
+        case OP_DECREMENT:
+        case OP_BITSHIFT_LEFT:
+        case OP_BITSHIFT_RIGHT:
+        case OP_NULL:
+        case OP_TRUE:
+        case OP_FALSE:
+        case OP_BW_NOT:
+        case OP_BW_AND:
+        case OP_BW_OR:
+        case OP_BW_XOR:
+        case OP_LG_NOT:
+        case OP_LG_AND:
+        case OP_LG_OR:
+        case OP_EQUAL:
+        case OP_EQUAL_NOT:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_PRINT:
+        case OP_ENUM_NEXT:
+        case OP_SAVE_VALUE:
+        case OP_LOAD_VALUE:
+        case OP_GET_ELEMENT:
+        case OP_SET_ELEMENT:
+        case OP_TYPEOF:
+            return 1;
+    }
+
+    // Switches and failsafes store raw code offsets in places the optimizer
+    // would have to rewrite, so chunks that use them are left alone.
+    return -1;
+}
+
+static bool Decode(Chunk* chunk, vector<OptInstruction>& list) {
+    vector<int> indexAt(chunk->Count + 1, -1);
+
+    for (int offset = 0; offset < chunk->Count;) {
+        OptInstruction ins;
+        ins.Length = GetInstructionLength(chunk, offset, &ins.JumpOperand, &ins.JumpSign);
+        if (ins.Length < 0 || offset + ins.Length > chunk->Count)
+            return false;
+
+        memcpy(ins.Code, &chunk->Code[offset], ins.Length);
+        ins.Line = chunk->Lines ? chunk->Lines[offset] : 0;
+        ins.Offset = offset;
+        ins.Target = -1;
+        ins.IsTarget = false;
+        ins.Removed = false;
+
+        indexAt[offset] = (int)list.size();
+        list.push_back(ins);
+
+        offset += ins.Length;
+    }
+    indexAt[chunk->Count] = (int)list.size();
+
+    for (size_t i = 0; i < list.size(); i++) {
+        OptInstruction* ins = &list[i];
+        if (ins->JumpSign == JUMP_NONE)
+            continue;
+
+        int jump = ReadOperand16(&ins->Code[ins->JumpOperand]);
+        int target = ins->Offset + ins->Length + ins->JumpSign * jump;
+        if (target < 0 || target > chunk->Count || indexAt[target] < 0)
+            return false;
+
+        ins->Target = indexAt[target];
+        if (ins->Target < (int)list.size())
+            list[ins->Target].IsTarget = true;
+    }
+
+    return true;
+}
+static void Encode(Chunk* chunk, vector<OptInstruction>& list) {
+    // A removed instruction that was jumped to hands its incoming jumps to
+    // the next instruction that is still there.
+    vector<int> offsetOf(list.size() + 1);
+    int offset = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+        offsetOf[i] = offset;
+        if (!list[i].Removed)
+            offset += list[i].Length;
+    }
+    offsetOf[list.size()] = offset;
+
+    int count = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+        OptInstruction* ins = &list[i];
+        if (ins->Removed)
+            continue;
+
+        if (ins->JumpSign != JUMP_NONE) {
+            int from = count + ins->Length;
+            int jump = (offsetOf[ins->Target] - from) * ins->JumpSign;
+            WriteOperand16(&ins->Code[ins->JumpOperand], (Uint16)jump);
+        }
+
+        for (int b = 0; b < ins->Length; b++) {
+            chunk->Code[count] = ins->Code[b];
+            if (chunk->Lines)
+                chunk->Lines[count] = ins->Line;
+            count++;
+        }
+    }
+
+    chunk->Count = count;
+}
+
+static int  NextInstruction(vector<OptInstruction>& list, int index) {
+    for (int i = index + 1; i < (int)list.size(); i++) {
+        if (!list[i].Removed)
+            return i;
+    }
+    return -1;
+}
+// Collects up to 'count' live instructions starting at 'index'. Only the first
+// one may be a jump target, so that fusing never changes where a jump lands.
+static bool GetSequence(vector<OptInstruction>& list, int index, int* out, int count) {
+    out[0] = index;
+    for (int i = 1; i < count; i++) {
+        out[i] = NextInstruction(list, out[i - 1]);
+        if (out[i] < 0 || list[out[i]].IsTarget)
+            return false;
+    }
+    return true;
+}
+static void RemoveInstruction(vector<OptInstruction>& list, int index) {
+    list[index].Removed = true;
+
+    // Jumps to it now land on whatever follows
+    if (list[index].IsTarget) {
+        int next = NextInstruction(list, index);
+        if (next >= 0)
+            list[next].IsTarget = true;
+    }
+}
+
+static bool IsConstantNumber(Chunk* chunk, OptInstruction* ins, VMValue* value) {
+    if (ins->Code[0] != OP_CONSTANT)
+        return false;
+
+    Uint32 index = ReadOperand32(&ins->Code[1]);
+    if (index >= chunk->Constants->size())
+        return false;
+
+    *value = (*chunk->Constants)[index];
+    return value->Type == VAL_INTEGER || value->Type == VAL_DECIMAL;
+}
+static int  GetNumberConstant(Chunk* chunk, VMValue value) {
+    for (size_t i = 0; i < chunk->Constants->size(); i++) {
+        VMValue other = (*chunk->Constants)[i];
+        if (other.Type != value.Type)
+            continue;
+        if (value.Type == VAL_INTEGER && AS_INTEGER(other) == AS_INTEGER(value))
+            return (int)i;
+        if (value.Type == VAL_DECIMAL && memcmp(&other.as.Decimal, &value.as.Decimal, sizeof(float)) == 0)
+            return (int)i;
+    }
+    return chunk->AddConstant(value);
+}
+
+// These mirror the VMThread::Values_* operations exactly. Anything that would
+// raise a runtime error is left for the VM to report.
+static bool FoldBinary(Uint8 op, VMValue a, VMValue b, VMValue* result) {
+    if (a.Type == VAL_DECIMAL || b.Type == VAL_DECIMAL) {
+        float a_d = a.Type == VAL_DECIMAL ? AS_DECIMAL(a) : (float)AS_INTEGER(a);
+        float b_d = b.Type == VAL_DECIMAL ? AS_DECIMAL(b) : (float)AS_INTEGER(b);
+        switch (op) {
+            case OP_ADD:      *result = DECIMAL_VAL(a_d + b_d); return true;
+            case OP_SUBTRACT: *result = DECIMAL_VAL(a_d - b_d); return true;
+            case OP_MULTIPLY: *result = DECIMAL_VAL(a_d * b_d); return true;
+            case OP_DIVIDE:
+                if (b_d == 0.0)
+                    return false;
+                *result = DECIMAL_VAL(a_d / b_d);
+                return true;
+            case OP_MODULO:
+                if (b_d == 0.0)
+                    return false;
+                *result = DECIMAL_VAL(fmod(a_d, b_d));
+                return true;
+        }
+        // Bit operations on decimals go through int
+        if (a_d != a_d || b_d != b_d || fabs(a_d) >= 2147483648.0f || fabs(b_d) >= 2147483648.0f)
+            return false;
+
+        int a_i = (int)a_d;
+        int b_i = (int)b_d;
+        switch (op) {
+            case OP_BITSHIFT_LEFT:
+                if (a_i < 0 || b_i < 0 || b_i > 31)
+                    return false;
+                *result = DECIMAL_VAL((float)(a_i << b_i));
+                return true;
+            case OP_BITSHIFT_RIGHT:
+                if (b_i < 0 || b_i > 31)
+                    return false;
+                *result = DECIMAL_VAL((float)(a_i >> b_i));
+                return true;
+            case OP_BW_AND: *result = DECIMAL_VAL((float)(a_i & b_i)); return true;
+            case OP_BW_OR:  *result = DECIMAL_VAL((float)(a_i | b_i)); return true;
+            case OP_BW_XOR: *result = DECIMAL_VAL((float)(a_i ^ b_i)); return true;
+        }
+        return false;
+    }
+
+    int a_i = AS_INTEGER(a);
+    int b_i = AS_INTEGER(b);
+    switch (op) {
+        // Integer math wraps at runtime, so fold it the same way
+        case OP_ADD:      *result = INTEGER_VAL((int)((Uint32)a_i + (Uint32)b_i)); return true;
+        case OP_SUBTRACT: *result = INTEGER_VAL((int)((Uint32)a_i - (Uint32)b_i)); return true;
+        case OP_MULTIPLY: *result = INTEGER_VAL((int)((Uint32)a_i * (Uint32)b_i)); return true;
+        case OP_DIVIDE:
+            if (b_i == 0 || (a_i == INT_MIN && b_i == -1))
+                return false;
+            *result = INTEGER_VAL(a_i / b_i);
+            return true;
+        case OP_MODULO:
+            if (b_i == 0 || (a_i == INT_MIN && b_i == -1))
+                return false;
+            *result = INTEGER_VAL(a_i % b_i);
+            return true;
+        case OP_BITSHIFT_LEFT:
+            if (a_i < 0 || b_i < 0 || b_i > 31)
+                return false;
+            *result = INTEGER_VAL((int)((Uint32)a_i << b_i));
+            return true;
+        case OP_BITSHIFT_RIGHT:
+            if (b_i < 0 || b_i > 31)
+                return false;
+            *result = INTEGER_VAL(a_i >> b_i);
+            return true;
+        case OP_BW_AND: *result = INTEGER_VAL(a_i & b_i); return true;
+        case OP_BW_OR:  *result = INTEGER_VAL(a_i | b_i); return true;
+        case OP_BW_XOR: *result = INTEGER_VAL(a_i ^ b_i); return true;
+    }
+    return false;
+}
+static bool FoldUnary(Uint8 op, VMValue a, VMValue* result) {
+    if (op != OP_NEGATE)
+        return false;
+
+    if (a.Type == VAL_DECIMAL)
+        *result = DECIMAL_VAL(-AS_DECIMAL(a));
+    else if (AS_INTEGER(a) == INT_MIN)
+        return false;
+    else
+        *result = INTEGER_VAL(-AS_INTEGER(a));
+    return true;
+}
+static void SetConstant(Chunk* chunk, OptInstruction* ins, VMValue value) {
+    ins->Code[0] = OP_CONSTANT;
+    WriteOperand32(&ins->Code[1], (Uint32)GetNumberConstant(chunk, value));
+    ins->Length = 5;
+}
+static bool FoldConstants(Chunk* chunk, vector<OptInstruction>& list) {
+    bool changed = false;
+    int seq[3];
+    VMValue a, b, result;
+
+    for (int i = 0; i < (int)list.size(); i++) {
+        if (list[i].Removed || !IsConstantNumber(chunk, &list[i], &a))
+            continue;
+
+        // CONSTANT, NEGATE
+        if (GetSequence(list, i, seq, 2)
+            && FoldUnary(list[seq[1]].Code[0], a, &result)) {
+            SetConstant(chunk, &list[i], result);
+            RemoveInstruction(list, seq[1]);
+            changed = true;
+            i--;
+            continue;
+        }
+
+        // CONSTANT, CONSTANT, <binary op>
+        if (GetSequence(list, i, seq, 3)
+            && IsConstantNumber(chunk, &list[seq[1]], &b)
+            && FoldBinary(list[seq[2]].Code[0], a, b, &result)) {
+            SetConstant(chunk, &list[i], result);
+            RemoveInstruction(list, seq[1]);
+            RemoveInstruction(list, seq[2]);
+            changed = true;
+            i--;
+            continue;
+        }
+    }
+
+    return changed;
+}
+
+// The register written by OP_SAVE_VALUE is only ever read back within the
+// same straight run of code by the compiler's own output; this checks that
+// the chunk actually follows that rule before any save is dropped.
+static bool RegisterIsLocal(vector<OptInstruction>& list) {
+    bool saved = false;
+    for (size_t i = 0; i < list.size(); i++) {
+        if (list[i].Removed)
+            continue;
+        if (list[i].IsTarget)
+            saved = false;
+
+        switch (list[i].Code[0]) {
+            case OP_SAVE_VALUE:
+                saved = true;
+                break;
+            case OP_LOAD_VALUE:
+                if (!saved)
+                    return false;
+                break;
+        }
+
+        if (list[i].JumpSign != JUMP_NONE)
+            saved = false;
+    }
+    return true;
+}
+static bool SavedValueIsRead(vector<OptInstruction>& list, int index) {
+    for (int i = NextInstruction(list, index); i >= 0; i = NextInstruction(list, i)) {
+        if (list[i].IsTarget)
+            return false;
+
+        switch (list[i].Code[0]) {
+            case OP_LOAD_VALUE:
+                return true;
+            case OP_SAVE_VALUE:
+            case OP_RETURN:
+                return false;
+        }
+
+        if (list[i].JumpSign != JUMP_NONE)
+            return false;
+    }
+    return false;
+}
+static bool RemoveRedundant(vector<OptInstruction>& list) {
+    bool changed = false;
+    bool registerIsLocal = RegisterIsLocal(list);
+    int seq[2];
+
+    for (int i = 0; i < (int)list.size(); i++) {
+        if (list[i].Removed || !GetSequence(list, i, seq, 2))
+            continue;
+
+        OptInstruction* first = &list[seq[0]];
+        OptInstruction* second = &list[seq[1]];
+
+        // Pushing a value only to pop it again does nothing
+        if ((first->Code[0] == OP_LOAD_VALUE || (first->Code[0] == OP_COPY && first->Code[1] == 1))
+            && second->Code[0] == OP_POP) {
+            RemoveInstruction(list, seq[0]);
+            RemoveInstruction(list, seq[1]);
+            changed = true;
+            continue;
+        }
+
+        // Postfix increments save the old value even when nothing loads it
+        if (registerIsLocal
+            && first->Code[0] == OP_COPY && first->Code[1] == 1
+            && second->Code[0] == OP_SAVE_VALUE
+            && !SavedValueIsRead(list, seq[1])) {
+            RemoveInstruction(list, seq[0]);
+            RemoveInstruction(list, seq[1]);
+            changed = true;
+            continue;
+        }
+
+        // POP, POP -> POPN
+        int firstCount = first->Code[0] == OP_POP ? 1 : first->Code[0] == OP_POPN ? first->Code[1] : 0;
+        int secondCount = second->Code[0] == OP_POP ? 1 : second->Code[0] == OP_POPN ? second->Code[1] : 0;
+        if (firstCount && secondCount && firstCount + secondCount <= 0xFF) {
+            first->Code[0] = OP_POPN;
+            first->Code[1] = (Uint8)(firstCount + secondCount);
+            first->Length = 2;
+            RemoveInstruction(list, seq[1]);
+            changed = true;
+            i--;
+            continue;
+        }
+    }
+
+    return changed;
+}
+
+static bool FuseInstructions(vector<OptInstruction>& list) {
+    bool changed = false;
+    int seq[4];
+
+    for (int i = 0; i < (int)list.size(); i++) {
+        OptInstruction* ins = &list[i];
+        if (ins->Removed || ins->Code[0] != OP_GET_LOCAL)
+            continue;
+
+        // GET_LOCAL a, CONSTANT b, LESS, JUMP_IF_FALSE
+        if (GetSequence(list, i, seq, 4)
+            && list[seq[1]].Code[0] == OP_CONSTANT
+            && list[seq[2]].Code[0] == OP_LESS
+            && list[seq[3]].Code[0] == OP_JUMP_IF_FALSE) {
+            Uint8 slot = ins->Code[1];
+            ins->Code[0] = OP_LESS_LOCAL_CONSTANT_JUMP_IF_FALSE;
+            ins->Code[1] = slot;
+            memcpy(&ins->Code[2], &list[seq[1]].Code[1], 4);
+            ins->Length = 8;
+            ins->JumpOperand = 6;
+            ins->JumpSign = JUMP_FORWARD;
+            ins->Target = list[seq[3]].Target;
+            RemoveInstruction(list, seq[1]);
+            RemoveInstruction(list, seq[2]);
+            RemoveInstruction(list, seq[3]);
+            changed = true;
+            continue;
+        }
+
+        // GET_LOCAL a, GET_LOCAL b, ADD
+        if (GetSequence(list, i, seq, 3)
+            && list[seq[1]].Code[0] == OP_GET_LOCAL
+            && list[seq[2]].Code[0] == OP_ADD) {
+            ins->Code[0] = OP_ADD_LOCAL_LOCAL;
+            ins->Code[2] = list[seq[1]].Code[1];
+            ins->Length = 3;
+            RemoveInstruction(list, seq[1]);
+            RemoveInstruction(list, seq[2]);
+            changed = true;
+            continue;
+        }
+
+        // GET_LOCAL a, INCREMENT, SET_LOCAL a, POP
+        if (GetSequence(list, i, seq, 4)
+            && (list[seq[1]].Code[0] == OP_INCREMENT || list[seq[1]].Code[0] == OP_DECREMENT)
+            && list[seq[2]].Code[0] == OP_SET_LOCAL
+            && list[seq[2]].Code[1] == ins->Code[1]
+            && list[seq[3]].Code[0] == OP_POP) {
+            ins->Code[0] = list[seq[1]].Code[0] == OP_INCREMENT ? OP_INCREMENT_LOCAL : OP_DECREMENT_LOCAL;
+            ins->Length = 2;
+            RemoveInstruction(list, seq[1]);
+            RemoveInstruction(list, seq[2]);
+            RemoveInstruction(list, seq[3]);
+            changed = true;
+            continue;
+        }
+    }
+
+    return changed;
+}
+
+PUBLIC STATIC bool Optimizer::OptimizeChunk(Chunk* chunk) {
+    if (!chunk->Code || chunk->Count == 0)
+        return false;
+
+    vector<OptInstruction> list;
+    if (!Decode(chunk, list))
+        return false;
+
+    bool changed = false;
+    while (FoldConstants(chunk, list))
+        changed = true;
+    while (RemoveRedundant(list))
+        changed = true;
+    if (FuseInstructions(list))
+        changed = true;
+
+    if (changed)
+        Encode(chunk, list);
+
+    return changed;
+}
@@ -5,6 +5,7 @@
 class ScriptEntity : public Entity {
 public:
     static bool DisableAutoAnimate;
+    static InstanceShape* LinkedShape;
 
     ObjInstance* Instance = NULL;
     HashMap<VMValue>* Properties;
@@ -17,10 +18,17 @@ public:
 #include <Engine/Scene.h>
 
 bool ScriptEntity::DisableAutoAnimate = false;
+InstanceShape* ScriptEntity::LinkedShape = NULL;
 
-#define LINK_INT(VAR) Instance->Fields->Put(#VAR, INTEGER_LINK_VAL(&VAR))
-#define LINK_DEC(VAR) Instance->Fields->Put(#VAR, DECIMAL_LINK_VAL(&VAR))
-#define LINK_BOOL(VAR) Instance->Fields->Put(#VAR, INTEGER_LINK_VAL(&VAR))
+#define LINK_FIELD(NAME, VALUE) { \
+    if (linkSlots) \
+        Instance->Fields[linkIndex++] = VALUE; \
+    else \
+        PutInstanceField(Instance, Murmur::EncryptString(NAME), VALUE); \
+}
+#define LINK_INT(VAR) LINK_FIELD(#VAR, INTEGER_LINK_VAL(&VAR))
+#define LINK_DEC(VAR) LINK_FIELD(#VAR, DECIMAL_LINK_VAL(&VAR))
+#define LINK_BOOL(VAR) LINK_FIELD(#VAR, INTEGER_LINK_VAL(&VAR))
 
 bool   SavedHashes = false;
 Uint32 Hash_Create = 0;
@@ -64,6 +72,15 @@ PUBLIC void ScriptEntity::Link(ObjInstance* instance) {
 }
 
 PUBLIC void ScriptEntity::LinkFields() {
+    // The built-in fields are always linked in the same order, so every
+    // instance that starts out empty ends up with the same shape. Once the
+    // first one has built it, the rest only need their slots filled in.
+    bool fromEmpty = Instance->Shape->SlotCount == 0;
+    bool linkSlots = fromEmpty && LinkedShape;
+    int linkIndex = 0;
+    if (linkSlots)
+        SetInstanceShape(Instance, LinkedShape);
+
     /***
     * \field X
     * \type Decimal
@@ -344,7 +361,7 @@ PUBLIC void ScriptEntity::LinkFields() {
     * \ns Instance
     * \desc The horizontal on-screen range where the entity can update. If this is set to <code>0.0</code>, the entity will update regardless of the camera's horizontal position.
     */
-    Instance->Fields->Put("UpdateRegionW", DECIMAL_LINK_VAL(&OnScreenHitboxW));
+    LINK_FIELD("UpdateRegionW", DECIMAL_LINK_VAL(&OnScreenHitboxW));
     /***
     * \field UpdateRegionH
     * \type Decimal
@@ -352,7 +369,7 @@ PUBLIC void ScriptEntity::LinkFields() {
     * \ns Instance
     * \desc The vertical on-screen range where the entity can update. If this is set to <code>0.0</code>, the entity will update regardless of the camera's vertical position.
     */
-    Instance->Fields->Put("UpdateRegionH", DECIMAL_LINK_VAL(&OnScreenHitboxH));
+    LINK_FIELD("UpdateRegionH", DECIMAL_LINK_VAL(&OnScreenHitboxH));
     /***
     * \field UpdateRegionTop
     * \type Decimal
@@ -360,7 +377,7 @@ PUBLIC void ScriptEntity::LinkFields() {
     * \ns Instance
     * \desc The top on-screen range where the entity can update. If set to <code>0.0</code>, the entity will use its <linkto ref="instance.UpdateRegionH">UpdateRegionH</linkto> instead.
     */
-    Instance->Fields->Put("UpdateRegionTop", DECIMAL_LINK_VAL(&OnScreenRegionTop));
+    LINK_FIELD("UpdateRegionTop", DECIMAL_LINK_VAL(&OnScreenRegionTop));
     /***
     * \field UpdateRegionLeft
     * \type Decimal
@@ -368,7 +385,7 @@ PUBLIC void ScriptEntity::LinkFields() {
     * \ns Instance
     * \desc The left on-screen range where the entity can update. If set to <code>0.0</code>, the entity will use its <linkto ref="instance.UpdateRegionW">UpdateRegionW</linkto> instead.
     */
-    Instance->Fields->Put("UpdateRegionLeft", DECIMAL_LINK_VAL(&OnScreenRegionLeft));
+    LINK_FIELD("UpdateRegionLeft", DECIMAL_LINK_VAL(&OnScreenRegionLeft));
     /***
     * \field UpdateRegionRight
     * \type Decimal
@@ -376,7 +393,7 @@ PUBLIC void ScriptEntity::LinkFields() {
     * \ns Instance
     * \desc The left on-screen range where the entity can update. If set to <code>0.0</code>, the entity will use its <linkto ref="instance.UpdateRegionW">UpdateRegionW</linkto> instead.
     */
-    Instance->Fields->Put("UpdateRegionRight", DECIMAL_LINK_VAL(&OnScreenRegionRight));
+    LINK_FIELD("UpdateRegionRight", DECIMAL_LINK_VAL(&OnScreenRegionRight));
     /***
     * \field UpdateRegionBottom
     * \type Decimal
@@ -384,7 +401,7 @@ PUBLIC void ScriptEntity::LinkFields() {
     * \ns Instance
     * \desc The bottom on-screen range where the entity can update. If set to <code>0.0</code>, the entity will use its <linkto ref="instance.UpdateRegionH">UpdateRegionH</linkto> instead.
     */
-    Instance->Fields->Put("UpdateRegionBottom", DECIMAL_LINK_VAL(&OnScreenRegionBottom));
+    LINK_FIELD("UpdateRegionBottom", DECIMAL_LINK_VAL(&OnScreenRegionBottom));
     /***
     * \field RenderRegionW
     * \type Decimal
@@ -636,7 +653,7 @@ PUBLIC void ScriptEntity::LinkFields() {
     * \ns Instance
     * \desc See <linkto ref="instance.Persistence"></linkto> instead.
     */
-    Instance->Fields->Put("Persistent", INTEGER_LINK_VAL(&Persistence));
+    LINK_FIELD("Persistent", INTEGER_LINK_VAL(&Persistence));
     /***
     * \field Interactable
     * \type Boolean
@@ -653,8 +670,12 @@ PUBLIC void ScriptEntity::LinkFields() {
     * \desc Whether the entity persists between scenes.
     */
     LINK_INT(Persistence);
+
+    if (fromEmpty && !LinkedShape)
+        LinkedShape = Instance->Shape;
 }
 
+#undef LINK_FIELD
 #undef LINK_INT
 #undef LINK_DEC
 #undef LINK_BOOL
@@ -662,8 +683,9 @@ PUBLIC void ScriptEntity::LinkFields() {
 PRIVATE bool ScriptEntity::GetCallableValue(Uint32 hash, VMValue& value) {
     // First look for a field which may shadow a method.
     VMValue result;
-    if (Instance->Fields->GetIfExists(hash, &result)) {
-        value = result;
+    int slot = Instance->Shape->Find(hash);
+    if (slot >= 0) {
+        value = Instance->Fields[slot];
         return true;
     }
 
@@ -780,19 +802,20 @@ PUBLIC void ScriptEntity::CopyFields(ScriptEntity* other) {
 }
 
 PUBLIC void ScriptEntity::CopyVMFields(ScriptEntity* other) {
-    Table* srcFields = Instance->Fields;
-    Table* destFields = other->Instance->Fields;
+    ObjInstance* src = Instance;
+    ObjInstance* dest = other->Instance;
 
-    destFields->Clear();
+    ClearInstanceFields(dest);
 
-    srcFields->WithAll([destFields](Uint32 key, VMValue value) -> void {
+    // Link the built-in fields again first, since they have been removed
+    other->LinkFields();
+
+    src->Shape->WithAll([src, dest](Uint32 key, int slot) -> void {
         // Don't copy linked fields, because they point to this entity's built-in fields
+        VMValue value = src->Fields[slot];
         if (value.Type != VAL_LINKED_INTEGER && value.Type != VAL_LINKED_DECIMAL)
-            destFields->Put(key, value);
+            PutInstanceField(dest, key, value);
     });
-
-    // Link the built-in fields again, since they have been removed
-    other->LinkFields();
 }
 
 // Events called from C++
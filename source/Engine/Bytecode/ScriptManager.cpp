@@ -30,6 +30,8 @@ public:
     static HashMap<char*>*             Tokens;
     static vector<ObjClass*>           ClassImplList;
 
+    static Uint32                      InlineCacheEpoch;
+
     static SDL_mutex*                  GlobalLock;
 };
 #endif
@@ -70,22 +72,28 @@ HashMap<ObjClass*>*         ScriptManager::Classes = NULL;
 HashMap<char*>*             ScriptManager::Tokens = NULL;
 vector<ObjClass*>           ScriptManager::ClassImplList;
 
+Uint32                      ScriptManager::InlineCacheEpoch = 1;
+
 SDL_mutex*                  ScriptManager::GlobalLock = NULL;
 
 // #define DEBUG_STRESS_GC
 
 PUBLIC STATIC void    ScriptManager::RequestGarbageCollection() {
-#ifndef DEBUG_STRESS_GC
-    if (GarbageCollector::GarbageSize > GarbageCollector::NextGC)
-#endif
-    {
-        size_t startSize = GarbageCollector::GarbageSize;
+#ifdef DEBUG_STRESS_GC
+    ForceGarbageCollection();
+#else
+    if (ScriptManager::Lock()) {
+        if (ScriptManager::ThreadCount > 1) {
+            ScriptManager::Unlock();
+            return;
+        }
 
-        ForceGarbageCollection();
+        // Does a time-limited slice of work, if a collection is due or running.
+        GarbageCollector::Step();
 
-        // startSize = GarbageCollector::GarbageSize - startSize;
-        Log::Print(Log::LOG_INFO, "%04X: Freed garbage from %u to %u (%d), next GC at %d", Scene::Frame, (Uint32)startSize, (Uint32)GarbageCollector::GarbageSize, GarbageCollector::GarbageSize - startSize, GarbageCollector::NextGC);
+        ScriptManager::Unlock();
     }
+#endif
 }
 PUBLIC STATIC void    ScriptManager::ForceGarbageCollection() {
     if (ScriptManager::Lock()) {
@@ -200,6 +208,9 @@ PUBLIC STATIC void    ScriptManager::Dispose() {
 
     ClassImplList.clear();
 
+    FreeShapes();
+    ScriptEntity::LinkedShape = NULL;
+
     SDL_DestroyMutex(GlobalLock);
 }
 PRIVATE STATIC void    ScriptManager::RemoveNonGlobalableValue(Uint32 hash, VMValue value) {
@@ -248,6 +259,9 @@ PRIVATE STATIC void    ScriptManager::FreeFunction(ObjFunction* function) {
     FREE_OBJ(function, ObjFunction);
 }
 PRIVATE STATIC void    ScriptManager::FreeClass(ObjClass* klass) {
+    // The address may be reused by a new class.
+    InvalidateInlineCaches();
+
     // Subfunctions are already freed as a byproduct of the AllFunctionList,
     // so just do natives.
     klass->Methods->ForAll(FreeNativeValue);
@@ -534,7 +548,8 @@ PUBLIC STATIC void    ScriptManager::FreeValue(VMValue value) {
 
                 // An instance does not own its values, so it's not allowed
                 // to free them.
-                delete instance->Fields;
+                if (instance->Fields)
+                    Memory::Free(instance->Fields);
 
                 FREE_OBJ(instance, ObjInstance);
                 break;
@@ -589,21 +604,93 @@ PUBLIC STATIC void    ScriptManager::FreeValue(VMValue value) {
 // #endregion
 
 // #region GlobalFuncs
+// NOTE: While only the main thread is running scripts, nothing else can touch
+// the heap, so the mutex is skipped entirely. ThreadCount can change between
+// a Lock() and its Unlock(), so each thread remembers which of its (possibly
+// nested) locks actually took the mutex, and only releases those.
+#define SCRIPT_LOCK_TRACKED_DEPTH 32
+
+thread_local Uint32 ScriptLockDepth = 0;
+thread_local Uint32 ScriptLocksTaken = 0;
+
 PUBLIC STATIC bool    ScriptManager::Lock() {
-    return (SDL_LockMutex(GlobalLock) == 0);
+    // Locks nested deeper than can be tracked always take the mutex
+    bool take = ThreadCount > 1 || ScriptLockDepth >= SCRIPT_LOCK_TRACKED_DEPTH;
+    if (take && SDL_LockMutex(GlobalLock) != 0)
+        return false;
+
+    if (ScriptLockDepth < SCRIPT_LOCK_TRACKED_DEPTH) {
+        Uint32 bit = 1U << ScriptLockDepth;
+        if (take)
+            ScriptLocksTaken |= bit;
+        else
+            ScriptLocksTaken &= ~bit;
+    }
+    ScriptLockDepth++;
+    return true;
 }
 PUBLIC STATIC void    ScriptManager::Unlock() {
+    if (ScriptLockDepth == 0)
+        return;
+
+    ScriptLockDepth--;
+    if (ScriptLockDepth >= SCRIPT_LOCK_TRACKED_DEPTH || (ScriptLocksTaken & (1U << ScriptLockDepth)))
+        SDL_UnlockMutex(GlobalLock);
+}
+PUBLIC STATIC bool    ScriptManager::IsSingleThreaded() {
+    return ThreadCount == 1;
+}
+PUBLIC STATIC Uint32  ScriptManager::AcquireThread() {
+    // The write barrier isn't thread-safe, so a collection can't be left
+    // halfway done while other threads run scripts.
+    if (ThreadCount == 1)
+        GarbageCollector::FinishCycle();
+
+    SDL_LockMutex(GlobalLock);
+    Uint32 index = ThreadCount++;
+
+    // The calling thread may be inside locks that skipped the mutex, since
+    // it was the only one running scripts. Take it for each of them now, so
+    // the new thread still waits until they're all released.
+    if (index == 1) {
+        for (Uint32 depth = 0; depth < ScriptLockDepth && depth < SCRIPT_LOCK_TRACKED_DEPTH; depth++) {
+            Uint32 bit = 1U << depth;
+            if (!(ScriptLocksTaken & bit)) {
+                SDL_LockMutex(GlobalLock);
+                ScriptLocksTaken |= bit;
+            }
+        }
+    }
+
+    SDL_UnlockMutex(GlobalLock);
+    return index;
+}
+PUBLIC STATIC void    ScriptManager::ReleaseThread() {
+    SDL_LockMutex(GlobalLock);
+    ThreadCount--;
     SDL_UnlockMutex(GlobalLock);
 }
 
+// Cached method lookups are tagged with the epoch they were made in; bumping it
+// whenever a method table changes (or a class is freed) makes them all miss.
+PUBLIC STATIC void    ScriptManager::InvalidateInlineCaches() {
+    InlineCacheEpoch++;
+    if (InlineCacheEpoch == 0)
+        InlineCacheEpoch = 1;
+}
+
 PUBLIC STATIC void    ScriptManager::DefineMethod(VMThread* thread, int index, Uint32 hash) {
     if ((unsigned)index >= AllFunctionList.size())
         return;
 
+    InvalidateInlineCaches();
+
     ObjFunction* function = AllFunctionList[index];
     VMValue methodValue = OBJECT_VAL(function);
 
     ObjClass* klass = AS_CLASS(thread->Peek(0));
+    GarbageCollector::WriteBarrier((Obj*)klass);
+    GarbageCollector::WriteBarrier((Obj*)function);
     klass->Methods->Put(hash, methodValue);
 
     if (hash == klass->Hash)
@@ -618,8 +705,11 @@ PUBLIC STATIC void    ScriptManager::DefineNative(ObjClass* klass, const char* n
     if (klass == NULL) return;
     if (name == NULL) return;
 
-    if (!klass->Methods->Exists(name))
+    if (!klass->Methods->Exists(name)) {
+        GarbageCollector::WriteBarrier((Obj*)klass);
         klass->Methods->Put(name, OBJECT_VAL(NewNative(function)));
+        InvalidateInlineCaches();
+    }
 }
 PUBLIC STATIC void    ScriptManager::GlobalLinkInteger(ObjClass* klass, const char* name, int* value) {
     if (name == NULL) return;
@@ -629,6 +719,7 @@ PUBLIC STATIC void    ScriptManager::GlobalLinkInteger(ObjClass* klass, const ch
     }
     else {
         klass->Methods->Put(name, INTEGER_LINK_VAL(value));
+        InvalidateInlineCaches();
     }
 }
 PUBLIC STATIC void    ScriptManager::GlobalLinkDecimal(ObjClass* klass, const char* name, float* value) {
@@ -639,21 +730,26 @@ PUBLIC STATIC void    ScriptManager::GlobalLinkDecimal(ObjClass* klass, const ch
     }
     else {
         klass->Methods->Put(name, DECIMAL_LINK_VAL(value));
+        InvalidateInlineCaches();
     }
 }
 PUBLIC STATIC void    ScriptManager::GlobalConstInteger(ObjClass* klass, const char* name, int value) {
     if (name == NULL) return;
     if (klass == NULL)
         Constants->Put(name, INTEGER_VAL(value));
-    else
+    else {
         klass->Methods->Put(name, INTEGER_VAL(value));
+        InvalidateInlineCaches();
+    }
 }
 PUBLIC STATIC void    ScriptManager::GlobalConstDecimal(ObjClass* klass, const char* name, float value) {
     if (name == NULL) return;
     if (klass == NULL)
         Constants->Put(name, DECIMAL_VAL(value));
-    else
+    else {
         klass->Methods->Put(name, DECIMAL_VAL(value));
+        InvalidateInlineCaches();
+    }
 }
 PUBLIC STATIC ObjClass* ScriptManager::GetClassParent(ObjClass* klass) {
     if (!klass->Parent && klass->ParentHash) {
@@ -7751,6 +7751,7 @@ if (index < 0 || index >= 0x100) { \
  */
 VMValue Palette_LoadFromResource(int argCount, VMValue* args, Uint32 threadID) {
     CHECK_AT_LEAST_ARGCOUNT(2);
+    SoftwareRenderer::FlushCommands();
     int palIndex        = GET_ARG(0, GetInteger);
     char* filename      = GET_ARG(1, GetString);
     int disabledRows    = GET_ARG_OPT(2, GetInteger, 0);
@@ -7905,6 +7906,7 @@ VMValue Palette_LoadFromResource(int argCount, VMValue* args, Uint32 threadID) {
  */
 VMValue Palette_LoadFromImage(int argCount, VMValue* args, Uint32 threadID) {
     CHECK_ARGCOUNT(2);
+    SoftwareRenderer::FlushCommands();
     int palIndex = GET_ARG(0, GetInteger);
     Image* image = GET_ARG(1, GetImage);
     Texture* texture = image->TexturePtr;
@@ -7955,6 +7957,7 @@ VMValue Palette_GetColor(int argCount, VMValue* args, Uint32 threadID) {
  */
 VMValue Palette_SetColor(int argCount, VMValue* args, Uint32 threadID) {
     CHECK_ARGCOUNT(3);
+    SoftwareRenderer::FlushCommands();
     int palIndex = GET_ARG(0, GetInteger);
     int colorIndex = GET_ARG(1, GetInteger);
     CHECK_PALETTE_INDEX(palIndex);
@@ -7986,6 +7989,7 @@ inline Uint32 PMP_ColorBlend(Uint32 color1, Uint32 color2, int percent) {
 }
 VMValue Palette_MixPalettes(int argCount, VMValue* args, Uint32 threadID) {
     CHECK_ARGCOUNT(6);
+    SoftwareRenderer::FlushCommands();
     int palIndexDest = GET_ARG(0, GetInteger);
     int palIndex1 = GET_ARG(1, GetInteger);
     int palIndex2 = GET_ARG(2, GetInteger);
@@ -8019,6 +8023,7 @@ VMValue Palette_MixPalettes(int argCount, VMValue* args, Uint32 threadID) {
  */
 VMValue Palette_RotateColorsLeft(int argCount, VMValue* args, Uint32 threadID) {
     CHECK_ARGCOUNT(3);
+    SoftwareRenderer::FlushCommands();
     int palIndex = GET_ARG(0, GetInteger);
     int colorIndexStart = GET_ARG(1, GetInteger);
     int count = GET_ARG(2, GetInteger);
@@ -8046,6 +8051,7 @@ VMValue Palette_RotateColorsLeft(int argCount, VMValue* args, Uint32 threadID) {
  */
 VMValue Palette_RotateColorsRight(int argCount, VMValue* args, Uint32 threadID) {
     CHECK_ARGCOUNT(3);
+    SoftwareRenderer::FlushCommands();
     int palIndex = GET_ARG(0, GetInteger);
     int colorIndexStart = GET_ARG(1, GetInteger);
     int count = GET_ARG(2, GetInteger);
@@ -8075,6 +8081,7 @@ VMValue Palette_RotateColorsRight(int argCount, VMValue* args, Uint32 threadID)
  */
 VMValue Palette_CopyColors(int argCount, VMValue* args, Uint32 threadID) {
     CHECK_ARGCOUNT(5);
+    SoftwareRenderer::FlushCommands();
     int palIndexFrom = GET_ARG(0, GetInteger);
     int colorIndexStartFrom = GET_ARG(1, GetInteger);
     int palIndexTo = GET_ARG(2, GetInteger);
@@ -8106,6 +8113,7 @@ VMValue Palette_CopyColors(int argCount, VMValue* args, Uint32 threadID) {
  */
 VMValue Palette_SetPaletteIndexLines(int argCount, VMValue* args, Uint32 threadID) {
     CHECK_ARGCOUNT(3);
+    SoftwareRenderer::FlushCommands();
     int palIndex        = GET_ARG(0, GetInteger);
     Sint32 lineStart    = (int)GET_ARG(1, GetDecimal);
     Sint32 lineEnd      = (int)GET_ARG(2, GetDecimal);
@@ -8334,6 +8342,8 @@ VMValue Resources_LoadSound(int argCount, VMValue* args, Uint32 threadID) {
     else if (emptySlot) (*list)[index] = resource; else list->push_back(resource);
 
     resource->AsSound = new (nothrow) ISound(filename);
+    if (resource->AsSound && !resource->AsSound->LoadFailed)
+        resource->AsSound->PreDecode();
     return INTEGER_VAL((int)index);
 }
 /***
@@ -8734,6 +8744,72 @@ VMValue Scene_CheckObjectCollisionPlatform(int argCount, VMValue* args, Uint32 t
     }
     return INTEGER_VAL(!!Scene::CheckObjectCollisionPlatform(thisEnt, &thisBox, otherEnt, &otherBox, setValues));
 }
+static VMValue GetInstancesInBox(float left, float top, float right, float bottom, char* objectName, Entity* exclude) {
+    ObjArray* array = NewArray();
+
+    ObjectList* objectList = NULL;
+    if (objectName) {
+        if (!Scene::ObjectLists || !Scene::ObjectLists->Exists(objectName))
+            return OBJECT_VAL(array);
+        objectList = Scene::ObjectLists->Get(objectName);
+    }
+
+    vector<Entity*> entities;
+    Scene::GetEntitiesInBox(left, top, right, bottom, objectList, exclude, &entities);
+
+    for (size_t i = 0; i < entities.size(); i++) {
+        ScriptEntity* ent = (ScriptEntity*)entities[i];
+        if (ent->Instance)
+            array->Values->push_back(OBJECT_VAL(ent->Instance));
+    }
+
+    return OBJECT_VAL(array);
+}
+/***
+ * Scene.GetInstancesInBox
+ * \desc Gets every active instance whose hitbox overlaps a box. This uses a grid built once per frame, so it is much faster than checking each instance of a class.
+ * \param x (Number): X position of the box's top-left corner.
+ * \param y (Number): Y position of the box's top-left corner.
+ * \param width (Number): Width of the box.
+ * \param height (Number): Height of the box.
+ * \paramOpt className (String): Only get instances of this object class.
+ * \return Returns an Array of instances.
+ * \ns Scene
+ */
+VMValue Scene_GetInstancesInBox(int argCount, VMValue* args, Uint32 threadID) {
+    CHECK_AT_LEAST_ARGCOUNT(4);
+    float x             = GET_ARG(0, GetDecimal);
+    float y             = GET_ARG(1, GetDecimal);
+    float width         = GET_ARG(2, GetDecimal);
+    float height        = GET_ARG(3, GetDecimal);
+    char* objectName    = GET_ARG_OPT(4, GetString, NULL);
+
+    return GetInstancesInBox(x, y, x + width, y + height, objectName, NULL);
+}
+/***
+ * Scene.GetInstancesOverlapping
+ * \desc Gets every other active instance whose hitbox overlaps the hitbox of an instance.
+ * \param instance (Instance): The instance to check.
+ * \paramOpt className (String): Only get instances of this object class.
+ * \return Returns an Array of instances.
+ * \ns Scene
+ */
+VMValue Scene_GetInstancesOverlapping(int argCount, VMValue* args, Uint32 threadID) {
+    CHECK_AT_LEAST_ARGCOUNT(1);
+    ObjInstance* instance   = GET_ARG(0, GetInstance);
+    char* objectName        = GET_ARG_OPT(1, GetString, NULL);
+
+    Entity* self = (Entity*)instance->EntityPtr;
+    if (!self || self->HitboxW == 0.0f || self->HitboxH == 0.0f)
+        return OBJECT_VAL(NewArray());
+
+    float cx = self->X + self->HitboxOffX;
+    float cy = self->Y + self->HitboxOffY;
+    float hw = fabs(self->HitboxW) * 0.5f;
+    float hh = fabs(self->HitboxH) * 0.5f;
+
+    return GetInstancesInBox(cx - hw, cy - hh, cx + hw, cy + hh, objectName, self);
+}
 /***
  * Scene.Load
  * \desc Changes active scene to the one in the specified resource file.
@@ -9712,6 +9788,7 @@ VMValue Scene_SetTile(int argCount, VMValue* args, Uint32 threadID) {
 
     // Scene::UpdateTileBatch(layer, x / 8, y / 8);
 
+    Scene::Layers[layer].TileVersion++;
     Scene::AnyLayerTileChange = true;
 
     return NULL_VAL;
@@ -10049,6 +10126,19 @@ VMValue Scene_SetLayerRepeat(int argCount, VMValue* args, Uint32 threadID) {
     Scene::Layers[index].Repeat = !!GET_ARG(1, GetInteger);
     return NULL_VAL;
 }
+/***
+ * Scene.SetLayerCached
+ * \desc Sets whether or not the specified layer's tiles are kept drawn in a separate buffer, which makes layers that rarely change much faster to draw. Only used by the software renderer, for horizontal parallax layers that repeat.
+ * \param layerIndex (Integer): Index of layer.
+ * \param isCached (Boolean): Whether or not the layer is cached.
+ * \ns Scene
+ */
+VMValue Scene_SetLayerCached(int argCount, VMValue* args, Uint32 threadID) {
+    CHECK_ARGCOUNT(2);
+    int index = GET_ARG(0, GetInteger);
+    Scene::Layers[index].UseRenderCache = !!GET_ARG(1, GetInteger);
+    return NULL_VAL;
+}
 /***
  * Scene.SetDrawGroupCount
  * \desc Sets the amount of draw groups in the active scene.
@@ -13246,7 +13336,7 @@ int     _Thread_RunEvent(void* op) {
 
     free(bundle);
 
-    ScriptManager::ThreadCount--;
+    ScriptManager::ReleaseThread();
     Log::Print(Log::LOG_IMPORTANT, "Thread %d closed.", ScriptManager::ThreadCount);
     return 0;
 }
@@ -13280,7 +13370,7 @@ VMValue Thread_RunEvent(int argCount, VMValue* args, Uint32 threadID) {
     bundle->Callback = *callback;
     bundle->Callback.Object.Next = NULL;
     bundle->ArgCount = subArgCount;
-    bundle->ThreadIndex = ScriptManager::ThreadCount++;
+    bundle->ThreadIndex = ScriptManager::AcquireThread();
     if (subArgCount > 0)
         memcpy(bundle + 1, args + 1, subArgCount * sizeof(VMValue));
 
@@ -15218,6 +15308,26 @@ PUBLIC STATIC void StandardLibrary::Link() {
     */
     DEF_ENUM(DrawMode_ORTHOGRAPHIC);
     /***
+    * \enum DrawMode_SUBDIVIDE_8
+    * \desc (software-renderer only) Only computes perspective-correct texture coordinates every 8 pixels, and interpolates linearly between them.
+    */
+    DEF_ENUM(DrawMode_SUBDIVIDE_8);
+    /***
+    * \enum DrawMode_SUBDIVIDE_16
+    * \desc (software-renderer only) Only computes perspective-correct texture coordinates every 16 pixels, and interpolates linearly between them.
+    */
+    DEF_ENUM(DrawMode_SUBDIVIDE_16);
+    /***
+    * \enum DrawMode_SUBDIVIDE_32
+    * \desc (software-renderer only) Only computes perspective-correct texture coordinates every 32 pixels, and interpolates linearly between them.
+    */
+    DEF_ENUM(DrawMode_SUBDIVIDE_32);
+    /***
+    * \enum DrawMode_SubdivideMask
+    * \desc Masks out <linkto ref="DrawMode_SUBDIVIDE_8"></linkto><code> | </code><linkto ref="DrawMode_SUBDIVIDE_16"></linkto><code> | </code><linkto ref="DrawMode_SUBDIVIDE_32"></linkto> out of a draw mode.
+    */
+    DEF_ENUM(DrawMode_SubdivideMask);
+    /***
     * \enum DrawMode_LINES_FLAT
     * \desc Combination of <linkto ref="DrawMode_LINES"></linkto> and <linkto ref="DrawMode_FLAT_LIGHTING"></linkto>.
     */
@@ -15958,6 +16068,8 @@ PUBLIC STATIC void StandardLibrary::Link() {
     DEF_NATIVE(Scene, CheckObjectCollisionCircle);
     DEF_NATIVE(Scene, CheckObjectCollisionBox);
     DEF_NATIVE(Scene, CheckObjectCollisionPlatform);
+    DEF_NATIVE(Scene, GetInstancesInBox);
+    DEF_NATIVE(Scene, GetInstancesOverlapping);
     DEF_NATIVE(Scene, Load);
     DEF_NATIVE(Scene, LoadNoPersistency);
     DEF_NATIVE(Scene, LoadPosition);
@@ -16044,6 +16156,7 @@ PUBLIC STATIC void StandardLibrary::Link() {
     DEF_NATIVE(Scene, SetLayerDrawGroup);
     DEF_NATIVE(Scene, SetLayerDrawBehavior);
     DEF_NATIVE(Scene, SetLayerRepeat);
+    DEF_NATIVE(Scene, SetLayerCached);
     DEF_NATIVE(Scene, SetDrawGroupCount);
     DEF_NATIVE(Scene, SetDrawGroupEntityDepthSorting);
     DEF_NATIVE(Scene, SetLayerBlend);
@@ -24,8 +24,9 @@ static Obj*       AllocateObject(size_t size, ObjType type) {
     object->Type = type;
     object->Class = nullptr;
     object->IsDark = false;
-    object->Next = GarbageCollector::RootObject;
-    GarbageCollector::RootObject = object;
+    object->IsGray = false;
+
+    GarbageCollector::OnAllocate(object, size);
 
     return object;
 }
@@ -118,7 +119,9 @@ ObjInstance*      NewInstance(ObjClass* klass) {
     ObjInstance* instance = ALLOCATE_OBJ(ObjInstance, OBJ_INSTANCE);
     Memory::Track(instance, "NewInstance");
     instance->Object.Class = klass;
-    instance->Fields = new Table(NULL, 16);
+    instance->Shape = GetRootShape();
+    instance->Fields = NULL;
+    instance->FieldCapacity = 0;
     instance->EntityPtr = NULL;
     return instance;
 }
@@ -239,6 +242,8 @@ void              Chunk::Init() {
     Code = NULL;
     Lines = NULL;
     Constants = new vector<VMValue>();
+    InlineCacheIndex = NULL;
+    InlineCaches = NULL;
 }
 void              Chunk::Alloc() {
     if (!Code)
@@ -272,6 +277,15 @@ void              Chunk::Free() {
         Constants->shrink_to_fit();
         delete Constants;
     }
+
+    if (InlineCacheIndex) {
+        Memory::Free(InlineCacheIndex);
+        InlineCacheIndex = NULL;
+    }
+    if (InlineCaches) {
+        delete InlineCaches;
+        InlineCaches = NULL;
+    }
 }
 void              Chunk::Write(Uint8 byte, int line) {
     if (Capacity < Count + 1) {
@@ -287,3 +301,160 @@ int               Chunk::AddConstant(VMValue value) {
     Constants->push_back(value);
     return (int)Constants->size() - 1;
 }
+// Call sites get their cache the first time they miss, so the index table
+// maps a code offset to (cache index + 1), and 0 means "no cache yet".
+InlineCache*      Chunk::GetInlineCache(int offset) {
+    if (!InlineCacheIndex) {
+        InlineCacheIndex = (Uint16*)Memory::TrackedCalloc("Chunk::InlineCacheIndex", Count, sizeof(Uint16));
+        InlineCaches = new vector<InlineCache>();
+    }
+
+    Uint16 index = InlineCacheIndex[offset];
+    if (index == 0) {
+        if (InlineCaches->size() >= 0xFFFF)
+            return NULL;
+
+        InlineCache cache;
+        memset(&cache, 0, sizeof(cache));
+        InlineCaches->push_back(cache);
+
+        index = (Uint16)InlineCaches->size();
+        InlineCacheIndex[offset] = index;
+    }
+    return &(*InlineCaches)[index - 1];
+}
+
+InlineCacheEntry* InlineCache::Find(ObjClass* klass, InstanceShape* shape) {
+    for (Uint32 i = 0; i < Count; i++) {
+        if (Entries[i].Class == klass && Entries[i].Shape == shape)
+            return &Entries[i];
+    }
+    return NULL;
+}
+InlineCacheEntry* InlineCache::Add(ObjClass* klass, InstanceShape* shape) {
+    InlineCacheEntry* entry = Find(klass, shape);
+    if (!entry) {
+        // Once the site goes megamorphic, evict entries round-robin.
+        if (Count < INLINE_CACHE_WAYS)
+            entry = &Entries[Count++];
+        else {
+            entry = &Entries[Next];
+            Next = (Next + 1) % INLINE_CACHE_WAYS;
+        }
+    }
+    entry->Class = klass;
+    entry->Shape = shape;
+    entry->Transition = NULL;
+    entry->Epoch = 0;
+    entry->Slot = -1;
+    entry->Method = NULL_VAL;
+    return entry;
+}
+
+#define SHAPE_LOOKUP_THRESHOLD 8
+
+static InstanceShape* RootShape = NULL;
+
+static InstanceShape* NewShape(InstanceShape* parent, Uint32 hash) {
+    InstanceShape* shape = ALLOCATE(InstanceShape, 1);
+    shape->Parent = parent;
+    shape->Key = hash;
+    shape->SlotCount = parent ? parent->SlotCount + 1 : 0;
+    shape->Lookups = 0;
+    shape->Slots = NULL;
+    shape->Transitions = NULL;
+    return shape;
+}
+InstanceShape*    GetRootShape() {
+    if (!RootShape)
+        RootShape = NewShape(NULL, 0);
+    return RootShape;
+}
+void              FreeShapes() {
+    if (RootShape) {
+        RootShape->Free();
+        RootShape = NULL;
+    }
+}
+
+// Short-lived shapes (like the ones an instance passes through while its
+// initializer runs) are searched by walking up to the root. A shape only gets
+// its own slot table once it has been looked up often enough.
+int               InstanceShape::Find(Uint32 hash) {
+    int slot;
+    if (Slots) {
+        if (Slots->GetIfExists(hash, &slot))
+            return slot;
+        return -1;
+    }
+
+    if (++Lookups > SHAPE_LOOKUP_THRESHOLD) {
+        Slots = new HashMap<int>(NULL, 16);
+        for (InstanceShape* shape = this; shape->Parent; shape = shape->Parent)
+            Slots->Put(shape->Key, shape->SlotCount - 1);
+        return Find(hash);
+    }
+
+    for (InstanceShape* shape = this; shape->Parent; shape = shape->Parent) {
+        if (shape->Key == hash)
+            return shape->SlotCount - 1;
+    }
+    return -1;
+}
+InstanceShape*    InstanceShape::AddField(Uint32 hash) {
+    InstanceShape* next;
+    if (!Transitions)
+        Transitions = new HashMap<InstanceShape*>(NULL, 4);
+    else if (Transitions->GetIfExists(hash, &next))
+        return next;
+
+    next = NewShape(this, hash);
+    Transitions->Put(hash, next);
+    return next;
+}
+void              InstanceShape::WithAll(std::function<void(Uint32, int)> forFunc) {
+    if (!Parent)
+        return;
+
+    Parent->WithAll(forFunc);
+    forFunc(Key, SlotCount - 1);
+}
+void              InstanceShape::Free() {
+    if (Transitions) {
+        Transitions->WithAll([](Uint32, InstanceShape* next) -> void {
+            next->Free();
+        });
+        delete Transitions;
+    }
+    if (Slots)
+        delete Slots;
+    Memory::Free(this);
+}
+
+void              SetInstanceShape(ObjInstance* instance, InstanceShape* shape) {
+    if (instance->FieldCapacity < shape->SlotCount) {
+        int capacity = instance->FieldCapacity;
+        while (capacity < shape->SlotCount)
+            capacity = GROW_CAPACITY(capacity);
+
+        if (!instance->Fields)
+            instance->Fields = (VMValue*)Memory::TrackedMalloc("ObjInstance::Fields", sizeof(VMValue) * capacity);
+        else
+            instance->Fields = (VMValue*)Memory::Realloc(instance->Fields, sizeof(VMValue) * capacity);
+        instance->FieldCapacity = capacity;
+    }
+    instance->Shape = shape;
+}
+void              PutInstanceField(ObjInstance* instance, Uint32 hash, VMValue value) {
+    int slot = instance->Shape->Find(hash);
+    if (slot < 0) {
+        SetInstanceShape(instance, instance->Shape->AddField(hash));
+        slot = instance->Shape->SlotCount - 1;
+    }
+    instance->Fields[slot] = value;
+
+    GarbageCollector::WriteBarrier((Obj*)instance);
+}
+void              ClearInstanceFields(ObjInstance* instance) {
+    instance->Shape = GetRootShape();
+}
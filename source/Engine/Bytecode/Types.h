@@ -29,6 +29,34 @@ enum {
 
 struct Obj;
 
+// NOTE: With USING_COMPACT_VALUES, a value is packed into 8 bytes instead of 16:
+//   the type is kept in the top 16 bits, integers and decimals in the low 32 bits,
+//   and pointers (objects and linked values) in the low 48 bits. This relies on
+//   user-space addresses fitting in 48 bits, so it must not be used on targets
+//   that tag the top byte of heap pointers.
+#ifdef USING_COMPACT_VALUES
+    #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        #error USING_COMPACT_VALUES requires a little-endian target.
+    #endif
+
+    #define VALUE_POINTER_MASK 0x0000FFFFFFFFFFFFULL
+    #define VALUE_TYPE_SHIFT   48
+
+struct VMValue {
+    union {
+        union {
+            int    Integer;
+            float  Decimal;
+            Uint64 Bits;
+        } as;
+        struct {
+            Uint16 Payload[3];
+            Uint16 Type;
+        };
+    };
+};
+static_assert(sizeof(VMValue) == 8, "VMValue must be 8 bytes with USING_COMPACT_VALUES.");
+#else
 struct VMValue {
     Uint32    Type;
     union {
@@ -39,6 +67,44 @@ struct VMValue {
         float* LinkedDecimal;
     } as;
 };
+#endif
+
+// Instances that got their fields in the same order share a shape, which maps
+// field names to indices into the instance's field array. Shapes are never
+// modified once created; adding a field moves the instance to a child shape.
+struct InstanceShape {
+    InstanceShape*           Parent;
+    Uint32                   Key; // Field added by this shape
+    int                      SlotCount;
+    Uint32                   Lookups;
+    HashMap<int>*            Slots;
+    HashMap<InstanceShape*>* Transitions;
+
+    int            Find(Uint32 hash);
+    InstanceShape* AddField(Uint32 hash);
+    void           WithAll(std::function<void(Uint32, int)> forFunc);
+    void           Free();
+};
+
+#define INLINE_CACHE_WAYS 4
+
+struct InlineCacheEntry {
+    struct ObjClass* Class;
+    InstanceShape*   Shape;
+    InstanceShape*   Transition; // Shape after this site adds the field
+    Uint32           Epoch;
+    int              Slot; // Index into the receiver's fields, or -1 for a method
+    VMValue          Method;
+};
+
+struct InlineCache {
+    Uint32           Count;
+    Uint32           Next;
+    InlineCacheEntry Entries[INLINE_CACHE_WAYS];
+
+    InlineCacheEntry* Find(struct ObjClass* klass, InstanceShape* shape);
+    InlineCacheEntry* Add(struct ObjClass* klass, InstanceShape* shape);
+};
 
 struct Chunk {
     int              Count;
@@ -49,11 +115,15 @@ struct Chunk {
     vector<VMValue>* Constants;
     bool             OwnsMemory;
 
+    Uint16*              InlineCacheIndex;
+    vector<InlineCache>* InlineCaches;
+
     void Init();
     void Alloc();
     void Free();
     void Write(Uint8 byte, int line);
     int  AddConstant(VMValue value);
+    InlineCache* GetInlineCache(int offset);
 };
 
 struct BytecodeContainer {
@@ -70,11 +140,32 @@ const char* GetValueTypeString(VMValue value);
 #define IS_DECIMAL(value)  ((value).Type == VAL_DECIMAL)
 #define IS_OBJECT(value)   ((value).Type == VAL_OBJECT)
 
-#define AS_INTEGER(value)  (value.Type == VAL_INTEGER ? (value).as.Integer : *((value).as.LinkedInteger))
-#define AS_DECIMAL(value)  (value.Type == VAL_DECIMAL ? (value).as.Decimal : *((value).as.LinkedDecimal))
-#define AS_OBJECT(value)   ((value).as.Object)
+#ifdef USING_COMPACT_VALUES
+    #define VALUE_POINTER(value) ((uintptr_t)((value).as.Bits & VALUE_POINTER_MASK))
 
-#ifdef WIN32
+    #define AS_INTEGER(value)  (value.Type == VAL_INTEGER ? (value).as.Integer : *((int*)VALUE_POINTER(value)))
+    #define AS_DECIMAL(value)  (value.Type == VAL_DECIMAL ? (value).as.Decimal : *((float*)VALUE_POINTER(value)))
+    #define AS_OBJECT(value)   ((Obj*)VALUE_POINTER(value))
+#else
+    #define AS_INTEGER(value)  (value.Type == VAL_INTEGER ? (value).as.Integer : *((value).as.LinkedInteger))
+    #define AS_DECIMAL(value)  (value.Type == VAL_DECIMAL ? (value).as.Decimal : *((value).as.LinkedDecimal))
+    #define AS_OBJECT(value)   ((value).as.Object)
+#endif
+
+#if defined(USING_COMPACT_VALUES)
+    static inline VMValue MAKE_VAL(Uint32 type, Uint64 bits) { VMValue val; val.as.Bits = bits | ((Uint64)type << VALUE_TYPE_SHIFT); return val; }
+    static inline VMValue MAKE_POINTER_VAL(Uint32 type, void* value) {
+        assert(((Uint64)(uintptr_t)value & ~VALUE_POINTER_MASK) == 0);
+        return MAKE_VAL(type, (Uint64)(uintptr_t)value);
+    }
+
+    #define NULL_VAL           (MAKE_VAL(VAL_NULL, 0))
+    static inline VMValue INTEGER_VAL(int value) { return MAKE_VAL(VAL_INTEGER, (Uint32)value); }
+    static inline VMValue DECIMAL_VAL(float value) { VMValue val = MAKE_VAL(VAL_DECIMAL, 0); val.as.Decimal = value; return val; }
+    static inline VMValue OBJECT_VAL(void* value) { return MAKE_POINTER_VAL(VAL_OBJECT, value); }
+    static inline VMValue INTEGER_LINK_VAL(int* value) { return MAKE_POINTER_VAL(VAL_LINKED_INTEGER, value); }
+    static inline VMValue DECIMAL_LINK_VAL(float* value) { return MAKE_POINTER_VAL(VAL_LINKED_DECIMAL, value); }
+#elif defined(WIN32)
     #define NULL_VAL           (VMValue { })
     static inline VMValue INTEGER_VAL(int value) { VMValue val; val.Type = VAL_INTEGER; val.as.Integer = value; return val; }
     static inline VMValue DECIMAL_VAL(float value) { VMValue val; val.Type = VAL_DECIMAL; val.as.Decimal = value; return val; }
@@ -92,8 +183,13 @@ const char* GetValueTypeString(VMValue value);
 
 #define IS_LINKED_INTEGER(value) ((value).Type == VAL_LINKED_INTEGER)
 #define IS_LINKED_DECIMAL(value) ((value).Type == VAL_LINKED_DECIMAL)
-#define AS_LINKED_INTEGER(value)  (*((value).as.LinkedInteger))
-#define AS_LINKED_DECIMAL(value)  (*((value).as.LinkedDecimal))
+#ifdef USING_COMPACT_VALUES
+    #define AS_LINKED_INTEGER(value)  (*((int*)VALUE_POINTER(value)))
+    #define AS_LINKED_DECIMAL(value)  (*((float*)VALUE_POINTER(value)))
+#else
+    #define AS_LINKED_INTEGER(value)  (*((value).as.LinkedInteger))
+    #define AS_LINKED_DECIMAL(value)  (*((value).as.LinkedDecimal))
+#endif
 
 #define IS_NOT_NUMBER(value) (!IS_DECIMAL(value) && !IS_INTEGER(value) && !IS_LINKED_DECIMAL(value) && !IS_LINKED_INTEGER(value))
 
@@ -173,6 +269,9 @@ typedef HashMap<VMValue> Table;
 struct Obj {
     ObjType          Type;
     bool             IsDark;
+    bool             IsGray;
+    bool             IsOld;
+    bool             IsRemembered;
     struct ObjClass* Class;
     struct Obj*      Next;
 };
@@ -221,9 +320,11 @@ struct ObjClass {
     ObjClass*  Parent;
 };
 struct ObjInstance {
-    Obj       Object;
-    Table*    Fields;
-    void*     EntityPtr;
+    Obj            Object;
+    InstanceShape* Shape;
+    VMValue*       Fields;
+    int            FieldCapacity;
+    void*          EntityPtr;
 };
 struct ObjBoundMethod {
     Obj          Object;
@@ -269,6 +370,11 @@ ObjUpvalue*        NewUpvalue(VMValue* slot);
 ObjClosure*        NewClosure(ObjFunction* function);
 ObjClass*          NewClass(Uint32 hash);
 ObjInstance*       NewInstance(ObjClass* klass);
+InstanceShape*     GetRootShape();
+void               FreeShapes();
+void               SetInstanceShape(ObjInstance* instance, InstanceShape* shape);
+void               PutInstanceField(ObjInstance* instance, Uint32 hash, VMValue value);
+void               ClearInstanceFields(ObjInstance* instance);
 ObjBoundMethod*    NewBoundMethod(VMValue receiver, ObjFunction* method);
 ObjArray*          NewArray();
 ObjMap*            NewMap();
@@ -398,6 +504,11 @@ enum   OpCode {
     OP_IMPORT_MODULE,
     OP_ADD_ENUM,
     OP_NEW_ENUM,
+    // Superinstructions (only emitted by the optimizer)
+    OP_ADD_LOCAL_LOCAL,
+    OP_LESS_LOCAL_CONSTANT_JUMP_IF_FALSE,
+    OP_INCREMENT_LOCAL,
+    OP_DECREMENT_LOCAL,
 
     OP_SYNC = 0xFF,
 };
@@ -35,6 +35,7 @@ public:
 #include <Engine/Bytecode/ScriptEntity.h>
 #include <Engine/Bytecode/ScriptManager.h>
 #include <Engine/Bytecode/Compiler.h>
+#include <Engine/Bytecode/GarbageCollector.h>
 #include <Engine/Bytecode/Values.h>
 #include <Engine/Diagnostics/Clock.h>
 
@@ -320,6 +321,27 @@ PUBLIC VMValue VMThread::ReadConstant(CallFrame* frame) {
     return (*frame->Function->Chunk.Constants)[ReadUInt32(frame)];
 }
 
+// #region Inline Caches
+// Property and method lookups remember, per call site and receiver class and
+// shape, either which slot the field lives in, which shape the instance moves
+// to when the site adds the field, or which method the class chain resolved
+// to. Shapes never change, so only methods are dropped when the cache epoch
+// changes. Caches are only used while a single thread runs scripts, since
+// filling them is not synchronized.
+static inline InlineCache* GetInlineCache(CallFrame* frame) {
+    if (!ScriptManager::IsSingleThreaded())
+        return NULL;
+    return frame->Function->Chunk.GetInlineCache((int)(frame->IPLast - frame->IPStart));
+}
+static inline bool GetCachedMethod(InlineCacheEntry* entry, VMValue* result) {
+    if (entry->Slot >= 0 || entry->Epoch != ScriptManager::InlineCacheEpoch)
+        return false;
+
+    *result = entry->Method;
+    return true;
+}
+// #endregion
+
 PUBLIC int     VMThread::RunInstruction() {
     // NOTE: MSVC cannot take advantage of the dispatch table.
     #ifdef USING_VM_DISPATCH_TABLE
@@ -396,12 +418,22 @@ PUBLIC int     VMThread::RunInstruction() {
             VM_ADD_DISPATCH(OP_IMPORT_MODULE),
             VM_ADD_DISPATCH(OP_ADD_ENUM),
             VM_ADD_DISPATCH(OP_NEW_ENUM),
+            VM_ADD_DISPATCH(OP_ADD_LOCAL_LOCAL),
+            VM_ADD_DISPATCH(OP_LESS_LOCAL_CONSTANT_JUMP_IF_FALSE),
+            VM_ADD_DISPATCH(OP_INCREMENT_LOCAL),
+            VM_ADD_DISPATCH(OP_DECREMENT_LOCAL),
             VM_ADD_DISPATCH_NULL(OP_SYNC),
         };
         #define VM_START(ins) goto *dispatch_table[(ins)];
-        #define VM_END() dispatch_end:
         #define VM_CASE(n) START_ ## n
-        #define VM_BREAK goto dispatch_end;
+        #ifdef VM_DEBUG_INSTRUCTIONS
+            #define VM_END() dispatch_end:
+            #define VM_BREAK goto dispatch_end;
+        #else
+            // Each handler jumps straight to the next one.
+            #define VM_END() ;
+            #define VM_BREAK { frame->IPLast = frame->IP; goto *dispatch_table[ReadByte(frame)]; }
+        #endif
     #else
         #define VM_START(ins) switch ((ins))
         #define VM_END() ;
@@ -409,10 +441,15 @@ PUBLIC int     VMThread::RunInstruction() {
         #define VM_BREAK break
     #endif
 
+    // NOTE: This keeps running until the frame that was entered returns or
+    // an error stops execution. Anything that pushes or pops call frames
+    // must reload 'frame' before the next instruction.
     CallFrame* frame;
     Uint8 instruction;
 
     frame = &Frames[FrameCount - 1];
+
+    dispatch_next:
     frame->IPLast = frame->IP;
 
     #ifdef VM_DEBUG_INSTRUCTIONS
@@ -487,6 +524,10 @@ PUBLIC int     VMThread::RunInstruction() {
                 PRINT_CASE(OP_IMPORT_MODULE)
                 PRINT_CASE(OP_ADD_ENUM)
                 PRINT_CASE(OP_NEW_ENUM)
+                PRINT_CASE(OP_ADD_LOCAL_LOCAL)
+                PRINT_CASE(OP_LESS_LOCAL_CONSTANT_JUMP_IF_FALSE)
+                PRINT_CASE(OP_INCREMENT_LOCAL)
+                PRINT_CASE(OP_DECREMENT_LOCAL)
 
                 default:
                     Log::Print(Log::LOG_ERROR, "Unknown opcode %d\n", frame->IP); break;
@@ -617,15 +658,52 @@ PUBLIC int     VMThread::RunInstruction() {
                 ObjInstance* instance = AS_INSTANCE(object);
 
                 if (ScriptManager::Lock()) {
+                    ObjClass* klass = instance->Object.Class;
+                    InlineCache* cache = GetInlineCache(frame);
+                    InlineCacheEntry* entry = cache ? cache->Find(klass, instance->Shape) : NULL;
+
                     // Fields have priority over methods
-                    if (instance->Fields->GetIfExists(hash, &result)) {
-                        Pop();
-                        Push(ScriptManager::DelinkValue(result));
-                        ScriptManager::Unlock();
-                        VM_BREAK;
+                    if (entry) {
+                        if (entry->Slot >= 0) {
+                            Pop();
+                            Push(ScriptManager::DelinkValue(instance->Fields[entry->Slot]));
+                            ScriptManager::Unlock();
+                            VM_BREAK;
+                        }
+                        if (GetCachedMethod(entry, &result)) {
+                            Pop();
+                            Push(result);
+                            ScriptManager::Unlock();
+                            VM_BREAK;
+                        }
+                    }
+                    else {
+                        int slot = instance->Shape->Find(hash);
+                        if (slot >= 0) {
+                            if (cache) {
+                                entry = cache->Add(klass, instance->Shape);
+                                entry->Slot = slot;
+                            }
+                            Pop();
+                            Push(ScriptManager::DelinkValue(instance->Fields[slot]));
+                            ScriptManager::Unlock();
+                            VM_BREAK;
+                        }
+                    }
+
+                    if (cache) {
+                        result = ScriptManager::GetClassMethod(klass, hash);
+                        if (!IS_NULL(result)) {
+                            entry = cache->Add(klass, instance->Shape);
+                            entry->Epoch = ScriptManager::InlineCacheEpoch;
+                            entry->Method = result;
+                            Pop();
+                            Push(result);
+                            ScriptManager::Unlock();
+                            VM_BREAK;
+                        }
                     }
 
-                    ObjClass* klass = instance->Object.Class;
                     if (GetMethod(klass, hash)) {
                         ScriptManager::Unlock();
                         VM_BREAK;
@@ -709,15 +787,12 @@ PUBLIC int     VMThread::RunInstruction() {
             VMValue value;
             VMValue result;
             VMValue object;
-            Table* fields;
+            VMValue* property;
 
             object = Peek(1);
 
-            if (IS_INSTANCE(object)) {
-                fields = AS_INSTANCE(object)->Fields;
-            }
-            else if (IS_CLASS(object)) {
-                fields = AS_CLASS(object)->Fields;
+            if (IS_INSTANCE(object) || IS_CLASS(object)) {
+                // Handled below
             }
             else if (IS_NAMESPACE(object)) {
                 if (ThrowRuntimeError(false, "Cannot modify a namespace.") == ERROR_RES_CONTINUE)
@@ -734,7 +809,46 @@ PUBLIC int     VMThread::RunInstruction() {
 
             if (ScriptManager::Lock()) {
                 value = Pop();
-                if (fields->GetIfExists(hash, &field)) {
+
+                GarbageCollector::WriteBarrier(object);
+
+                property = NULL;
+                if (IS_INSTANCE(object)) {
+                    ObjInstance* instance = AS_INSTANCE(object);
+                    InstanceShape* shape = instance->Shape;
+                    InlineCache* cache = GetInlineCache(frame);
+                    InlineCacheEntry* entry = cache ? cache->Find(instance->Object.Class, shape) : NULL;
+
+                    int slot = entry ? entry->Slot : shape->Find(hash);
+                    if (slot >= 0) {
+                        if (cache && !entry) {
+                            entry = cache->Add(instance->Object.Class, shape);
+                            entry->Slot = slot;
+                        }
+                        property = &instance->Fields[slot];
+                    }
+                    else {
+                        // Adding a field moves the instance to the next shape
+                        InstanceShape* next = entry ? entry->Transition : shape->AddField(hash);
+                        if (cache && !entry) {
+                            entry = cache->Add(instance->Object.Class, shape);
+                            entry->Transition = next;
+                        }
+                        SetInstanceShape(instance, next);
+                        instance->Fields[next->SlotCount - 1] = value;
+                    }
+                }
+                else {
+                    Table* fields = AS_CLASS(object)->Fields;
+                    int slot;
+                    if (fields->GetIndexIfExists(hash, &slot))
+                        property = &fields->Data[slot].Data;
+                    else
+                        fields->Put(hash, value);
+                }
+
+                if (property) {
+                    field = *property;
                     switch (field.Type) {
                         case VAL_LINKED_INTEGER:
                             result = ScriptManager::CastValueAsInteger(value);
@@ -755,12 +869,9 @@ PUBLIC int     VMThread::RunInstruction() {
                             AS_LINKED_DECIMAL(field) = AS_DECIMAL(result);
                             break;
                         default:
-                            fields->Put(hash, value);
+                            *property = value;
                     }
                 }
-                else {
-                    fields->Put(hash, value);
-                }
 
                 Pop(); // Instance / Class
                 Push(value);
@@ -786,7 +897,7 @@ PUBLIC int     VMThread::RunInstruction() {
 
                 if (ScriptManager::Lock()) {
                     // Fields have priority over methods
-                    if (instance->Fields->Exists(hash)) {
+                    if (instance->Shape->Find(hash) >= 0) {
                         Pop();
                         Push(INTEGER_VAL(true));
                         ScriptManager::Unlock();
@@ -934,6 +1045,7 @@ PUBLIC int     VMThread::RunInstruction() {
                             goto FAIL_OP_SET_ELEMENT;
                     }
                     (*array->Values)[index] = value;
+                    GarbageCollector::WriteBarrier(obj);
                     ScriptManager::Unlock();
                 }
             }
@@ -953,6 +1065,7 @@ PUBLIC int     VMThread::RunInstruction() {
 
                     map->Values->Put(index, value);
                     map->Keys->Put(index, StringUtils::Duplicate(index));
+                    GarbageCollector::WriteBarrier(obj);
                     ScriptManager::Unlock();
                 }
             }
@@ -988,6 +1101,64 @@ PUBLIC int     VMThread::RunInstruction() {
             VM_BREAK;
         }
 
+        // Superinstructions
+        VM_CASE(OP_ADD_LOCAL_LOCAL): {
+            VMValue a = frame->Slots[ReadByte(frame)];
+            VMValue b = frame->Slots[ReadByte(frame)];
+            if (a.Type == VAL_INTEGER && b.Type == VAL_INTEGER) {
+                Push(INTEGER_VAL(AS_INTEGER(a) + AS_INTEGER(b)));
+                VM_BREAK;
+            }
+
+            Push(a);
+            Push(b);
+            Push(Values_Plus());
+            VM_BREAK;
+        }
+        VM_CASE(OP_LESS_LOCAL_CONSTANT_JUMP_IF_FALSE): {
+            VMValue a = frame->Slots[ReadByte(frame)];
+            VMValue b = ReadConstant(frame);
+            Sint32 offset = ReadSInt16(frame);
+
+            VMValue result;
+            if (a.Type == VAL_INTEGER && b.Type == VAL_INTEGER)
+                result = INTEGER_VAL(AS_INTEGER(a) < AS_INTEGER(b));
+            else {
+                Push(a);
+                Push(b);
+                result = Values_LessThan();
+            }
+
+            // Like OP_JUMP_IF_FALSE, the condition stays on the stack
+            Push(result);
+            if (ScriptManager::ValueFalsey(result)) {
+                frame->IP += offset;
+            }
+            VM_BREAK;
+        }
+        VM_CASE(OP_INCREMENT_LOCAL): {
+            Uint8 slot = ReadByte(frame);
+            if (frame->Slots[slot].Type == VAL_INTEGER) {
+                frame->Slots[slot].as.Integer++;
+                VM_BREAK;
+            }
+
+            Push(frame->Slots[slot]);
+            frame->Slots[slot] = Values_Increment();
+            VM_BREAK;
+        }
+        VM_CASE(OP_DECREMENT_LOCAL): {
+            Uint8 slot = ReadByte(frame);
+            if (frame->Slots[slot].Type == VAL_INTEGER) {
+                frame->Slots[slot].as.Integer--;
+                VM_BREAK;
+            }
+
+            Push(frame->Slots[slot]);
+            frame->Slots[slot] = Values_Decrement();
+            VM_BREAK;
+        }
+
         // Object Allocations (heap)
         VM_CASE(OP_NEW_ARRAY): {
             Uint32 count = ReadUInt32(frame);
@@ -1459,7 +1630,7 @@ PUBLIC int     VMThread::RunInstruction() {
             VMValue receiver = Peek(argCount);
             VMValue result;
             if (IS_INSTANCE(receiver)) {
-                if (!InvokeForInstance(hash, argCount, isSuper)) {
+                if (!InvokeForInstance(GetInlineCache(frame), hash, argCount, isSuper)) {
                     if (ThrowRuntimeError(false, "Could not invoke %s!", GetVariableOrMethodName(hash)) == ERROR_RES_CONTINUE)
                         goto FAIL_OP_INVOKE;
 
@@ -1513,6 +1684,7 @@ PUBLIC int     VMThread::RunInstruction() {
             }
 
             FAIL_OP_INVOKE:
+            frame = &Frames[FrameCount - 1];
             VM_BREAK;
         }
         VM_CASE(OP_CLASS): {
@@ -1620,6 +1792,7 @@ PUBLIC int     VMThread::RunInstruction() {
             if (ScriptManager::Lock()) {
                 VMValue value = Pop();
                 enumeration->Fields->Put(hash, value);
+                GarbageCollector::WriteBarrier((Obj*)enumeration);
                 Pop();
                 Push(value);
                 ScriptManager::Unlock();
@@ -1650,21 +1823,12 @@ PUBLIC int     VMThread::RunInstruction() {
         }
     #endif
 
-    return INTERPRET_OK;
+    goto dispatch_next;
 }
 PUBLIC void    VMThread::RunInstructionSet() {
-    while (true) {
-        // if (!ScriptManager::Lock()) break;
-
-        int ret;
-        if ((ret = RunInstruction()) < INTERPRET_OK) {
-            if (ret < INTERPRET_FINISHED)
-                Log::Print(Log::LOG_ERROR, "Error Code: %d!", ret);
-            // ScriptManager::Unlock();
-            break;
-        }
-        // ScriptManager::Unlock();
-    }
+    int ret = RunInstruction();
+    if (ret < INTERPRET_FINISHED)
+        Log::Print(Log::LOG_ERROR, "Error Code: %d!", ret);
 }
 // #endregion
 
@@ -1800,6 +1964,12 @@ PUBLIC bool    VMThread::CallBoundMethod(ObjBoundMethod* bound, int argCount) {
     StackTop[-argCount - 1] = bound->Receiver;
     return Call(bound->Method, argCount);
 }
+// Natives can store into any object they are given (Array.Push, etc.)
+static inline void WriteBarrierArguments(VMValue* args, int argCount) {
+    for (int i = 0; i < argCount; i++)
+        GarbageCollector::WriteBarrier(args[i]);
+}
+
 PUBLIC bool    VMThread::CallValue(VMValue callee, int argCount) {
     if (ScriptManager::Lock()) {
         bool result;
@@ -1818,6 +1988,7 @@ PUBLIC bool    VMThread::CallValue(VMValue callee, int argCount) {
                     NativeFn native = AS_NATIVE(callee);
 
                     VMValue result = NULL_VAL;
+                    WriteBarrierArguments(StackTop - argCount, argCount);
                     try {
                         result = native(argCount, StackTop - argCount, ID);
                     }
@@ -1853,6 +2024,7 @@ PUBLIC bool    VMThread::CallForObject(VMValue callee, int argCount) {
                 NativeFn native = AS_NATIVE(callee);
 
                 VMValue returnValue = NULL_VAL;
+                WriteBarrierArguments(StackTop - argCount - 1, argCount + 1);
                 try {
                     // Calling a native function for some object needs to correctly pass the
                     // receiver, which is why the +1 and -1 are there.
@@ -1955,16 +2127,33 @@ PUBLIC bool    VMThread::InvokeFromClass(ObjClass* klass, Uint32 hash, int argCo
     }
     return false;
 }
-PUBLIC bool    VMThread::InvokeForInstance(Uint32 hash, int argCount, bool isSuper) {
+PUBLIC bool    VMThread::InvokeForInstance(InlineCache* cache, Uint32 hash, int argCount, bool isSuper) {
     ObjInstance* instance = AS_INSTANCE(Peek(argCount));
     ObjClass* klass = instance->Object.Class;
+    InlineCacheEntry* entry = cache ? cache->Find(klass, instance->Shape) : NULL;
+
+    VMValue method;
+    if (entry) {
+        if (entry->Slot >= 0)
+            return CallValue(instance->Fields[entry->Slot], argCount);
+        if (GetCachedMethod(entry, &method))
+            return CallForObject(method, argCount);
+    }
 
     if (!isSuper) {
         // First look for a field which may shadow a method.
         VMValue value;
         bool exists = false;
         if (ScriptManager::Lock()) {
-            exists = instance->Fields->GetIfExists(hash, &value);
+            int slot = instance->Shape->Find(hash);
+            if (slot >= 0) {
+                if (cache) {
+                    entry = cache->Add(klass, instance->Shape);
+                    entry->Slot = slot;
+                }
+                value = instance->Fields[slot];
+                exists = true;
+            }
             ScriptManager::Unlock();
         }
         if (exists) {
@@ -1972,24 +2161,42 @@ PUBLIC bool    VMThread::InvokeForInstance(Uint32 hash, int argCount, bool isSup
         }
     }
     else {
-        ObjClass* parentClass = ScriptManager::GetClassParent(klass);
-        if (parentClass)
-            return InvokeFromClass(parentClass, hash, argCount);
-        else
+        klass = ScriptManager::GetClassParent(klass);
+        if (!klass) {
             ThrowRuntimeError(false, "Instance's class does not have a parent to call method from.");
-        return false;
+            return false;
+        }
+    }
+
+    if (!cache)
+        return InvokeFromClass(klass, hash, argCount);
+
+    if (ScriptManager::Lock()) {
+        method = ScriptManager::GetClassMethod(klass, hash);
+        if (!IS_NULL(method)) {
+            entry = cache->Add(instance->Object.Class, instance->Shape);
+            entry->Epoch = ScriptManager::InlineCacheEpoch;
+            entry->Method = method;
+        }
+        ScriptManager::Unlock();
     }
-    return InvokeFromClass(klass, hash, argCount);
+    if (IS_NULL(method))
+        return false;
+    return CallForObject(method, argCount);
 }
 PUBLIC bool    VMThread::DoClassExtension(VMValue value, VMValue originalValue) {
     ObjClass* src = AS_CLASS(value);
     ObjClass* dst = AS_CLASS(originalValue);
 
+    GarbageCollector::WriteBarrier((Obj*)dst);
+
     src->Methods->WithAll([dst](Uint32 hash, VMValue value) -> void {
         dst->Methods->Put(hash, value);
     });
     src->Methods->Clear();
 
+    ScriptManager::InvalidateInlineCaches();
+
     src->Fields->WithAll([dst](Uint32 hash, VMValue value) -> void {
         dst->Fields->Put(hash, value);
     });
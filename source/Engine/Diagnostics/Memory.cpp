@@ -4,9 +4,18 @@
 
 class Memory {
 private:
-    static vector<void*>       TrackedMemory;
-    static vector<size_t>      TrackedSizes;
-    static vector<const char*> TrackedMemoryNames;
+    struct TrackedAllocation {
+        size_t      Size;
+        const char* Name;
+    };
+    struct TagUsage {
+        size_t      Count;
+        size_t      Size;
+    };
+
+    static std::unordered_map<void*, TrackedAllocation>      TrackedMemory;
+    static std::unordered_map<const char*, TagUsage>         TagUsages;
+    static void*                                             LastTracked;
 public:
     static size_t              MemoryUsage;
     static bool                IsTracking;
@@ -16,13 +25,15 @@ public:
 #include <Engine/Diagnostics/Log.h>
 #include <Engine/Diagnostics/Memory.h>
 
+#include <map>
+
 // #if defined(ANDROID)
 // #define NOTRACK
 // #endif
 
-vector<void*>        Memory::TrackedMemory;
-vector<size_t>       Memory::TrackedSizes;
-vector<const char*>  Memory::TrackedMemoryNames;
+std::unordered_map<void*, Memory::TrackedAllocation> Memory::TrackedMemory;
+std::unordered_map<const char*, Memory::TagUsage>    Memory::TagUsages;
+void*                Memory::LastTracked = NULL;
 size_t               Memory::MemoryUsage = 0;
 bool                 Memory::IsTracking = false;
 
@@ -53,15 +64,44 @@ PUBLIC STATIC void   Memory::Memset4(void* dst, Uint32 val, size_t dwords) {
     #endif
 }
 
+// Allocations are kept in a hash table keyed by their address, and the
+// count and size of every tag is kept up to date as they come and go, so
+// tracking stays cheap no matter how many allocations are alive.
+PRIVATE STATIC void  Memory::AddTagUsage(const char* identifier, size_t size) {
+    TagUsage& usage = TagUsages[identifier];
+    usage.Count++;
+    usage.Size += size;
+}
+PRIVATE STATIC void  Memory::RemoveTagUsage(const char* identifier, size_t size) {
+    auto it = TagUsages.find(identifier);
+    if (it == TagUsages.end())
+        return;
+
+    it->second.Count--;
+    it->second.Size -= size;
+}
+PRIVATE STATIC void  Memory::AddTracked(void* pointer, size_t size, const char* identifier) {
+    MemoryUsage += size;
+
+    TrackedAllocation& allocation = TrackedMemory[pointer];
+    allocation.Size = size;
+    allocation.Name = identifier;
+    AddTagUsage(identifier, size);
+
+    LastTracked = pointer;
+}
+PRIVATE STATIC void  Memory::SetTracked(TrackedAllocation& allocation, size_t size, const char* identifier) {
+    RemoveTagUsage(allocation.Name, allocation.Size);
+    allocation.Size = size;
+    allocation.Name = identifier;
+    AddTagUsage(identifier, size);
+}
+
 PUBLIC STATIC void*  Memory::Malloc(size_t size) {
     void* mem = malloc(size);
     if (Memory::IsTracking) {
         if (mem) {
-            MemoryUsage += size;
-
-            TrackedMemory.push_back(mem);
-            TrackedSizes.push_back(size);
-            TrackedMemoryNames.push_back(NULL);
+            AddTracked(mem, size, NULL);
         }
         else {
             Log::Print(Log::LOG_ERROR, "Could not allocate memory for Malloc!");
@@ -73,11 +113,7 @@ PUBLIC STATIC void*  Memory::Calloc(size_t count, size_t size) {
     void* mem = calloc(count, size);
     if (Memory::IsTracking) {
         if (mem) {
-            MemoryUsage += count * size;
-
-            TrackedMemory.push_back(mem);
-            TrackedSizes.push_back(count * size);
-            TrackedMemoryNames.push_back(NULL);
+            AddTracked(mem, count * size, NULL);
         }
         else {
             Log::Print(Log::LOG_ERROR, "Could not allocate memory for Calloc!");
@@ -89,14 +125,14 @@ PUBLIC STATIC void*  Memory::Realloc(void* pointer, size_t size) {
     void* mem = realloc(pointer, size);
     if (Memory::IsTracking) {
         if (mem) {
-            for (Uint32 i = 0; i < TrackedMemory.size(); i++) {
-                if (TrackedMemory[i] == pointer) {
-                    MemoryUsage += size - TrackedSizes[i];
+            auto it = TrackedMemory.find(pointer);
+            if (it != TrackedMemory.end()) {
+                TrackedAllocation allocation = it->second;
+                TrackedMemory.erase(it);
 
-                    TrackedMemory[i] = mem;
-                    TrackedSizes[i] = size;
-                    return mem;
-                }
+                MemoryUsage -= allocation.Size;
+                RemoveTagUsage(allocation.Name, allocation.Size);
+                AddTracked(mem, size, allocation.Name);
             }
         }
         else {
@@ -110,11 +146,7 @@ PUBLIC STATIC void*  Memory::TrackedMalloc(const char* identifier, size_t size)
     void* mem = malloc(size);
     if (Memory::IsTracking) {
         if (mem) {
-            MemoryUsage += size;
-
-            TrackedMemory.push_back(mem);
-            TrackedSizes.push_back(size);
-            TrackedMemoryNames.push_back(identifier);
+            AddTracked(mem, size, identifier);
         }
         else {
             Log::Print(Log::LOG_ERROR, "Could not allocate memory for TrackedMalloc!");
@@ -129,11 +161,7 @@ PUBLIC STATIC void*  Memory::TrackedCalloc(const char* identifier, size_t count,
     void* mem = calloc(count, size);
     if (Memory::IsTracking) {
         if (mem) {
-            MemoryUsage += count * size;
-
-            TrackedMemory.push_back(mem);
-            TrackedSizes.push_back(count * size);
-            TrackedMemoryNames.push_back(identifier);
+            AddTracked(mem, count * size, identifier);
         }
         else {
             Log::Print(Log::LOG_ERROR, "Could not allocate memory for TrackedCalloc!");
@@ -143,56 +171,48 @@ PUBLIC STATIC void*  Memory::TrackedCalloc(const char* identifier, size_t count,
 }
 PUBLIC STATIC void   Memory::Track(void* pointer, const char* identifier) {
     if (Memory::IsTracking) {
-        for (Uint32 i = 0; i < TrackedMemory.size(); i++) {
-            if (TrackedMemory[i] == pointer) {
-                TrackedMemoryNames[i] = identifier;
-                return;
-            }
-        }
+        auto it = TrackedMemory.find(pointer);
+        if (it != TrackedMemory.end())
+            SetTracked(it->second, it->second.Size, identifier);
     }
 }
 PUBLIC STATIC void   Memory::Track(void* pointer, size_t size, const char* identifier) {
     if (Memory::IsTracking) {
-        for (Uint32 i = 0; i < TrackedMemory.size(); i++) {
-            if (TrackedMemory[i] == pointer) {
-                TrackedSizes[i] = size;
-                TrackedMemoryNames[i] = identifier;
-                return;
-            }
+        auto it = TrackedMemory.find(pointer);
+        if (it != TrackedMemory.end()) {
+            MemoryUsage += size - it->second.Size;
+            SetTracked(it->second, size, identifier);
+            return;
         }
 
-        TrackedMemory.push_back(pointer);
-        TrackedSizes.push_back(size);
-        TrackedMemoryNames.push_back(identifier);
+        AddTracked(pointer, size, identifier);
     }
 }
 PUBLIC STATIC void   Memory::TrackLast(const char* identifier) {
     if (Memory::IsTracking) {
-        if (TrackedMemoryNames.size() == 0) return;
-        TrackedMemoryNames[TrackedMemoryNames.size() - 1] = identifier;
+        if (!LastTracked) return;
+        Track(LastTracked, identifier);
     }
 }
 PUBLIC STATIC void   Memory::Free(void* pointer) {
     if (Memory::IsTracking) {
         #ifdef DEBUG
-        for (Uint32 i = 0; i < TrackedMemory.size(); i++) {
-            if (TrackedMemory[i] == pointer) {
-                // 32-bit
-                size_t ptr_size = sizeof(void*);
-                if (ptr_size == 4) {
-                    size_t* debug = (size_t*)TrackedMemory[i];
-                    for (size_t d = 0, dSz = TrackedSizes[i] / ptr_size; d < dSz; d++) {
-                        debug[d] = 0xCDCDCDCDU;
-                    }
+        auto it = TrackedMemory.find(pointer);
+        if (it != TrackedMemory.end()) {
+            // 32-bit
+            size_t ptr_size = sizeof(void*);
+            if (ptr_size == 4) {
+                size_t* debug = (size_t*)pointer;
+                for (size_t d = 0, dSz = it->second.Size / ptr_size; d < dSz; d++) {
+                    debug[d] = 0xCDCDCDCDU;
                 }
-                // 64-bit
-                else if (ptr_size == 8) {
-                    size_t* debug = (size_t*)TrackedMemory[i];
-                    for (size_t d = 0, dSz = TrackedSizes[i] / ptr_size; d < dSz; d++) {
-                        debug[d] = 0xCDCDCDCDCDCDCDCDU;
-                    }
+            }
+            // 64-bit
+            else if (ptr_size == 8) {
+                size_t* debug = (size_t*)pointer;
+                for (size_t d = 0, dSz = it->second.Size / ptr_size; d < dSz; d++) {
+                    debug[d] = 0xCDCDCDCDCDCDCDCDU;
                 }
-                break;
             }
         }
         #endif
@@ -205,49 +225,64 @@ PUBLIC STATIC void   Memory::Free(void* pointer) {
 PUBLIC STATIC void   Memory::Remove(void* pointer) {
     if (!pointer) return;
     if (Memory::IsTracking) {
-        for (Uint32 i = 0; i < TrackedMemory.size(); i++) {
-            if (TrackedMemory[i] == pointer) {
-                MemoryUsage -= TrackedSizes[i];
-                // printf("TrackedSizes[i]: %zu\n", TrackedSizes[i]);
-
-                TrackedMemoryNames.erase(TrackedMemoryNames.begin() + i);
-                TrackedMemory.erase(TrackedMemory.begin() + i);
-                TrackedSizes.erase(TrackedSizes.begin() + i);
-                return;
-            }
+        auto it = TrackedMemory.find(pointer);
+        if (it != TrackedMemory.end()) {
+            MemoryUsage -= it->second.Size;
+            RemoveTagUsage(it->second.Name, it->second.Size);
+            TrackedMemory.erase(it);
+
+            if (LastTracked == pointer)
+                LastTracked = NULL;
         }
     }
 }
 
 PUBLIC STATIC const char* Memory::GetName(void* pointer) {
     if (Memory::IsTracking) {
-        for (Uint32 i = 0; i < TrackedMemory.size(); i++) {
-            if (TrackedMemory[i] == pointer) {
-                return TrackedMemoryNames[i];
-            }
-        }
+        auto it = TrackedMemory.find(pointer);
+        if (it != TrackedMemory.end())
+            return it->second.Name;
     }
     return NULL;
 }
 
 PUBLIC STATIC void   Memory::ClearTrackedMemory() {
-    TrackedMemoryNames.clear();
     TrackedMemory.clear();
-    TrackedSizes.clear();
+    TagUsages.clear();
+    LastTracked = NULL;
 }
 PUBLIC STATIC size_t Memory::CheckLeak() {
     size_t total = 0;
-    for (Uint32 i = 0; i < TrackedMemory.size(); i++) {
-        total += TrackedSizes[i];
+    for (auto it = TagUsages.begin(); it != TagUsages.end(); it++) {
+        total += it->second.Size;
     }
     return total;
 }
 PUBLIC STATIC void   Memory::PrintLeak() {
     size_t total = 0;
     Log::Print(Log::LOG_VERBOSE, "Printing unfreed memory... (%u count)", TrackedMemory.size());
-    for (Uint32 i = 0; i < TrackedMemory.size(); i++) {
-        Log::Print(Log::LOG_VERBOSE, " : %p [%u bytes] (%s)", TrackedMemory[i], TrackedSizes[i], TrackedMemoryNames[i] ? TrackedMemoryNames[i] : "no name");
-        total += TrackedSizes[i];
+    for (auto it = TrackedMemory.begin(); it != TrackedMemory.end(); it++) {
+        Log::Print(Log::LOG_VERBOSE, " : %p [%u bytes] (%s)", it->first, it->second.Size, it->second.Name ? it->second.Name : "no name");
+        total += it->second.Size;
     }
     Log::Print(Log::LOG_VERBOSE, "Total: %u bytes (%.3f MB)", total, total / 1024 / 1024.0);
+    Memory::PrintTagUsage();
+}
+PUBLIC STATIC void   Memory::PrintTagUsage() {
+    // The same name can come from different string literals, so add those
+    // up by name first.
+    std::map<std::string, TagUsage> byName;
+    for (auto it = TagUsages.begin(); it != TagUsages.end(); it++) {
+        if (!it->second.Count)
+            continue;
+
+        TagUsage& usage = byName[it->first ? it->first : "no name"];
+        usage.Count += it->second.Count;
+        usage.Size += it->second.Size;
+    }
+
+    Log::Print(Log::LOG_VERBOSE, "Tracked memory by tag:");
+    for (auto it = byName.begin(); it != byName.end(); it++) {
+        Log::Print(Log::LOG_VERBOSE, " : %s: %u allocation(s), %u bytes", it->first.c_str(), (Uint32)it->second.Count, (Uint32)it->second.Size);
+    }
 }
@@ -15,6 +15,8 @@ public:
 #include <Engine/FontFace.h>
 #include <Engine/Diagnostics/Log.h>
 #include <Engine/Diagnostics/Memory.h>
+#include <Engine/Graphics.h>
+#include <Engine/Rendering/TextureAtlas.h>
 
 #ifdef USING_FREETYPE
     #include <ft2build.h>
@@ -216,8 +218,13 @@ PUBLIC STATIC ISprite* FontFace::SpriteFromFont(Stream* stream, int pixelSize, c
 		}
 	}
 
-    sprite->Spritesheets[0] = Graphics::CreateTextureFromPixels(package->Width, package->Height, pixelData, package->Width * sizeof(Uint32));
-    sprite->SpritesheetsBorrowed[0] = false;
+    // Glyph pages share atlas pages with sprite sheets where they fit
+    sprite->Spritesheets[0] = TextureAtlas::Add(NULL, pixelData, package->Width, package->Height, &sprite->SpritesheetsAtlasX[0], &sprite->SpritesheetsAtlasY[0]);
+    sprite->SpritesheetsBorrowed[0] = true;
+    if (!sprite->Spritesheets[0]) {
+        sprite->Spritesheets[0] = Graphics::CreateTextureFromPixels(package->Width, package->Height, pixelData, package->Width * sizeof(Uint32));
+        sprite->SpritesheetsBorrowed[0] = false;
+    }
     sprite->SpritesheetCount = 1;
 
 	// Add preliminary chars
@@ -100,6 +100,7 @@ public:
 #include <Engine/Math/Math.h>
 
 #include <Engine/Rendering/Software/SoftwareRenderer.h>
+#include <Engine/Rendering/TextureAtlas.h>
 #ifdef USING_OPENGL
     #include <Engine/Rendering/GL/GLRenderer.h>
 #endif
@@ -202,6 +203,8 @@ PUBLIC STATIC void     Graphics::Init() {
 
     Graphics::GfxFunctions->Init();
 
+    TextureAtlas::Init();
+
     Log::Print(Log::LOG_VERBOSE, "Window Size: %d x %d", w, h);
     Log::Print(Log::LOG_INFO, "Window Pixel Format: %s", SDL_GetPixelFormatName(SDL_GetWindowPixelFormat(Application::Window)));
     Log::Print(Log::LOG_INFO, "VSync: %s", Graphics::VsyncEnabled ? "true" : "false");
@@ -310,6 +313,8 @@ PUBLIC STATIC void     Graphics::Dispose() {
     for (Uint32 i = 0; i < MAX_3D_SCENES; i++)
         Graphics::DeleteScene3D(i);
 
+    TextureAtlas::Dispose();
+
     for (Texture* texture = Graphics::TextureHead, *next; texture != NULL; texture = next) {
         next = texture->Next;
         Graphics::DisposeTexture(texture);
@@ -320,6 +325,7 @@ PUBLIC STATIC void     Graphics::Dispose() {
     Graphics::SpriteSheetTextureMap->Clear();
 
     Graphics::GfxFunctions->Dispose();
+    SoftwareRenderer::Dispose();
 
     delete Graphics::TextureMap;
     delete Graphics::SpriteSheetTextureMap;
@@ -390,12 +396,30 @@ PUBLIC STATIC int      Graphics::LockTexture(Texture* texture, void** pixels, in
     return Graphics::GfxFunctions->LockTexture(texture, pixels, pitch);
 }
 PUBLIC STATIC int      Graphics::UpdateTexture(Texture* texture, SDL_Rect* src, void* pixels, int pitch) {
+    SoftwareRenderer::FlushCommands();
     memcpy(texture->Pixels, pixels, sizeof(Uint32) * texture->Width * texture->Height);
     if (Graphics::GfxFunctions == &SoftwareRenderer::BackendFunctions ||
         Graphics::NoInternalTextures)
         return 1;
     return Graphics::GfxFunctions->UpdateTexture(texture, src, pixels, pitch);
 }
+// Updates part of a texture. The given pixels only cover the rectangle.
+PUBLIC STATIC int      Graphics::UpdateTextureRect(Texture* texture, SDL_Rect* rect, void* pixels, int pitch) {
+    SoftwareRenderer::FlushCommands();
+    if (pixels != texture->Pixels) {
+        Uint8*  src = (Uint8*)pixels;
+        Uint32* dst = (Uint32*)texture->Pixels + rect->x + rect->y * texture->Width;
+        for (int y = 0; y < rect->h; y++) {
+            memcpy(dst, src, rect->w * sizeof(Uint32));
+            dst += texture->Width;
+            src += pitch;
+        }
+    }
+    if (Graphics::GfxFunctions == &SoftwareRenderer::BackendFunctions ||
+        Graphics::NoInternalTextures)
+        return 1;
+    return Graphics::GfxFunctions->UpdateTexture(texture, rect, pixels, pitch);
+}
 PUBLIC STATIC int      Graphics::UpdateYUVTexture(Texture* texture, SDL_Rect* src, Uint8* pixelsY, int pitchY, Uint8* pixelsU, int pitchU, Uint8* pixelsV, int pitchV) {
     if (!Graphics::GfxFunctions->UpdateYUVTexture)
         return 0;
@@ -405,6 +429,7 @@ PUBLIC STATIC int      Graphics::UpdateYUVTexture(Texture* texture, SDL_Rect* sr
     return Graphics::GfxFunctions->UpdateYUVTexture(texture, src, pixelsY, pitchY, pixelsU, pitchU, pixelsV, pitchV);
 }
 PUBLIC STATIC int      Graphics::SetTexturePalette(Texture* texture, void* palette, unsigned numPaletteColors) {
+    SoftwareRenderer::FlushCommands();
     texture->SetPalette((Uint32*)palette, numPaletteColors);
     if (Graphics::GfxFunctions == &SoftwareRenderer::BackendFunctions ||
         !Graphics::GfxFunctions->SetTexturePalette || Graphics::NoInternalTextures)
@@ -412,6 +437,7 @@ PUBLIC STATIC int      Graphics::SetTexturePalette(Texture* texture, void* palet
     return Graphics::GfxFunctions->SetTexturePalette(texture, palette, numPaletteColors);
 }
 PUBLIC STATIC int      Graphics::ConvertTextureToRGBA(Texture* texture) {
+    SoftwareRenderer::FlushCommands();
     texture->ConvertToRGBA();
     if (Graphics::GfxFunctions == &SoftwareRenderer::BackendFunctions ||
         Graphics::NoInternalTextures)
@@ -419,6 +445,7 @@ PUBLIC STATIC int      Graphics::ConvertTextureToRGBA(Texture* texture) {
     return Graphics::GfxFunctions->UpdateTexture(texture, NULL, texture->Pixels, texture->Pitch);
 }
 PUBLIC STATIC int      Graphics::ConvertTextureToPalette(Texture* texture, unsigned paletteNumber) {
+    SoftwareRenderer::FlushCommands();
     Uint32* colors = (Uint32*)Memory::TrackedMalloc("Texture::Colors", 256 * sizeof(Uint32));
     if (!colors)
         return 0;
@@ -445,6 +472,7 @@ PUBLIC STATIC void     Graphics::UnlockTexture(Texture* texture) {
     Graphics::GfxFunctions->UnlockTexture(texture);
 }
 PUBLIC STATIC void     Graphics::DisposeTexture(Texture* texture) {
+    SoftwareRenderer::FlushCommands();
     Graphics::GfxFunctions->DisposeTexture(texture);
 
     if (texture->Next)
@@ -513,7 +541,9 @@ PUBLIC STATIC void     Graphics::SoftwareStart() {
 PUBLIC STATIC void     Graphics::SoftwareEnd() {
     SoftwareRenderer::RenderEnd();
     Graphics::GfxFunctions = &Graphics::Internal;
-    Graphics::UpdateTexture(Graphics::CurrentRenderTarget, NULL, Graphics::CurrentRenderTarget->Pixels, Graphics::CurrentRenderTarget->Width * 4);
+    // A pipelined frame is uploaded once it's done drawing
+    if (!SoftwareRenderer::IsFramePending())
+        Graphics::UpdateTexture(Graphics::CurrentRenderTarget, NULL, Graphics::CurrentRenderTarget->Pixels, Graphics::CurrentRenderTarget->Width * 4);
 }
 
 PUBLIC STATIC void     Graphics::UpdateGlobalPalette() {
@@ -552,6 +582,10 @@ PUBLIC STATIC void     Graphics::UnloadSceneData() {
 }
 
 PUBLIC STATIC void     Graphics::SetRenderTarget(Texture* texture) {
+    // Going back to the screen doesn't need a pipelined frame to be done
+    if (texture || !SoftwareRenderer::IsFramePending())
+        SoftwareRenderer::FlushCommands();
+
     if (texture && !Graphics::CurrentRenderTarget) {
         Graphics::BackupViewport = Graphics::CurrentViewport;
         Graphics::BackupClip = Graphics::CurrentClip;
@@ -145,6 +145,14 @@ public:
         Uint32 hash = HashFunction(key, strlen(key));
         return GetIfExists(hash, result);
     }
+    bool   GetIndexIfExists(Uint32 hash, int* result) {
+        Uint32 index = FindKey(hash);
+        if (index == 0xFFFFFFFFU)
+            return false;
+
+        *result = (int)index;
+        return true;
+    }
 
     bool   Remove(Uint32 hash) {
         Uint32 index = TranslateIndex(hash);
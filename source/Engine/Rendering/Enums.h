@@ -88,6 +88,12 @@ enum {
     DrawMode_DEPTH_TEST      = 1<<6,
     DrawMode_FOG             = 1<<7,
     DrawMode_ORTHOGRAPHIC    = 1<<8,
+
+    DrawMode_SUBDIVIDE_8     = 1<<9,
+    DrawMode_SUBDIVIDE_16    = 2<<9,
+    DrawMode_SUBDIVIDE_32    = 3<<9,
+    DrawMode_SubdivideMask   = 3<<9,
+
     DrawMode_FlagsMask       = ~0xF
 };
 
@@ -163,6 +163,52 @@ struct   GL_Scene3DBatch {
     bool           ShouldDraw;
     vector<Uint32> VertexIndices;
 };
+struct   GL_BatchVertex {
+    float X, Y, Z;
+    float U, V;
+    float R, G, B, A;
+};
+
+// Must fit in 16-bit indices
+#define GL_BATCH_MAX_QUADS 2048
+
+enum {
+    GL_BatchFlush_Texture,
+    GL_BatchFlush_Shader,
+    GL_BatchFlush_Blend,
+    GL_BatchFlush_Clip,
+    GL_BatchFlush_Target,
+    GL_BatchFlush_State,
+    GL_BatchFlush_Full,
+    GL_BatchFlush_Draw,
+    GL_BatchFlush_Frame,
+
+    GL_BatchFlush_MAX
+};
+const char* GL_BatchFlushNames[GL_BatchFlush_MAX] = {
+    "Texture change",
+    "Shader change",
+    "Blend change",
+    "Clip change",
+    "Target change",
+    "State change",
+    "Batch full",
+    "Unbatched draw",
+    "End of frame",
+};
+
+struct   GL_SpriteBatch {
+    Texture*       TexturePtr;
+    GLShader*      Shader;
+    Matrix4x4      ProjectionMatrix;
+    Uint32         QuadCount;
+    GL_BatchVertex Vertices[GL_BATCH_MAX_QUADS * 4];
+};
+struct   GL_BatchStats {
+    Uint32 DrawCalls;
+    Uint32 Quads;
+    Uint32 Flushes[GL_BatchFlush_MAX];
+};
 
 void *GL_VertexIndexBuffer = nullptr;
 size_t GL_VertexIndexBufferCapacity = 0;
@@ -171,6 +217,15 @@ GLenum GL_VertexIndexBufferFormat;
 size_t GL_VertexIndexBufferMaxElements;
 size_t GL_VertexIndexBufferStride;
 
+bool           GL_UseSpriteBatching = true;
+GL_SpriteBatch GL_Batch;
+GLuint         GL_BatchVertexBuffer = 0;
+GLuint         GL_BatchIndexBuffer = 0;
+Matrix4x4      GL_BatchModelViewMatrix;
+GL_BatchStats  GL_BatchStatsFrame;
+GL_BatchStats  GL_BatchStatsLastFrame;
+int            GL_LastBlendFactors[4] = { -1, -1, -1, -1 };
+
 #ifdef HAVE_GL_PERFSTATS
 #define PERF_START(p) (p).Time = Clock::GetTicks()
 #define PERF_STATE_CHANGE(p) (p).StateChanges++
@@ -240,6 +295,32 @@ void   GL_MakeShapeBuffers() {
     // Reset buffer
     glBindBuffer(GL_ARRAY_BUFFER, 0); CHECK_GL();
 }
+void   GL_MakeSpriteBatchBuffers() {
+    Uint16 indices[GL_BATCH_MAX_QUADS * 6];
+    for (Uint32 q = 0; q < GL_BATCH_MAX_QUADS; q++) {
+        Uint16 v = (Uint16)(q << 2);
+        indices[q * 6 + 0] = v + 0;
+        indices[q * 6 + 1] = v + 1;
+        indices[q * 6 + 2] = v + 2;
+        indices[q * 6 + 3] = v + 2;
+        indices[q * 6 + 4] = v + 1;
+        indices[q * 6 + 5] = v + 3;
+    }
+    glGenBuffers(1, &GL_BatchIndexBuffer); CHECK_GL();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_BatchIndexBuffer); CHECK_GL();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW); CHECK_GL();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); CHECK_GL();
+
+    glGenBuffers(1, &GL_BatchVertexBuffer); CHECK_GL();
+    glBindBuffer(GL_ARRAY_BUFFER, GL_BatchVertexBuffer); CHECK_GL();
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GL_Batch.Vertices), NULL, GL_STREAM_DRAW); CHECK_GL();
+    glBindBuffer(GL_ARRAY_BUFFER, 0); CHECK_GL();
+
+    // Batched vertices are already in view space
+    Matrix4x4::Identity(&GL_BatchModelViewMatrix);
+
+    GL_Batch.QuadCount = 0;
+}
 void   GL_BindTexture(Texture* texture) {
     // Do texture (re-)binding if necessary
     if (GL_LastTexture != texture) {
@@ -333,7 +414,115 @@ void   GL_SetModelViewMatrix(Matrix4x4* modelViewMatrix) {
         glUniformMatrix4fv(GLRenderer::CurrentShader->LocModelViewMatrix, 1, false, GLRenderer::CurrentShader->CachedModelViewMatrix->Values); CHECK_GL();
     }
 }
+
+// Sprite batching
+// Textured quads are transformed on the CPU and collected into one streaming
+// vertex buffer, then drawn with the vertex-colored shader in a single call.
+// Anything that changes GL state the batch depends on has to flush it first.
+void   GL_FlushSpriteBatch(int reason) {
+    if (!GL_Batch.QuadCount)
+        return;
+
+    GLRenderer::UseShader(GL_Batch.Shader);
+    if (GL_Batch.Shader == GLRenderer::ShaderShape3D->PalettizedTextured)
+        GL_PreparePaletteShader();
+    GL_BindTexture(GL_Batch.TexturePtr);
+
+    GL_SetProjectionMatrix(&GL_Batch.ProjectionMatrix);
+    GL_SetModelViewMatrix(&GL_BatchModelViewMatrix);
+
+    GLShader* shader = GLRenderer::CurrentShader;
+    size_t stride = sizeof(GL_BatchVertex);
+
+    // Orphan the previous contents so that the driver doesn't have to wait for
+    // the last batch to finish drawing before it can be overwritten
+    glBindBuffer(GL_ARRAY_BUFFER, GL_BatchVertexBuffer); CHECK_GL();
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GL_Batch.Vertices), NULL, GL_STREAM_DRAW); CHECK_GL();
+    glBufferSubData(GL_ARRAY_BUFFER, 0, GL_Batch.QuadCount * 4 * stride, GL_Batch.Vertices); CHECK_GL();
+
+    glEnableVertexAttribArray(shader->LocPosition); CHECK_GL();
+    glVertexAttribPointer(shader->LocPosition, 3, GL_FLOAT, GL_FALSE, stride, (char*)NULL + 0); CHECK_GL();
+    glEnableVertexAttribArray(shader->LocTexCoord); CHECK_GL();
+    glVertexAttribPointer(shader->LocTexCoord, 2, GL_FLOAT, GL_FALSE, stride, (char*)NULL + 12); CHECK_GL();
+    glEnableVertexAttribArray(shader->LocVaryingColor); CHECK_GL();
+    glVertexAttribPointer(shader->LocVaryingColor, 4, GL_FLOAT, GL_FALSE, stride, (char*)NULL + 20); CHECK_GL();
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_BatchIndexBuffer); CHECK_GL();
+    glDrawElements(GL_TRIANGLES, GL_Batch.QuadCount * 6, GL_UNSIGNED_SHORT, 0); CHECK_GL();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); CHECK_GL();
+
+    glDisableVertexAttribArray(shader->LocVaryingColor); CHECK_GL();
+    glBindBuffer(GL_ARRAY_BUFFER, 0); CHECK_GL();
+
+    GL_BatchStatsFrame.DrawCalls++;
+    GL_BatchStatsFrame.Quads += GL_Batch.QuadCount;
+    GL_BatchStatsFrame.Flushes[reason]++;
+
+    GL_Batch.QuadCount = 0;
+}
+// Adds a quad, given as a triangle strip, to the sprite batch.
+// Returns false if it can't be batched and has to be drawn as usual.
+bool   GL_AddSpriteQuad(Texture* texture, GL_AnimFrameVert* quad) {
+    if (!GL_UseSpriteBatching || !texture || !texture->DriverData)
+        return false;
+    if (((GL_TextureData*)texture->DriverData)->YUV)
+        return false;
+
+    float r = 1.0f, g = 1.0f, b = 1.0f, a = 1.0f;
+    if (Graphics::TextureBlend) {
+        r = Graphics::BlendColors[0];
+        g = Graphics::BlendColors[1];
+        b = Graphics::BlendColors[2];
+        a = Graphics::BlendColors[3];
+        // The vertex-colored shader discards these
+        if (a == 0.0f)
+            return false;
+    }
+
+    // Only affine transforms can be applied on the CPU
+    float* mv = Graphics::ModelViewMatrix->Values;
+    if (mv[3] != 0.0f || mv[7] != 0.0f || mv[11] != 0.0f || mv[15] != 1.0f)
+        return false;
+
+    GLShader* shader = GLRenderer::ShaderShape3D->Get(true, texture->Paletted && Graphics::UsePalettes);
+    Matrix4x4* projMat = Scene::Views[Scene::ViewCurrent].ProjectionMatrix;
+
+    if (GL_Batch.QuadCount) {
+        if (GL_Batch.TexturePtr != texture)
+            GL_FlushSpriteBatch(GL_BatchFlush_Texture);
+        else if (GL_Batch.Shader != shader)
+            GL_FlushSpriteBatch(GL_BatchFlush_Shader);
+        else if (!Matrix4x4::Equals(&GL_Batch.ProjectionMatrix, projMat))
+            GL_FlushSpriteBatch(GL_BatchFlush_Target);
+        else if (GL_Batch.QuadCount == GL_BATCH_MAX_QUADS)
+            GL_FlushSpriteBatch(GL_BatchFlush_Full);
+    }
+    if (!GL_Batch.QuadCount) {
+        GL_Batch.TexturePtr = texture;
+        GL_Batch.Shader = shader;
+        Matrix4x4::Copy(&GL_Batch.ProjectionMatrix, projMat);
+    }
+
+    GL_BatchVertex* vert = &GL_Batch.Vertices[GL_Batch.QuadCount << 2];
+    for (int i = 0; i < 4; i++) {
+        float x = quad[i].x;
+        float y = quad[i].y;
+        vert[i].X = mv[0] * x + mv[4] * y + mv[12];
+        vert[i].Y = mv[1] * x + mv[5] * y + mv[13];
+        vert[i].Z = mv[2] * x + mv[6] * y + mv[14];
+        vert[i].U = quad[i].u;
+        vert[i].V = quad[i].v;
+        vert[i].R = r;
+        vert[i].G = g;
+        vert[i].B = b;
+        vert[i].A = a;
+    }
+    GL_Batch.QuadCount++;
+    return true;
+}
+
 void   GL_Predraw(Texture* texture) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Draw);
     GL_SetTexture(texture);
 
     // Update color if needed
@@ -364,7 +553,49 @@ void   GL_DrawTextureBuffered(Texture* texture, GLuint buffer, int flip) {
 
     glDrawArrays(GL_TRIANGLE_STRIP, flip << 2, 4); CHECK_GL();
 }
+void   GL_DrawSpriteFrame(Texture* texture, AnimFrame* frame, bool flipX, bool flipY) {
+    if (frame->ID && texture) {
+        float fX = flipX ? -1.0f : 1.0f;
+        float fY = flipY ? -1.0f : 1.0f;
+        float x0 = fX * frame->OffsetX;
+        float y0 = fY * frame->OffsetY;
+        float x1 = fX * (frame->OffsetX + frame->Width);
+        float y1 = fY * (frame->OffsetY + frame->Height);
+        float u0 = frame->X / (float)texture->Width;
+        float v0 = frame->Y / (float)texture->Height;
+        float u1 = (frame->X + frame->Width) / (float)texture->Width;
+        float v1 = (frame->Y + frame->Height) / (float)texture->Height;
+
+        GL_AnimFrameVert quad[4];
+        quad[0] = GL_AnimFrameVert { x0, y0, u0, v0 };
+        quad[1] = GL_AnimFrameVert { x1, y0, u1, v0 };
+        quad[2] = GL_AnimFrameVert { x0, y1, u0, v1 };
+        quad[3] = GL_AnimFrameVert { x1, y1, u1, v1 };
+        if (GL_AddSpriteQuad(texture, quad))
+            return;
+    }
+
+    GL_DrawTextureBuffered(texture, frame->ID, ((int)flipY << 1) | (int)flipX);
+}
 void   GL_DrawTexture(Texture* texture, float sx, float sy, float sw, float sh, float x, float y, float w, float h) {
+    if (texture) {
+        float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+        if (sx >= 0.0) {
+            u0 = (sx) / texture->Width;
+            v0 = (sy) / texture->Height;
+            u1 = (sx + sw) / texture->Width;
+            v1 = (sy + sh) / texture->Height;
+        }
+
+        GL_AnimFrameVert quad[4];
+        quad[0] = GL_AnimFrameVert { x, y, u0, v0 };
+        quad[1] = GL_AnimFrameVert { x + w, y, u1, v0 };
+        quad[2] = GL_AnimFrameVert { x, y + h, u0, v1 };
+        quad[3] = GL_AnimFrameVert { x + w, y + h, u1, v1 };
+        if (GL_AddSpriteQuad(texture, quad))
+            return;
+    }
+
     GL_Predraw(texture);
 
     if (!Graphics::TextureBlend) {
@@ -531,7 +762,7 @@ void GL_PrepareVertexBufferUpdate(Scene3D* scene, VertexBuffer* vertexBuffer, Ui
             face->Depth = (Sint64)((depth * 0x10000) / face->NumVertices);
         }
 
-        qsort(vertexBuffer->FaceInfoBuffer, vertexBuffer->FaceCount, sizeof(FaceInfo), PolygonRenderer::FaceSortFunction);
+        PolygonRenderer::SortFaces(vertexBuffer->FaceInfoBuffer, vertexBuffer->FaceCount, false);
     }
 }
 void GL_UpdateVertexBuffer(Scene3D* scene, VertexBuffer* vertexBuffer, Uint32 drawMode, bool useBatching) {
@@ -993,8 +1224,11 @@ PUBLIC STATIC void     GLRenderer::Init() {
         GL_VertexIndexBufferStride = sizeof(Uint32);
     }
 
+    Application::Settings->GetBool("display", "spriteBatching", &GL_UseSpriteBatching);
+
     GL_MakeShaders();
     GL_MakeShapeBuffers();
+    GL_MakeSpriteBatchBuffers();
 
     UseShader(ShaderShape->Get());
     glEnableVertexAttribArray(GLRenderer::CurrentShader->LocPosition); CHECK_GL();
@@ -1121,6 +1355,8 @@ PUBLIC STATIC void     GLRenderer::Dispose() {
     glDeleteBuffers(1, &BufferCircleFill); CHECK_GL();
     glDeleteBuffers(1, &BufferCircleStroke); CHECK_GL();
     glDeleteBuffers(1, &BufferSquareFill); CHECK_GL();
+    glDeleteBuffers(1, &GL_BatchVertexBuffer); CHECK_GL();
+    glDeleteBuffers(1, &GL_BatchIndexBuffer); CHECK_GL();
 
     delete ShaderShape;
     delete ShaderShape3D;
@@ -1259,6 +1495,8 @@ PUBLIC STATIC int      GLRenderer::LockTexture(Texture* texture, void** pixels,
     return 0;
 }
 PUBLIC STATIC int      GLRenderer::UpdateTexture(Texture* texture, SDL_Rect* src, void* pixels, int pitch) {
+    GL_FlushSpriteBatch(GL_BatchFlush_State);
+
     Uint32 inputPixelsX = 0;
     Uint32 inputPixelsY = 0;
     Uint32 inputPixelsW = texture->Width;
@@ -1290,6 +1528,8 @@ PUBLIC STATIC int      GLRenderer::UpdateTexture(Texture* texture, SDL_Rect* src
     return 0;
 }
 PUBLIC STATIC int      GLRenderer::UpdateTextureYUV(Texture* texture, SDL_Rect* src, void* pixelsY, int pitchY, void* pixelsU, int pitchU, void* pixelsV, int pitchV) {
+    GL_FlushSpriteBatch(GL_BatchFlush_State);
+
     int inputPixelsX = 0;
     int inputPixelsY = 0;
     int inputPixelsW = texture->Width;
@@ -1330,6 +1570,8 @@ PUBLIC STATIC void     GLRenderer::UnlockTexture(Texture* texture) {
 
 }
 PUBLIC STATIC void     GLRenderer::DisposeTexture(Texture* texture) {
+    GL_FlushSpriteBatch(GL_BatchFlush_State);
+
     GL_TextureData* textureData = (GL_TextureData*)texture->DriverData;
     if (!textureData)
         return;
@@ -1353,6 +1595,8 @@ PUBLIC STATIC void     GLRenderer::DisposeTexture(Texture* texture) {
 
 // Viewport and view-related functions
 PUBLIC STATIC void     GLRenderer::SetRenderTarget(Texture* texture) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Target);
+
     if (texture == NULL) {
         glBindFramebuffer(GL_FRAMEBUFFER, DefaultFramebuffer); CHECK_GL();
 
@@ -1382,6 +1626,8 @@ PUBLIC STATIC void     GLRenderer::SetRenderTarget(Texture* texture) {
     }
 }
 PUBLIC STATIC void     GLRenderer::ReadFramebuffer(void* pixels, int width, int height) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Frame);
+
     glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
     if (Graphics::CurrentRenderTarget)
@@ -1403,6 +1649,8 @@ PUBLIC STATIC void     GLRenderer::UpdateWindowSize(int width, int height) {
     GLRenderer::UpdateViewport();
 }
 PUBLIC STATIC void     GLRenderer::UpdateViewport() {
+    GL_FlushSpriteBatch(GL_BatchFlush_Target);
+
     Viewport* vp = &Graphics::CurrentViewport;
     if (Graphics::CurrentRenderTarget) {
         glViewport(vp->X * RetinaScale, vp->Y * RetinaScale, vp->Width * RetinaScale, vp->Height * RetinaScale); CHECK_GL();
@@ -1417,6 +1665,8 @@ PUBLIC STATIC void     GLRenderer::UpdateViewport() {
     GLRenderer::UpdateProjectionMatrix();
 }
 PUBLIC STATIC void     GLRenderer::UpdateClipRect() {
+    GL_FlushSpriteBatch(GL_BatchFlush_Clip);
+
     ClipArea clip = Graphics::CurrentClip;
     if (Graphics::CurrentClip.Enabled) {
         Viewport view = Graphics::CurrentViewport;
@@ -1494,6 +1744,8 @@ PUBLIC STATIC void     GLRenderer::UseShader(void* shader) {
     }
 }
 PUBLIC STATIC void     GLRenderer::SetUniformF(int location, int count, float* values) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Shader);
+
     switch (count) {
         case 1: glUniform1f(location, values[0]); CHECK_GL(); break;
         case 2: glUniform2f(location, values[0], values[1]); CHECK_GL(); break;
@@ -1502,9 +1754,13 @@ PUBLIC STATIC void     GLRenderer::SetUniformF(int location, int count, float* v
     }
 }
 PUBLIC STATIC void     GLRenderer::SetUniformI(int location, int count, int* values) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Shader);
+
     glUniform1iv(location, count, values); CHECK_GL();
 }
 PUBLIC STATIC void     GLRenderer::SetUniformTexture(Texture* texture, int uniform_index, int slot) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Shader);
+
     GL_TextureData* textureData = (GL_TextureData*)texture->DriverData;
     glActiveTexture(GL_TEXTURE0 + slot); CHECK_GL();
     glUniform1i(uniform_index, slot); CHECK_GL();
@@ -1518,6 +1774,8 @@ PUBLIC STATIC void     GLRenderer::UpdateGlobalPalette() {
 
 // These guys
 PUBLIC STATIC void     GLRenderer::Clear() {
+    GL_FlushSpriteBatch(GL_BatchFlush_Frame);
+
     if (UseDepthTesting) {
         #ifdef GL_ES
         glClearDepthf(1.0f); CHECK_GL();
@@ -1531,7 +1789,27 @@ PUBLIC STATIC void     GLRenderer::Clear() {
     }
 }
 PUBLIC STATIC void     GLRenderer::Present() {
+    GL_FlushSpriteBatch(GL_BatchFlush_Frame);
+
 	SDL_GL_SwapWindow(Application::Window); CHECK_GL();
+
+    GL_BatchStatsLastFrame = GL_BatchStatsFrame;
+    memset(&GL_BatchStatsFrame, 0, sizeof(GL_BatchStatsFrame));
+
+#ifdef HAVE_GL_PERFSTATS
+    GLRenderer::PrintBatchStats();
+#endif
+}
+PUBLIC STATIC void     GLRenderer::PrintBatchStats() {
+    GL_BatchStats* stats = &GL_BatchStatsLastFrame;
+
+    Log::Print(Log::LOG_INFO, "Sprite batching (%s):", GL_UseSpriteBatching ? "enabled" : "disabled");
+    Log::Print(Log::LOG_INFO, "  - Draw calls: %u", stats->DrawCalls);
+    Log::Print(Log::LOG_INFO, "  - Quads: %u", stats->Quads);
+    for (int i = 0; i < GL_BatchFlush_MAX; i++) {
+        if (stats->Flushes[i])
+            Log::Print(Log::LOG_INFO, "  - Flushes (%s): %u", GL_BatchFlushNames[i], stats->Flushes[i]);
+    }
 }
 
 // Draw mode setting functions
@@ -1539,6 +1817,17 @@ PUBLIC STATIC void     GLRenderer::SetBlendColor(float r, float g, float b, floa
 
 }
 PUBLIC STATIC void     GLRenderer::SetBlendMode(int srcC, int dstC, int srcA, int dstA) {
+    if (GL_LastBlendFactors[0] == srcC && GL_LastBlendFactors[1] == dstC
+    &&  GL_LastBlendFactors[2] == srcA && GL_LastBlendFactors[3] == dstA)
+        return;
+
+    GL_FlushSpriteBatch(GL_BatchFlush_Blend);
+
+    GL_LastBlendFactors[0] = srcC;
+    GL_LastBlendFactors[1] = dstC;
+    GL_LastBlendFactors[2] = srcA;
+    GL_LastBlendFactors[3] = dstA;
+
     glBlendFuncSeparate(
         GL_GetBlendFactorFromHatchEnum(srcC), GL_GetBlendFactorFromHatchEnum(dstC),
         GL_GetBlendFactorFromHatchEnum(srcA), GL_GetBlendFactorFromHatchEnum(dstA)); CHECK_GL();
@@ -1600,6 +1889,8 @@ PUBLIC STATIC void     GLRenderer::StrokeRectangle(float x, float y, float w, fl
     StrokeLine(x + w, y, x + w, y + h);
 }
 PUBLIC STATIC void     GLRenderer::FillCircle(float x, float y, float rad) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Draw);
+
     #ifdef GL_SUPPORTS_SMOOTHING
         if (Graphics::SmoothFill) {
             glEnable(GL_POLYGON_SMOOTH); CHECK_GL();
@@ -1623,6 +1914,8 @@ PUBLIC STATIC void     GLRenderer::FillCircle(float x, float y, float rad) {
     #endif
 }
 PUBLIC STATIC void     GLRenderer::FillEllipse(float x, float y, float w, float h) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Draw);
+
     #ifdef GL_SUPPORTS_SMOOTHING
         if (Graphics::SmoothFill) {
             glEnable(GL_POLYGON_SMOOTH); CHECK_GL();
@@ -1646,6 +1939,8 @@ PUBLIC STATIC void     GLRenderer::FillEllipse(float x, float y, float w, float
     #endif
 }
 PUBLIC STATIC void     GLRenderer::FillTriangle(float x1, float y1, float x2, float y2, float x3, float y3) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Draw);
+
     #ifdef GL_SUPPORTS_SMOOTHING
         if (Graphics::SmoothFill) {
             glEnable(GL_POLYGON_SMOOTH); CHECK_GL();
@@ -1669,6 +1964,8 @@ PUBLIC STATIC void     GLRenderer::FillTriangle(float x1, float y1, float x2, fl
     #endif
 }
 PUBLIC STATIC void     GLRenderer::FillRectangle(float x, float y, float w, float h) {
+    GL_FlushSpriteBatch(GL_BatchFlush_Draw);
+
     #ifdef GL_SUPPORTS_SMOOTHING
         if (Graphics::SmoothFill) {
             glEnable(GL_POLYGON_SMOOTH); CHECK_GL();
@@ -1729,7 +2026,7 @@ PUBLIC STATIC void     GLRenderer::DrawSprite(ISprite* sprite, int animation, in
     Graphics::Save();
         // Graphics::Rotate(0.0f, 0.0f, rotation);
         Graphics::Translate(x, y, 0.0f);
-        GL_DrawTextureBuffered(sprite->Spritesheets[animframe.SheetNumber], animframe.ID, ((int)flipY << 1) | (int)flipX);
+        GL_DrawSpriteFrame(sprite->Spritesheets[animframe.SheetNumber], &animframe, flipX, flipY);
     Graphics::Restore();
     //*/
 
@@ -2099,6 +2396,8 @@ PUBLIC STATIC void     GLRenderer::DeleteFrameBufferID(AnimFrame* frame) {
     }
 }
 PUBLIC STATIC void     GLRenderer::SetDepthTesting(bool enable) {
+    GL_FlushSpriteBatch(GL_BatchFlush_State);
+
     if (UseDepthTesting) {
         if (enable) {
             glEnable(GL_DEPTH_TEST); CHECK_GL();
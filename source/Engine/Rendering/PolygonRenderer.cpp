@@ -42,6 +42,62 @@ PUBLIC STATIC int PolygonRenderer::FaceSortFunction(const void *a, const void *b
     return faceB->Depth - faceA->Depth;
 }
 
+// Faces are sorted back to front (or front to back) with an LSD radix sort
+// on their depth, eight bits per pass. Passes where every face has the same digit are
+// skipped, which in practice leaves only two or three of them.
+struct FaceSortEntry {
+    Uint32 Key;
+    Uint32 Index;
+};
+
+static vector<FaceSortEntry> FaceSortEntries;
+static vector<FaceSortEntry> FaceSortScratch;
+static vector<FaceInfo>      FaceSortFaces;
+
+PUBLIC STATIC void PolygonRenderer::SortFaces(FaceInfo* faces, Uint32 count, bool frontToBack) {
+    if (count < 2)
+        return;
+
+    FaceSortEntries.resize(count);
+    FaceSortScratch.resize(count);
+
+    // Flipping the sign bit makes the keys sort like the signed depths,
+    // and inverting them puts the farthest face first.
+    Uint32 invert = frontToBack ? 0 : 0xFFFFFFFFU;
+    FaceSortEntry* entries = FaceSortEntries.data();
+    FaceSortEntry* scratch = FaceSortScratch.data();
+    for (Uint32 i = 0; i < count; i++) {
+        entries[i].Key = ((Uint32)faces[i].Depth ^ 0x80000000U) ^ invert;
+        entries[i].Index = i;
+    }
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        Uint32 offsets[256] = { 0 };
+        for (Uint32 i = 0; i < count; i++)
+            offsets[(entries[i].Key >> shift) & 0xFF]++;
+        if (offsets[(entries[0].Key >> shift) & 0xFF] == count)
+            continue;
+
+        Uint32 total = 0;
+        for (int d = 0; d < 256; d++) {
+            Uint32 digitCount = offsets[d];
+            offsets[d] = total;
+            total += digitCount;
+        }
+        for (Uint32 i = 0; i < count; i++)
+            scratch[offsets[(entries[i].Key >> shift) & 0xFF]++] = entries[i];
+
+        FaceSortEntry* temp = entries;
+        entries = scratch;
+        scratch = temp;
+    }
+
+    FaceSortFaces.resize(count);
+    for (Uint32 i = 0; i < count; i++)
+        FaceSortFaces[i] = faces[entries[i].Index];
+    memcpy(faces, FaceSortFaces.data(), count * sizeof(FaceInfo));
+}
+
 PUBLIC void PolygonRenderer::BuildFrustumPlanes(float nearClippingPlane, float farClippingPlane) {
     // Near
     ViewFrustum[0].Plane.Z = nearClippingPlane * 0x10000;
@@ -10,7 +10,14 @@ public:
     static size_t  DepthBufferSize;
     static Uint32* DepthBuffer;
 
+    static size_t  DepthTileCount;
+    static Uint32* DepthTileMax;
+    static Uint8*  DepthTileDirty;
+    static int     DepthTilesWidth;
+    static int     DepthTilesHeight;
+
     static bool    UseDepthBuffer;
+    static int     PerspectiveSubdivision;
 
     static bool    UseFog;
     static float   FogStart;
@@ -32,7 +39,14 @@ bool    PolygonRasterizer::DepthTest = false;
 size_t  PolygonRasterizer::DepthBufferSize = 0;
 Uint32* PolygonRasterizer::DepthBuffer = NULL;
 
+size_t  PolygonRasterizer::DepthTileCount = 0;
+Uint32* PolygonRasterizer::DepthTileMax = NULL;
+Uint8*  PolygonRasterizer::DepthTileDirty = NULL;
+int     PolygonRasterizer::DepthTilesWidth = 0;
+int     PolygonRasterizer::DepthTilesHeight = 0;
+
 bool    PolygonRasterizer::UseDepthBuffer = false;
+int     PolygonRasterizer::PerspectiveSubdivision = 0;
 
 bool    PolygonRasterizer::UseFog = false;
 float   PolygonRasterizer::FogStart = 0.0f;
@@ -47,6 +61,12 @@ Uint16  PolygonRasterizer::FogTable[0x100 + 1];
 #define DEPTH_READ_U32(depth)  (depth < PolygonRasterizer::DepthBuffer[dst_x + dst_strideY])
 #define DEPTH_WRITE_U32(depth) PolygonRasterizer::DepthBuffer[dst_x + dst_strideY] = depth
 
+// The depth buffer is split into tiles of this many pixels on each side,
+// and the farthest depth in each is kept so hidden polygons and spans can
+// be skipped without testing every pixel.
+#define DEPTH_TILE_SHIFT 3
+#define DEPTH_TILE_SIZE (1 << DEPTH_TILE_SHIFT)
+
 #define CLAMP_VAL(v, a, b) if (v < a) v = a; else if (v > b) v = b
 
 int FogEquationFunc_Linear(float coord) {
@@ -169,6 +189,10 @@ Uint32 DoColorTint(Uint32 color, Uint32 colorMult) {
 #define SCANLINE_GET_TEXUV() \
     int texU = ((int)((mapU + 1) * texture->Width) >> 16) % texture->Width; \
     int texV = ((int)((mapV + 1) * texture->Height) >> 16) % texture->Height
+// Same as SCANLINE_GET_TEXUV, for coordinates already in 16.16 texels
+#define SCANLINE_GET_TEXUV_FIXED(u, v) \
+    int texU = ((u + (int)texture->Width) >> 16) % texture->Width; \
+    int texV = ((v + (int)texture->Height) >> 16) % texture->Height
 #define SCANLINE_GET_COLOR() \
     CLAMP_VAL(colR, 0x00, 0xFF0000); \
     CLAMP_VAL(colG, 0x00, 0xFF0000); \
@@ -209,6 +233,145 @@ static void GetPolygonBounds(T* positions, int count, int& minVal, int& maxVal)
     if (dst_y2 < 0 || dst_y1 >= dst_y2) \
         return
 
+// Skips the rest of the row if everything under the span is already nearer
+#define SCANLINE_DEPTH_REJECT() \
+    if (UseDepthBuffer && IsSpanOccluded(dst_y, &contour)) { \
+        dst_strideY += dstStride; \
+        continue; \
+    }
+
+// Hierarchical depth
+// Depth values only ever get nearer as polygons are drawn, so a tile's
+// stored maximum stays a safe upper bound even when it's out of date.
+// Tiles that were drawn to are marked dirty, and their maximum is only
+// recomputed the next time something is tested against them.
+PRIVATE STATIC Uint32 PolygonRasterizer::GetDepthTileMax(int tileX, int tileY) {
+    size_t tile = tileX + tileY * DepthTilesWidth;
+    if (DepthTileDirty[tile]) {
+        int width = (int)Graphics::CurrentRenderTarget->Width;
+        int height = (int)Graphics::CurrentRenderTarget->Height;
+        int x1 = tileX << DEPTH_TILE_SHIFT;
+        int y1 = tileY << DEPTH_TILE_SHIFT;
+        int x2 = x1 + DEPTH_TILE_SIZE;
+        int y2 = y1 + DEPTH_TILE_SIZE;
+        if (x2 > width)
+            x2 = width;
+        if (y2 > height)
+            y2 = height;
+
+        Uint32 maxDepth = 0;
+        for (int y = y1; y < y2; y++) {
+            Uint32* depth = &DepthBuffer[x1 + y * width];
+            for (int x = x1; x < x2; x++, depth++) {
+                if (maxDepth < *depth)
+                    maxDepth = *depth;
+            }
+        }
+
+        DepthTileMax[tile] = maxDepth;
+        DepthTileDirty[tile] = 0;
+    }
+    return DepthTileMax[tile];
+}
+// Returns true if every pixel in the given area is nearer than depth.
+PRIVATE STATIC bool   PolygonRasterizer::IsAreaOccluded(int x1, int y1, int x2, int y2, Uint32 depth) {
+    int width = (int)Graphics::CurrentRenderTarget->Width;
+    int height = (int)Graphics::CurrentRenderTarget->Height;
+    if (x1 < 0)
+        x1 = 0;
+    if (y1 < 0)
+        y1 = 0;
+    if (x2 > width)
+        x2 = width;
+    if (y2 > height)
+        y2 = height;
+    if (x1 >= x2 || y1 >= y2)
+        return false;
+
+    int tileX1 = x1 >> DEPTH_TILE_SHIFT;
+    int tileY1 = y1 >> DEPTH_TILE_SHIFT;
+    int tileX2 = (x2 - 1) >> DEPTH_TILE_SHIFT;
+    int tileY2 = (y2 - 1) >> DEPTH_TILE_SHIFT;
+    for (int tileY = tileY1; tileY <= tileY2; tileY++) {
+        for (int tileX = tileX1; tileX <= tileX2; tileX++) {
+            if (GetDepthTileMax(tileX, tileY) > depth)
+                return false;
+        }
+    }
+    return true;
+}
+PRIVATE STATIC void   PolygonRasterizer::GetPolygonArea(Vector3* positions, int count, int* x1, int* x2, Uint32* nearest) {
+    int minX = INT_MAX;
+    int maxX = INT_MIN;
+    int minZ = INT_MAX;
+    for (int i = 0; i < count; i++) {
+        int x = positions[i].X >> 16;
+        int z = positions[i].Z >> 16;
+        if (minX > x)
+            minX = x;
+        if (maxX < x)
+            maxX = x;
+        if (minZ > z)
+            minZ = z;
+    }
+
+    *x1 = minX;
+    *x2 = maxX + 1;
+
+    // Pixel depths are interpolated in floating point, so leave room for
+    // them landing slightly nearer than the nearest vertex.
+    minZ--;
+    if (minZ < 0)
+        minZ = 0;
+    *nearest = (Uint32)minZ << 16;
+}
+PRIVATE STATIC bool   PolygonRasterizer::IsPolygonOccluded(Vector3* positions, int count, int y1, int y2) {
+    int x1, x2;
+    Uint32 nearest;
+    GetPolygonArea(positions, count, &x1, &x2, &nearest);
+    return IsAreaOccluded(x1, y1, x2, y2 + 1, nearest);
+}
+PRIVATE STATIC bool   PolygonRasterizer::IsSpanOccluded(int y, Contour* contour) {
+    // The span is nearest at whichever end has the largest 1/z
+    float invZ = contour->MinZ;
+    if (invZ < contour->MaxZ)
+        invZ = contour->MaxZ;
+    if (invZ <= 0.0f)
+        return false;
+
+    float nearest = (1.0f / invZ) - 1.0f;
+    if (nearest <= 0.0f)
+        return false;
+
+    return IsAreaOccluded(contour->MinX, y, contour->MaxX, y + 1, (Uint32)(nearest * 65536));
+}
+PRIVATE STATIC void   PolygonRasterizer::MarkPolygonDrawn(Vector3* positions, int count, int y1, int y2) {
+    int width = (int)Graphics::CurrentRenderTarget->Width;
+    int height = (int)Graphics::CurrentRenderTarget->Height;
+
+    int x1, x2;
+    Uint32 nearest;
+    GetPolygonArea(positions, count, &x1, &x2, &nearest);
+    y2++;
+    if (x1 < 0)
+        x1 = 0;
+    if (y1 < 0)
+        y1 = 0;
+    if (x2 > width)
+        x2 = width;
+    if (y2 > height)
+        y2 = height;
+    if (x1 >= x2 || y1 >= y2)
+        return;
+
+    int tileX1 = x1 >> DEPTH_TILE_SHIFT;
+    int tileY1 = y1 >> DEPTH_TILE_SHIFT;
+    int tileX2 = (x2 - 1) >> DEPTH_TILE_SHIFT;
+    int tileY2 = (y2 - 1) >> DEPTH_TILE_SHIFT;
+    for (int tileY = tileY1; tileY <= tileY2; tileY++)
+        memset(&DepthTileDirty[tileX1 + tileY * DepthTilesWidth], 1, tileX2 - tileX1 + 1);
+}
+
 // Draws a polygon
 PUBLIC STATIC void PolygonRasterizer::DrawBasic(Vector2* positions, Uint32 color, int count, BlendState blendState) {
     Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
@@ -543,6 +706,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawAffine(Texture* texture, Vector3* posi
     GetPolygonBounds<Vector3>(positions, count, dst_y1, dst_y2);
     CLIP_BOUNDS();
 
+    if (UseDepthBuffer && IsPolygonOccluded(positions, count, dst_y1, dst_y2))
+        return;
+
     Scanline::Prepare(dst_y1, dst_y2);
 
     Vector3* lastVector = positions;
@@ -610,6 +776,7 @@ PUBLIC STATIC void PolygonRasterizer::DrawAffine(Texture* texture, Vector3* posi
             dst_strideY += dstStride; \
             continue; \
         } \
+        SCANLINE_DEPTH_REJECT(); \
         SCANLINE_INIT_Z(); \
         SCANLINE_INIT_UV(); \
         if (contour.MinX < min_x) { \
@@ -647,6 +814,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawAffine(Texture* texture, Vector3* posi
 
     POLYGON_SCANLINE_DEPTH(DRAW_POLYGONAFFINE);
 
+    if (UseDepthBuffer)
+        MarkPolygonDrawn(positions, count, dst_y1, dst_y2);
+
     #undef DRAW_PLACEPIXEL
     #undef DRAW_PLACEPIXEL_PAL
     #undef DRAW_PLACEPIXEL_FOG
@@ -673,6 +843,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendAffine(Texture* texture, Vector3*
     GetPolygonBounds<Vector3>(positions, count, dst_y1, dst_y2);
     CLIP_BOUNDS();
 
+    if (UseDepthBuffer && IsPolygonOccluded(positions, count, dst_y1, dst_y2))
+        return;
+
     Scanline::Prepare(dst_y1, dst_y2);
 
     int*     lastColor = colors;
@@ -746,6 +919,7 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendAffine(Texture* texture, Vector3*
             dst_strideY += dstStride; \
             continue; \
         } \
+        SCANLINE_DEPTH_REJECT(); \
         SCANLINE_INIT_Z(); \
         SCANLINE_INIT_UV(); \
         SCANLINE_INIT_RGB(); \
@@ -787,6 +961,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendAffine(Texture* texture, Vector3*
 
     POLYGON_SCANLINE_DEPTH(DRAW_POLYGONBLENDAFFINE);
 
+    if (UseDepthBuffer)
+        MarkPolygonDrawn(positions, count, dst_y1, dst_y2);
+
     #undef DRAW_PLACEPIXEL
     #undef DRAW_PLACEPIXEL_PAL
     #undef DRAW_PLACEPIXEL_FOG
@@ -795,24 +972,27 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendAffine(Texture* texture, Vector3*
     #undef BLENDFLAGS
 }
 // Draws a perspective-correct texture mapped polygon
-#ifdef SCANLINE_DIVISION
-#define PERSP_MAPPER_SUBDIVIDE(width, placePixelMacro, dpR, dpW) \
+// Dividing by Z is the expensive part of perspective mapping, so with a
+// subdivision draw mode, the texture coordinates are only computed exactly
+// at every PerspectiveSubdivision pixels of a span. In between, they are
+// stepped linearly in 16.16 fixed point texels.
+#define PERSP_MAPPER_SUBDIVIDE(width, invWidth, placePixelMacro, dpR, dpW) \
     contZ += dxZ * width; \
     contU += dxU * width; \
     contV += dxV * width; \
     endZ = 1.0f / contZ; \
-    endU = contU * endZ; \
-    endV = contV * endZ; \
-    stepZ = (endZ - startZ) * invContSize; \
-    stepU = (endU - startU) * invContSize; \
-    stepV = (endV - startV) * invContSize; \
+    endU = (int)(contU * endZ * texture->Width); \
+    endV = (int)(contV * endZ * texture->Height); \
+    stepZ = (endZ - startZ) * invWidth; \
+    stepU = (int)((endU - startU) * invWidth); \
+    stepV = (int)((endV - startV) * invWidth); \
     mapZ = startZ; \
     currU = startU; \
     currV = startV; \
     for (int i = 0; i < width; i++) { \
-        Uint32 iz = mapZ * 65536; \
+        SCANLINE_GET_INVZ(); \
         if (dpR(iz)) { \
-            DRAW_PERSP_GET(currU, currV); \
+            DRAW_PERSP_GET_FIXED(currU, currV); \
             placePixelMacro(dpW); \
         } \
         DRAW_PERSP_STEP(); \
@@ -821,51 +1001,45 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendAffine(Texture* texture, Vector3*
         currV += stepV; \
         dst_x++; \
     }
-#define DO_PERSP_MAPPING(placePixelMacro, dpR, dpW) { \
+#define DO_PERSP_MAPPING_SUBDIVIDED(placePixelMacro, dpR, dpW) { \
     int dst_x = contour.MinX; \
     int contWidth = contour.MaxX - contour.MinX; \
-    int contSize = 16; \
+    int contSize = PerspectiveSubdivision; \
     float invContSize = 1.0f / contSize; \
     float startZ = 1.0f / contZ; \
-    float startU = contU * startZ; \
-    float startV = contV * startZ; \
-    float endZ, endU, endV; \
-    float stepZ, stepU, stepV; \
-    float mapZ, currU, currV; \
+    int startU = (int)(contU * startZ * texture->Width); \
+    int startV = (int)(contV * startZ * texture->Height); \
+    float endZ, stepZ, mapZ; \
+    int endU, endV, stepU, stepV, currU, currV; \
     while (contWidth >= contSize) { \
-        PERSP_MAPPER_SUBDIVIDE(contSize, placePixelMacro, dpR, dpW); \
+        PERSP_MAPPER_SUBDIVIDE(contSize, invContSize, placePixelMacro, dpR, dpW); \
         startU = endU; \
         startV = endV; \
         startZ = endZ; \
         contWidth -= contSize; \
     } \
     if (contWidth > 0) { \
-        if (contWidth > 1) { \
-            PERSP_MAPPER_SUBDIVIDE(contWidth, placePixelMacro, dpR, dpW); \
-        } \
-        else { \
-            Uint32 iz = startZ * 65536; \
-            if (dpR(iz)) { \
-                DRAW_PERSP_GET(startU, startV); \
-                placePixelMacro(dpW); \
-            } \
-        } \
+        float invContWidth = 1.0f / contWidth; \
+        PERSP_MAPPER_SUBDIVIDE(contWidth, invContWidth, placePixelMacro, dpR, dpW); \
     } \
 }
-#else
 #define DO_PERSP_MAPPING(placePixelMacro, dpR, dpW) \
-    for (int dst_x = contour.MinX; dst_x < contour.MaxX; dst_x++) { \
-        SCANLINE_GET_MAPZ(); \
-        SCANLINE_GET_INVZ(); \
-        if (dpR(iz)) { \
-            DRAW_PERSP_GET(contU * mapZ, contV * mapZ); \
-            placePixelMacro(dpW); \
+    if (PerspectiveSubdivision > 1) { \
+        DO_PERSP_MAPPING_SUBDIVIDED(placePixelMacro, dpR, dpW); \
+    } \
+    else { \
+        for (int dst_x = contour.MinX; dst_x < contour.MaxX; dst_x++) { \
+            SCANLINE_GET_MAPZ(); \
+            SCANLINE_GET_INVZ(); \
+            if (dpR(iz)) { \
+                DRAW_PERSP_GET(contU * mapZ, contV * mapZ); \
+                placePixelMacro(dpW); \
+            } \
+            SCANLINE_STEP_Z(); \
+            SCANLINE_STEP_UV(); \
+            DRAW_PERSP_STEP(); \
         } \
-        SCANLINE_STEP_Z(); \
-        SCANLINE_STEP_UV(); \
-        DRAW_PERSP_STEP(); \
     }
-#endif
 PUBLIC STATIC void PolygonRasterizer::DrawPerspective(Texture* texture, Vector3* positions, Vector2* uvs, Uint32 color, int count, BlendState blendState) {
     Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
     Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
@@ -885,6 +1059,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawPerspective(Texture* texture, Vector3*
     GetPolygonBounds<Vector3>(positions, count, dst_y1, dst_y2);
     CLIP_BOUNDS();
 
+    if (UseDepthBuffer && IsPolygonOccluded(positions, count, dst_y1, dst_y2))
+        return;
+
     Scanline::Prepare(dst_y1, dst_y2);
 
     Vector3* lastVector = positions;
@@ -940,6 +1117,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawPerspective(Texture* texture, Vector3*
         float mapV = v; \
         SCANLINE_GET_TEXUV()
 
+    #define DRAW_PERSP_GET_FIXED(u, v) \
+        SCANLINE_GET_TEXUV_FIXED(u, v)
+
     #define DRAW_PERSP_STEP()
 
     #define DRAW_POLYGONPERSP(placePixelMacro, dpR, dpW) for (int dst_y = dst_y1; dst_y < dst_y2; dst_y++) { \
@@ -949,6 +1129,7 @@ PUBLIC STATIC void PolygonRasterizer::DrawPerspective(Texture* texture, Vector3*
             dst_strideY += dstStride; \
             continue; \
         } \
+        SCANLINE_DEPTH_REJECT(); \
         SCANLINE_INIT_Z(); \
         SCANLINE_INIT_UV(); \
         if (contour.MapLeft < contour.MinX) { \
@@ -973,11 +1154,15 @@ PUBLIC STATIC void PolygonRasterizer::DrawPerspective(Texture* texture, Vector3*
 
     POLYGON_SCANLINE_DEPTH(DRAW_POLYGONPERSP);
 
+    if (UseDepthBuffer)
+        MarkPolygonDrawn(positions, count, dst_y1, dst_y2);
+
     #undef DRAW_PLACEPIXEL
     #undef DRAW_PLACEPIXEL_PAL
     #undef DRAW_PLACEPIXEL_FOG
     #undef DRAW_PLACEPIXEL_PAL_FOG
     #undef DRAW_PERSP_GET
+    #undef DRAW_PERSP_GET_FIXED
     #undef DRAW_PERSP_STEP
     #undef DRAW_POLYGONPERSP
 }
@@ -1001,6 +1186,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendPerspective(Texture* texture, Vec
     GetPolygonBounds<Vector3>(positions, count, dst_y1, dst_y2);
     CLIP_BOUNDS();
 
+    if (UseDepthBuffer && IsPolygonOccluded(positions, count, dst_y1, dst_y2))
+        return;
+
     Scanline::Prepare(dst_y1, dst_y2);
 
     int*     lastColor = colors;
@@ -1063,6 +1251,10 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendPerspective(Texture* texture, Vec
         SCANLINE_GET_RGB_PERSP(); \
         SCANLINE_GET_TEXUV()
 
+    #define DRAW_PERSP_GET_FIXED(u, v) \
+        SCANLINE_GET_RGB_PERSP(); \
+        SCANLINE_GET_TEXUV_FIXED(u, v)
+
     #define DRAW_PERSP_STEP() SCANLINE_STEP_RGB()
 
     #define DRAW_POLYGONBLENDPERSP(placePixelMacro, dpR, dpW) for (int dst_y = dst_y1; dst_y < dst_y2; dst_y++) { \
@@ -1072,6 +1264,7 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendPerspective(Texture* texture, Vec
             dst_strideY += dstStride; \
             continue; \
         } \
+        SCANLINE_DEPTH_REJECT(); \
         SCANLINE_INIT_Z(); \
         SCANLINE_INIT_RGB(); \
         SCANLINE_INIT_UV(); \
@@ -1098,11 +1291,15 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendPerspective(Texture* texture, Vec
 
     POLYGON_SCANLINE_DEPTH(DRAW_POLYGONBLENDPERSP);
 
+    if (UseDepthBuffer)
+        MarkPolygonDrawn(positions, count, dst_y1, dst_y2);
+
     #undef DRAW_PLACEPIXEL
     #undef DRAW_PLACEPIXEL_PAL
     #undef DRAW_PLACEPIXEL_FOG
     #undef DRAW_PLACEPIXEL_PAL_FOG
     #undef DRAW_PERSP_GET
+    #undef DRAW_PERSP_GET_FIXED
     #undef DRAW_PERSP_STEP
     #undef DRAW_POLYGONBLENDPERSP
 }
@@ -1124,6 +1321,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawDepth(Vector3* positions, Uint32 color
     GetPolygonBounds<Vector3>(positions, count, dst_y1, dst_y2);
     CLIP_BOUNDS();
 
+    if (UseDepthBuffer && IsPolygonOccluded(positions, count, dst_y1, dst_y2))
+        return;
+
     Scanline::Prepare(dst_y1, dst_y2);
 
     Vector3* lastVector = positions;
@@ -1166,6 +1366,7 @@ PUBLIC STATIC void PolygonRasterizer::DrawDepth(Vector3* positions, Uint32 color
             dst_strideY += dstStride; \
             continue; \
         } \
+        SCANLINE_DEPTH_REJECT(); \
         SCANLINE_INIT_Z(); \
         if (contour.MapLeft < contour.MinX) { \
             SCANLINE_STEP_Z_BY(contour.MinX - contour.MapLeft); \
@@ -1192,6 +1393,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawDepth(Vector3* positions, Uint32 color
         POLYGON_BLENDFLAGS_SOLID(DRAW_POLYGONDEPTH, PX_GET);
     }
 
+    if (UseDepthBuffer)
+        MarkPolygonDrawn(positions, count, dst_y1, dst_y2);
+
     #undef PX_GET
     #undef PX_GET_FOG
 
@@ -1215,6 +1419,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendDepth(Vector3* positions, int* co
     GetPolygonBounds<Vector3>(positions, count, dst_y1, dst_y2);
     CLIP_BOUNDS();
 
+    if (UseDepthBuffer && IsPolygonOccluded(positions, count, dst_y1, dst_y2))
+        return;
+
     Scanline::Prepare(dst_y1, dst_y2);
 
     int* lastColor = colors;
@@ -1262,6 +1469,7 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendDepth(Vector3* positions, int* co
             dst_strideY += dstStride; \
             continue; \
         } \
+        SCANLINE_DEPTH_REJECT(); \
         SCANLINE_INIT_Z(); \
         SCANLINE_INIT_RGB(); \
         if (contour.MapLeft < contour.MinX) { \
@@ -1292,6 +1500,9 @@ PUBLIC STATIC void PolygonRasterizer::DrawBlendDepth(Vector3* positions, int* co
         POLYGON_BLENDFLAGS_SOLID(DRAW_POLYGONBLENDDEPTH, PX_GET);
     }
 
+    if (UseDepthBuffer)
+        MarkPolygonDrawn(positions, count, dst_y1, dst_y2);
+
     #undef PX_GET
     #undef PX_GET_FOG
 
@@ -1310,16 +1521,38 @@ PUBLIC STATIC void     PolygonRasterizer::SetDepthTest(bool enabled) {
     }
 
     memset(DepthBuffer, 0xFF, dpSize * sizeof(*DepthBuffer));
+
+    DepthTilesWidth = (Graphics::CurrentRenderTarget->Width + DEPTH_TILE_SIZE - 1) >> DEPTH_TILE_SHIFT;
+    DepthTilesHeight = (Graphics::CurrentRenderTarget->Height + DEPTH_TILE_SIZE - 1) >> DEPTH_TILE_SHIFT;
+
+    size_t tileCount = DepthTilesWidth * DepthTilesHeight;
+    if (DepthTileMax == NULL || tileCount > DepthTileCount) {
+        DepthTileCount = tileCount;
+        DepthTileMax = (Uint32*)Memory::Realloc(DepthTileMax, DepthTileCount * sizeof(*DepthTileMax));
+        DepthTileDirty = (Uint8*)Memory::Realloc(DepthTileDirty, DepthTileCount * sizeof(*DepthTileDirty));
+    }
+
+    memset(DepthTileMax, 0xFF, tileCount * sizeof(*DepthTileMax));
+    memset(DepthTileDirty, 0, tileCount * sizeof(*DepthTileDirty));
 }
 PUBLIC STATIC void     PolygonRasterizer::FreeDepthBuffer(void) {
     Memory::Free(DepthBuffer);
     DepthBuffer = NULL;
+    Memory::Free(DepthTileMax);
+    DepthTileMax = NULL;
+    Memory::Free(DepthTileDirty);
+    DepthTileDirty = NULL;
+    DepthTileCount = 0;
 }
 
 PUBLIC STATIC void     PolygonRasterizer::SetUseDepthBuffer(bool enabled) {
     UseDepthBuffer = enabled;
 }
 
+PUBLIC STATIC void     PolygonRasterizer::SetPerspectiveSubdivision(int pixels) {
+    PerspectiveSubdivision = pixels;
+}
+
 PUBLIC STATIC void     PolygonRasterizer::SetUseFog(bool enabled) {
     UseFog = enabled;
 }
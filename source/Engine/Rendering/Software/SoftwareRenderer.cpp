@@ -14,20 +14,21 @@
 
 class SoftwareRenderer {
 public:
-    static GraphicsFunctions BackendFunctions;
-    static Uint32            CompareColor;
-    static TileScanLine      TileScanLineBuffer[MAX_FRAMEBUFFER_HEIGHT];
-    static Sint32            SpriteDeformBuffer[MAX_FRAMEBUFFER_HEIGHT];
-    static bool              UseSpriteDeform;
-    static Contour           ContourBuffer[MAX_FRAMEBUFFER_HEIGHT];
-    static int               MultTable[0x10000];
-    static int               MultTableInv[0x10000];
-    static int               MultSubTable[0x10000];
+    static GraphicsFunctions   BackendFunctions;
+    static thread_local Uint32 CompareColor;
+    static TileScanLine        TileScanLineBuffer[MAX_FRAMEBUFFER_HEIGHT];
+    static Sint32              SpriteDeformBuffer[MAX_FRAMEBUFFER_HEIGHT];
+    static thread_local bool   UseSpriteDeform;
+    static Contour             ContourBuffer[MAX_FRAMEBUFFER_HEIGHT];
+    static int                 MultTable[0x10000];
+    static int                 MultTableInv[0x10000];
+    static int                 MultSubTable[0x10000];
 };
 #endif
 
 #include <Engine/Rendering/Software/SoftwareRenderer.h>
 #include <Engine/Rendering/Software/PolygonRasterizer.h>
+#include <Engine/Rendering/Software/TileLayerCache.h>
 #include <Engine/Rendering/Software/SoftwareEnums.h>
 #include <Engine/Rendering/FaceInfo.h>
 #include <Engine/Rendering/Scene3D.h>
@@ -41,17 +42,35 @@ public:
 #include <Engine/Bytecode/Types.h>
 #include <Engine/Bytecode/ScriptManager.h>
 
-GraphicsFunctions SoftwareRenderer::BackendFunctions;
-Uint32            SoftwareRenderer::CompareColor = 0xFF000000U;
-TileScanLine      SoftwareRenderer::TileScanLineBuffer[MAX_FRAMEBUFFER_HEIGHT];
-Sint32            SoftwareRenderer::SpriteDeformBuffer[MAX_FRAMEBUFFER_HEIGHT];
-bool              SoftwareRenderer::UseSpriteDeform = false;
-Contour           SoftwareRenderer::ContourBuffer[MAX_FRAMEBUFFER_HEIGHT];
-int               SoftwareRenderer::MultTable[0x10000];
-int               SoftwareRenderer::MultTableInv[0x10000];
-int               SoftwareRenderer::MultSubTable[0x10000];
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define SOFTWARE_SIMD_SSE2
+    #include <emmintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+    // 32-bit x86 builds don't assume SSE2, so only the blending functions
+    // are built for it, and only used if the CPU has it.
+    #if defined(__GNUC__) && !defined(__SSE2__)
+        #define SSE2_TARGET __attribute__((target("sse2")))
+    #else
+        #define SSE2_TARGET
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define SOFTWARE_SIMD_NEON
+    #include <arm_neon.h>
+#endif
+
+GraphicsFunctions   SoftwareRenderer::BackendFunctions;
+thread_local Uint32 SoftwareRenderer::CompareColor = 0xFF000000U;
+TileScanLine        SoftwareRenderer::TileScanLineBuffer[MAX_FRAMEBUFFER_HEIGHT];
+Sint32              SoftwareRenderer::SpriteDeformBuffer[MAX_FRAMEBUFFER_HEIGHT];
+thread_local bool   SoftwareRenderer::UseSpriteDeform = false;
+Contour             SoftwareRenderer::ContourBuffer[MAX_FRAMEBUFFER_HEIGHT];
+int                 SoftwareRenderer::MultTable[0x10000];
+int                 SoftwareRenderer::MultTableInv[0x10000];
+int                 SoftwareRenderer::MultSubTable[0x10000];
 
-BlendState CurrentBlendState;
+thread_local BlendState CurrentBlendState;
 
 #if 0
 Uint32 ColorAdd(Uint32 color1, Uint32 color2, int percent) {
@@ -81,21 +100,88 @@ Uint8 ColG;
 Uint8 ColB;
 Uint32 ColRGB;
 
-PixelFunction CurrentPixelFunction = NULL;
-TintFunction CurrentTintFunction = NULL;
+thread_local PixelFunction CurrentPixelFunction = NULL;
+thread_local TintFunction CurrentTintFunction = NULL;
 
-bool UseStencil = false;
+thread_local bool UseStencil = false;
+bool UseSIMD = false;
+bool SortOpaqueFaces = false;
 
-Uint8 StencilValue = 0x00;
-Uint8 StencilMask = 0xFF;
+thread_local Uint8 StencilValue = 0x00;
+thread_local Uint8 StencilMask = 0xFF;
 
 size_t StencilBufferSize = 0;
 
-Uint8 DotMaskH = 0;
-Uint8 DotMaskV = 0;
+thread_local Uint8 DotMaskH = 0;
+thread_local Uint8 DotMaskV = 0;
+
+thread_local int DotMaskOffsetH = 0;
+thread_local int DotMaskOffsetV = 0;
+
+// Multithreaded drawing
+#define MAX_DRAW_THREADS 16
+
+enum {
+    DrawCommand_SpriteImage,
+    DrawCommand_SpriteImageTransformed,
+    DrawCommand_Rectangle,
+    DrawCommand_SceneLayer
+};
+
+// The state a recorded draw call was made in
+struct DrawCommandState {
+    BlendState          Blend;
+    ClipArea            Clip;
+    bool                TextureBlend;
+    bool                UsePalettes;
+    bool                UseStencil;
+    Uint8               StencilValue;
+    Uint8               StencilMask;
+    StencilTestFunction StencilTest;
+    StencilOpFunction   StencilPass;
+    StencilOpFunction   StencilFail;
+    Uint8               DotMaskH;
+    Uint8               DotMaskV;
+    int                 DotMaskOffsetH;
+    int                 DotMaskOffsetV;
+    Uint32              CompareColor;
+    Texture*            Target;
+    View*               TargetView;
+};
+
+struct DrawCommand {
+    int         Type;
+    size_t      State;
+    Texture*    Source;
+    SceneLayer* Layer;
+    View*       LayerView;
+    BlendState  Blend;
+    int         Args[12];
+};
 
-int DotMaskOffsetH = 0;
-int DotMaskOffsetV = 0;
+static vector<DrawCommand>      DrawCommands;
+static vector<DrawCommandState> DrawCommandStates;
+static bool                     RecordingCommands = false;
+
+static int                      DrawThreadCount = 0;
+static bool                     DrawThreadsStarted = false;
+static bool                     DrawThreadsQuit = false;
+static SDL_Thread*              DrawThreads[MAX_DRAW_THREADS];
+static SDL_sem*                 DrawThreadStart[MAX_DRAW_THREADS];
+static SDL_sem*                 DrawThreadDone = NULL;
+static void                     (*DrawThreadJob)(int index) = NULL;
+
+// With "pipelineFrames" set, the calls recorded at the end of a view are
+// drawn by the other threads while the main thread goes on to the next frame.
+static bool                     PipelineFrames = false;
+static bool                     FramePending = false;
+static Texture*                 PendingTarget = NULL;
+
+// While a thread replays recorded draw calls, this points to the state
+// they were made in, and the thread only draws between BandY1 and BandY2.
+thread_local DrawCommandState*  ReplayState = NULL;
+thread_local int                BandY1 = 0;
+thread_local int                BandY2 = MAX_FRAMEBUFFER_HEIGHT;
 
 #define TRIG_TABLE_BITS 11
 #define TRIG_TABLE_SIZE (1 << TRIG_TABLE_BITS)
@@ -118,6 +204,9 @@ PUBLIC STATIC void     SoftwareRenderer::Init() {
     UseStencil = false;
     UseSpriteDeform = false;
 
+    Application::Settings->GetBool("display", "softwareFrontToBack", &SortOpaqueFaces);
+    Application::Settings->GetBool("display", "pipelineFrames", &PipelineFrames);
+
     SetDotMask(0);
     SetDotMaskOffsetH(0);
     SetDotMaskOffsetV(0);
@@ -154,6 +243,8 @@ PUBLIC STATIC void     SoftwareRenderer::SetGraphicsFunctions() {
     CurrentBlendState.Opacity = 0xFF;
     CurrentBlendState.FilterTable = nullptr;
 
+    UseSIMD = SoftwareRenderer::DetectSIMD();
+
     SoftwareRenderer::BackendFunctions.Init = SoftwareRenderer::Init;
     SoftwareRenderer::BackendFunctions.GetWindowFlags = SoftwareRenderer::GetWindowFlags;
     SoftwareRenderer::BackendFunctions.Dispose = SoftwareRenderer::Dispose;
@@ -232,15 +323,28 @@ PUBLIC STATIC void     SoftwareRenderer::SetGraphicsFunctions() {
     SoftwareRenderer::BackendFunctions.MakeFrameBufferID = SoftwareRenderer::MakeFrameBufferID;
 }
 PUBLIC STATIC void     SoftwareRenderer::Dispose() {
-
+    SoftwareRenderer::WaitForFrame();
+    if (DrawThreadsStarted)
+        StopDrawThreads();
 }
 
 PUBLIC STATIC void     SoftwareRenderer::RenderStart() {
+    SoftwareRenderer::WaitForFrame();
+
     for (int i = 0; i < MAX_PALETTE_COUNT; i++)
         Graphics::PaletteColors[i][0] &= 0xFFFFFF;
+
+    if (!DrawThreadsStarted)
+        StartDrawThreads();
+
+    RecordingCommands = DrawThreadCount > 1;
 }
 PUBLIC STATIC void     SoftwareRenderer::RenderEnd() {
-
+    if (PipelineFrames && !DrawCommands.empty())
+        StartFrame();
+    else
+        SoftwareRenderer::FlushCommands();
+    RecordingCommands = false;
 }
 
 // Texture management functions
@@ -267,6 +371,8 @@ PUBLIC STATIC void     SoftwareRenderer::SetRenderTarget(Texture* texture) {
 
 }
 PUBLIC STATIC void     SoftwareRenderer::ReadFramebuffer(void* pixels, int width, int height) {
+    SoftwareRenderer::FlushCommands();
+
     if (Graphics::Internal.ReadFramebuffer)
         Graphics::Internal.ReadFramebuffer(pixels, width, height);
 }
@@ -313,28 +419,48 @@ PUBLIC STATIC void     SoftwareRenderer::MakePerspectiveMatrix(Matrix4x4* out, f
     out->Values[15] = 0.0f;
 }
 
+static Texture* GetRenderTarget() {
+    return ReplayState ? ReplayState->Target : Graphics::CurrentRenderTarget;
+}
+static View* GetRenderTargetView() {
+    return ReplayState ? ReplayState->TargetView : Graphics::CurrentView;
+}
+
 void GetClipRegion(int& clip_x1, int& clip_y1, int& clip_x2, int& clip_y2) {
-    if (Graphics::CurrentClip.Enabled) {
-        clip_x1 = Graphics::CurrentClip.X;
-        clip_y1 = Graphics::CurrentClip.Y;
-        clip_x2 = Graphics::CurrentClip.X + Graphics::CurrentClip.Width;
-        clip_y2 = Graphics::CurrentClip.Y + Graphics::CurrentClip.Height;
+    ClipArea& clip = ReplayState ? ReplayState->Clip : Graphics::CurrentClip;
+    Texture* renderTarget = GetRenderTarget();
+    if (clip.Enabled) {
+        clip_x1 = clip.X;
+        clip_y1 = clip.Y;
+        clip_x2 = clip.X + clip.Width;
+        clip_y2 = clip.Y + clip.Height;
 
         if (clip_x1 < 0)
             clip_x1 = 0;
         if (clip_y1 < 0)
             clip_y1 = 0;
-        if (clip_x2 > (int)Graphics::CurrentRenderTarget->Width)
-            clip_x2 = (int)Graphics::CurrentRenderTarget->Width;
-        if (clip_y2 > (int)Graphics::CurrentRenderTarget->Height)
-            clip_y2 = (int)Graphics::CurrentRenderTarget->Height;
+        if (clip_x2 > (int)renderTarget->Width)
+            clip_x2 = (int)renderTarget->Width;
+        if (clip_y2 > (int)renderTarget->Height)
+            clip_y2 = (int)renderTarget->Height;
     }
     else {
         clip_x1 = 0;
         clip_y1 = 0;
-        clip_x2 = (int)Graphics::CurrentRenderTarget->Width;
-        clip_y2 = (int)Graphics::CurrentRenderTarget->Height;
+        clip_x2 = (int)renderTarget->Width;
+        clip_y2 = (int)renderTarget->Height;
     }
+
+    if (clip_y1 < BandY1)
+        clip_y1 = BandY1;
+    if (clip_y2 > BandY2)
+        clip_y2 = BandY2;
+}
+static bool GetTextureBlend() {
+    return ReplayState ? ReplayState->TextureBlend : Graphics::TextureBlend;
+}
+static bool GetUsePalettes() {
+    return ReplayState ? ReplayState->UsePalettes : Graphics::UsePalettes;
 }
 bool CheckClipRegion(int clip_x1, int clip_y1, int clip_x2, int clip_y2) {
     if (clip_x2 < 0 || clip_y2 < 0 || clip_x1 >= clip_x2 || clip_y1 >= clip_y2)
@@ -349,6 +475,9 @@ PUBLIC STATIC void     SoftwareRenderer::UseShader(void* shader) {
         return;
     }
 
+    // Recorded draws only point at the filter table
+    SoftwareRenderer::FlushCommands();
+
     ObjArray* array = (ObjArray*)shader;
 
     if (Graphics::PreferredPixelFormat == SDL_PIXELFORMAT_ARGB8888) {
@@ -393,6 +522,8 @@ PUBLIC STATIC void     SoftwareRenderer::SetFilter(int filter) {
 
 // These guys
 PUBLIC STATIC void     SoftwareRenderer::Clear() {
+    SoftwareRenderer::FlushCommands();
+
     Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
     Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
     memset(dstPx, 0, dstStride * Graphics::CurrentRenderTarget->Height * 4);
@@ -648,6 +779,160 @@ PUBLIC STATIC void     SoftwareRenderer::SetTintFunction(int blendFlags) {
         CurrentTintFunction = tintFunctions[CurrentBlendState.Tint.Mode];
 }
 
+// Sprite span kernels
+// These do the same work as the pixel functions above, but a whole row at a
+// time, with the blend mode, tinting, palette lookup and horizontal flip
+// fixed at compile time. That lets the compiler inline the blend and
+// vectorize the simple cases, instead of calling through a function
+// pointer for every pixel. They're only used when there is no stencil or
+// dot mask to apply.
+template <int BlendFlag>
+static inline void BlendSpritePixel(Uint32 src, Uint32* dst, int* multTableAt, int* multInvTableAt, int* multSubTableAt) {
+    switch (BlendFlag) {
+        case BlendFlag_OPAQUE:
+            *dst = src;
+            break;
+        case BlendFlag_TRANSPARENT:
+            *dst = 0xFF000000U
+                | (multTableAt[GET_R(src)] + multInvTableAt[GET_R(*dst)]) << 16
+                | (multTableAt[GET_G(src)] + multInvTableAt[GET_G(*dst)]) << 8
+                | (multTableAt[GET_B(src)] + multInvTableAt[GET_B(*dst)]);
+            break;
+        case BlendFlag_ADDITIVE: {
+            Uint32 R = (multTableAt[GET_R(src)] << 16) + ISOLATE_R(*dst);
+            Uint32 G = (multTableAt[GET_G(src)] << 8) + ISOLATE_G(*dst);
+            Uint32 B = (multTableAt[GET_B(src)]) + ISOLATE_B(*dst);
+            if (R > 0xFF0000) R = 0xFF0000;
+            if (G > 0x00FF00) G = 0x00FF00;
+            if (B > 0x0000FF) B = 0x0000FF;
+            *dst = 0xFF000000U | R | G | B;
+            break;
+        }
+        case BlendFlag_SUBTRACT: {
+            Sint32 R = (multSubTableAt[GET_R(src)] << 16) + ISOLATE_R(*dst);
+            Sint32 G = (multSubTableAt[GET_G(src)] << 8) + ISOLATE_G(*dst);
+            Sint32 B = (multSubTableAt[GET_B(src)]) + ISOLATE_B(*dst);
+            if (R < 0) R = 0;
+            if (G < 0) G = 0;
+            if (B < 0) B = 0;
+            *dst = 0xFF000000U | R | G | B;
+            break;
+        }
+        case BlendFlag_MATCH_EQUAL:
+            if ((*dst & 0xFCFCFC) == (SoftwareRenderer::CompareColor & 0xFCFCFC))
+                *dst = src;
+            break;
+        case BlendFlag_MATCH_NOT_EQUAL:
+            if ((*dst & 0xFCFCFC) != (SoftwareRenderer::CompareColor & 0xFCFCFC))
+                *dst = src;
+            break;
+    }
+}
+template <int BlendFlag, bool Tinted>
+static inline void PlaceSpritePixel(Uint32 color, Uint32* dst, BlendState& state, int* multTableAt, int* multInvTableAt, int* multSubTableAt) {
+    if (Tinted)
+        color = 0xFF000000U | CurrentTintFunction(&color, dst, state.Tint.Color, state.Tint.Amount);
+
+    BlendSpritePixel<BlendFlag>(color, dst, multTableAt, multInvTableAt, multSubTableAt);
+}
+
+typedef void (*SpriteSpanFunction)(Uint32* src, Uint32* dst, int count, Uint32* palette, BlendState& state, int* multTableAt, int* multSubTableAt);
+
+// Draws count pixels to dst, reading from src forwards (or backwards when
+// flipped).
+template <int BlendFlag, bool Tinted, bool Paletted, bool FlipX>
+static void DrawSpriteSpan(Uint32* src, Uint32* dst, int count, Uint32* palette, BlendState& state, int* multTableAt, int* multSubTableAt) {
+    int* multInvTableAt = &SoftwareRenderer::MultTableInv[state.Opacity << 8];
+    for (int i = 0; i < count; i++) {
+        Uint32 color = FlipX ? src[-i] : src[i];
+        if (Paletted) {
+            if (!color)
+                continue;
+            color = palette[color];
+        }
+        else if (!(color & 0xFF000000U))
+            continue;
+
+        PlaceSpritePixel<BlendFlag, Tinted>(color, &dst[i], state, multTableAt, multInvTableAt, multSubTableAt);
+    }
+}
+
+struct SpriteTransformRow {
+    // Bounds of the untransformed sprite, relative to its origin
+    int X1, Y1, X2, Y2;
+    // Source rectangle; SrcX/SrcY is where sampling starts (the far edge
+    // when flipped), and DirX/DirY the direction it moves in.
+    int SrcX, SrcY, DirX, DirY;
+    int SrcW, SrcH, DstW, DstH;
+    Uint32* SrcPx;
+    Uint32  SrcStride;
+    int Cos, Sin;
+};
+typedef void (*SpriteTransformSpanFunction)(SpriteTransformRow& row, int i_x, int i_y, Uint32* dst, int count, Uint32* palette, BlendState& state, int* multTableAt, int* multSubTableAt);
+
+// Draws count pixels of a rotated/scaled sprite row to dst, starting at
+// i_x, i_y (relative to the sprite's position).
+template <int BlendFlag, bool Tinted, bool Paletted>
+static void DrawSpriteTransformedSpan(SpriteTransformRow& row, int i_x, int i_y, Uint32* dst, int count, Uint32* palette, BlendState& state, int* multTableAt, int* multSubTableAt) {
+    int* multInvTableAt = &SoftwareRenderer::MultTableInv[state.Opacity << 8];
+    int i_y_rsin = -i_y * row.Sin;
+    int i_y_rcos =  i_y * row.Cos;
+    for (int i = 0; i < count; i++, i_x++) {
+        int src_x = (i_x * row.Cos + i_y_rsin) >> TRIG_TABLE_BITS;
+        int src_y = (i_x * row.Sin + i_y_rcos) >> TRIG_TABLE_BITS;
+        if (src_x < row.X1 || src_y < row.Y1 || src_x >= row.X2 || src_y >= row.Y2)
+            continue;
+
+        src_x = row.SrcX + row.DirX * ((src_x - row.X1) * row.SrcW / row.DstW);
+        src_y = row.SrcY + row.DirY * ((src_y - row.Y1) * row.SrcH / row.DstH);
+
+        Uint32 color = row.SrcPx[src_x + src_y * row.SrcStride];
+        if (Paletted) {
+            if (!color)
+                continue;
+            color = palette[color];
+        }
+        else if (!(color & 0xFF000000U))
+            continue;
+
+        PlaceSpritePixel<BlendFlag, Tinted>(color, &dst[i], state, multTableAt, multInvTableAt, multSubTableAt);
+    }
+}
+
+#define SPRITE_SPAN_FLIP(blend, tinted, paletted) { DrawSpriteSpan<blend, tinted, paletted, false>, DrawSpriteSpan<blend, tinted, paletted, true> }
+#define SPRITE_SPAN_PAL(blend, tinted) { SPRITE_SPAN_FLIP(blend, tinted, false), SPRITE_SPAN_FLIP(blend, tinted, true) }
+#define SPRITE_SPAN(blend) { SPRITE_SPAN_PAL(blend, false), SPRITE_SPAN_PAL(blend, true) }
+
+// Indexed by [blend mode][tinted][paletted][flipped horizontally]
+static SpriteSpanFunction SpriteSpanFunctions[6][2][2][2] = {
+    SPRITE_SPAN(BlendFlag_OPAQUE),
+    SPRITE_SPAN(BlendFlag_TRANSPARENT),
+    SPRITE_SPAN(BlendFlag_ADDITIVE),
+    SPRITE_SPAN(BlendFlag_SUBTRACT),
+    SPRITE_SPAN(BlendFlag_MATCH_EQUAL),
+    SPRITE_SPAN(BlendFlag_MATCH_NOT_EQUAL)
+};
+
+#undef SPRITE_SPAN_FLIP
+#undef SPRITE_SPAN_PAL
+#undef SPRITE_SPAN
+
+#define SPRITE_TRANSFORM_SPAN_PAL(blend, tinted) { DrawSpriteTransformedSpan<blend, tinted, false>, DrawSpriteTransformedSpan<blend, tinted, true> }
+#define SPRITE_TRANSFORM_SPAN(blend) { SPRITE_TRANSFORM_SPAN_PAL(blend, false), SPRITE_TRANSFORM_SPAN_PAL(blend, true) }
+
+// Indexed by [blend mode][tinted][paletted]
+static SpriteTransformSpanFunction SpriteTransformSpanFunctions[6][2][2] = {
+    SPRITE_TRANSFORM_SPAN(BlendFlag_OPAQUE),
+    SPRITE_TRANSFORM_SPAN(BlendFlag_TRANSPARENT),
+    SPRITE_TRANSFORM_SPAN(BlendFlag_ADDITIVE),
+    SPRITE_TRANSFORM_SPAN(BlendFlag_SUBTRACT),
+    SPRITE_TRANSFORM_SPAN(BlendFlag_MATCH_EQUAL),
+    SPRITE_TRANSFORM_SPAN(BlendFlag_MATCH_NOT_EQUAL)
+};
+
+#undef SPRITE_TRANSFORM_SPAN_PAL
+#undef SPRITE_TRANSFORM_SPAN
+
 // Stencil ops (test)
 static bool StencilTestNever(Uint8* buf, Uint8 value, Uint8 mask) {
     return false;
@@ -719,11 +1004,13 @@ static StencilOpFunction StencilOpFunctionList[] = {
 };
 
 // Stencil buffer management
-StencilTestFunction StencilFuncTest = StencilTestAlways;
-StencilOpFunction StencilFuncPass = StencilOpKeep;
-StencilOpFunction StencilFuncFail = StencilOpKeep;
+thread_local StencilTestFunction StencilFuncTest = StencilTestAlways;
+thread_local StencilOpFunction StencilFuncPass = StencilOpKeep;
+thread_local StencilOpFunction StencilFuncFail = StencilOpKeep;
 
 PUBLIC STATIC void     SoftwareRenderer::SetStencilEnabled(bool enabled) {
+    SoftwareRenderer::FlushCommands();
+
     if (Scene::ViewCurrent >= 0) {
         UseStencil = enabled;
         Scene::Views[Scene::ViewCurrent].SetStencilEnabled(enabled);
@@ -762,14 +1049,16 @@ PUBLIC STATIC void     SoftwareRenderer::SetStencilMask(int mask) {
     StencilMask = mask;
 }
 PUBLIC STATIC void     SoftwareRenderer::ClearStencil() {
+    SoftwareRenderer::FlushCommands();
+
     if (UseStencil && Graphics::CurrentView)
         Graphics::CurrentView->ClearStencil();
 }
 
 PUBLIC STATIC void SoftwareRenderer::PixelStencil(Uint32* src, Uint32* dst, BlendState& state, int* multTableAt, int* multSubTableAt) {
-    size_t pos = dst - (Uint32*)Graphics::CurrentRenderTarget->Pixels;
+    size_t pos = dst - (Uint32*)GetRenderTarget()->Pixels;
 
-    View* currentView = Graphics::CurrentView;
+    View* currentView = GetRenderTargetView();
     Uint8* buffer = &currentView->StencilBuffer[pos];
     if (StencilFuncTest(buffer, StencilValue, StencilMask)) {
         CurrentPixelFunction(src, dst, state, multTableAt, multSubTableAt);
@@ -807,9 +1096,10 @@ PUBLIC STATIC void SoftwareRenderer::SetDotMaskOffsetV(int offset) {
 }
 
 PUBLIC STATIC void SoftwareRenderer::PixelDotMaskH(Uint32* src, Uint32* dst, BlendState& state, int* multTableAt, int* multSubTableAt) {
-    size_t pos = dst - (Uint32*)Graphics::CurrentRenderTarget->Pixels;
+    Texture* renderTarget = GetRenderTarget();
+    size_t pos = dst - (Uint32*)renderTarget->Pixels;
 
-    int x = (pos % Graphics::CurrentRenderTarget->Width) + DotMaskOffsetH;
+    int x = (pos % renderTarget->Width) + DotMaskOffsetH;
     if (x & DotMaskH)
         return;
 
@@ -819,9 +1109,10 @@ PUBLIC STATIC void SoftwareRenderer::PixelDotMaskH(Uint32* src, Uint32* dst, Ble
         CurrentPixelFunction(src, dst, state, multTableAt, multSubTableAt);
 }
 PUBLIC STATIC void SoftwareRenderer::PixelDotMaskV(Uint32* src, Uint32* dst, BlendState& state, int* multTableAt, int* multSubTableAt) {
-    size_t pos = dst - (Uint32*)Graphics::CurrentRenderTarget->Pixels;
+    Texture* renderTarget = GetRenderTarget();
+    size_t pos = dst - (Uint32*)renderTarget->Pixels;
 
-    int y = (pos / Graphics::CurrentRenderTarget->Width) + DotMaskOffsetV;
+    int y = (pos / renderTarget->Width) + DotMaskOffsetV;
     if (y & DotMaskV)
         return;
 
@@ -831,10 +1122,11 @@ PUBLIC STATIC void SoftwareRenderer::PixelDotMaskV(Uint32* src, Uint32* dst, Ble
         CurrentPixelFunction(src, dst, state, multTableAt, multSubTableAt);
 }
 PUBLIC STATIC void SoftwareRenderer::PixelDotMaskHV(Uint32* src, Uint32* dst, BlendState& state, int* multTableAt, int* multSubTableAt) {
-    size_t pos = dst - (Uint32*)Graphics::CurrentRenderTarget->Pixels;
+    Texture* renderTarget = GetRenderTarget();
+    size_t pos = dst - (Uint32*)renderTarget->Pixels;
 
-    int x = (pos % Graphics::CurrentRenderTarget->Width) + DotMaskOffsetH;
-    int y = (pos / Graphics::CurrentRenderTarget->Width) + DotMaskOffsetV;
+    int x = (pos % renderTarget->Width) + DotMaskOffsetH;
+    int y = (pos / renderTarget->Width) + DotMaskOffsetV;
     if (x & DotMaskH || y & DotMaskV)
         return;
 
@@ -844,6 +1136,539 @@ PUBLIC STATIC void SoftwareRenderer::PixelDotMaskHV(Uint32* src, Uint32* dst, Bl
         CurrentPixelFunction(src, dst, state, multTableAt, multSubTableAt);
 }
 
+// Multithreaded drawing
+// When "softwareThreads" is set in the display settings, sprites, textures,
+// rectangles and tile layers drawn while a software view is rendering are
+// recorded instead of drawn right away. When anything needs the render
+// target to be up to date (any other draw call, the end of the view, a
+// palette or texture change), the recorded calls are replayed by every
+// thread at once, each clipped to its own horizontal band of the render
+// target. Calls are replayed in the order they were made, so the result is
+// the same as drawing them one by one.
+void DrawSpriteImage(Texture* texture, int x, int y, int w, int h, int sx, int sy, int flipFlag, BlendState blendState);
+void DrawSpriteImageTransformed(Texture* texture, int x, int y, int offx, int offy, int w, int h, int sx, int sy, int sw, int sh, int flipFlag, int rotation, BlendState blendState);
+void FillRectangleImage(int dst_x1, int dst_y1, int dst_x2, int dst_y2, Uint32 col, BlendState blendState);
+
+static void CaptureDrawCommandState(DrawCommandState* state) {
+    memset(state, 0, sizeof(DrawCommandState));
+    state->Blend = CurrentBlendState;
+    state->Clip = Graphics::CurrentClip;
+    state->TextureBlend = Graphics::TextureBlend;
+    state->UsePalettes = Graphics::UsePalettes;
+    state->UseStencil = UseStencil;
+    state->StencilValue = StencilValue;
+    state->StencilMask = StencilMask;
+    state->StencilTest = StencilFuncTest;
+    state->StencilPass = StencilFuncPass;
+    state->StencilFail = StencilFuncFail;
+    state->DotMaskH = DotMaskH;
+    state->DotMaskV = DotMaskV;
+    state->DotMaskOffsetH = DotMaskOffsetH;
+    state->DotMaskOffsetV = DotMaskOffsetV;
+    state->CompareColor = SoftwareRenderer::CompareColor;
+    state->Target = Graphics::CurrentRenderTarget;
+    state->TargetView = Graphics::CurrentView;
+}
+static void ApplyDrawCommandState(DrawCommandState* state) {
+    ReplayState = state;
+    CurrentBlendState = state->Blend;
+    UseStencil = state->UseStencil;
+    StencilValue = state->StencilValue;
+    StencilMask = state->StencilMask;
+    StencilFuncTest = state->StencilTest;
+    StencilFuncPass = state->StencilPass;
+    StencilFuncFail = state->StencilFail;
+    DotMaskH = state->DotMaskH;
+    DotMaskV = state->DotMaskV;
+    DotMaskOffsetH = state->DotMaskOffsetH;
+    DotMaskOffsetV = state->DotMaskOffsetV;
+    SoftwareRenderer::CompareColor = state->CompareColor;
+    // Deformed sprites are never recorded
+    SoftwareRenderer::UseSpriteDeform = false;
+}
+
+// Returns true if a draw call should be recorded instead of drawn. If it
+// shouldn't, everything recorded before it is drawn first.
+static bool ShouldRecordCommand() {
+    if (ReplayState || !RecordingCommands)
+        return false;
+
+    // The deform buffer can change at any time
+    if (SoftwareRenderer::UseSpriteDeform) {
+        SoftwareRenderer::FlushCommands();
+        return false;
+    }
+
+    return true;
+}
+static DrawCommand* AddDrawCommand(int type) {
+    DrawCommandState state;
+    CaptureDrawCommandState(&state);
+    if (DrawCommandStates.empty() || memcmp(&DrawCommandStates.back(), &state, sizeof(DrawCommandState)) != 0)
+        DrawCommandStates.push_back(state);
+
+    DrawCommands.emplace_back();
+
+    DrawCommand* command = &DrawCommands.back();
+    command->Type = type;
+    command->State = DrawCommandStates.size() - 1;
+    return command;
+}
+
+static void ReplayDrawCommands(int band, int bandCount) {
+    int height = (int)DrawCommandStates[DrawCommands[0].State].Target->Height;
+    BandY1 = height * band / bandCount;
+    BandY2 = height * (band + 1) / bandCount;
+
+    for (size_t i = 0; i < DrawCommands.size(); i++) {
+        DrawCommand& command = DrawCommands[i];
+        int* args = command.Args;
+
+        DrawCommandState* state = &DrawCommandStates[command.State];
+        if (state != ReplayState)
+            ApplyDrawCommandState(state);
+
+        switch (command.Type) {
+            case DrawCommand_SpriteImage:
+                DrawSpriteImage(command.Source, args[0], args[1], args[2], args[3], args[4], args[5], args[6], command.Blend);
+                break;
+            case DrawCommand_SpriteImageTransformed:
+                DrawSpriteImageTransformed(command.Source, args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8], args[9], args[10], args[11], command.Blend);
+                break;
+            case DrawCommand_Rectangle:
+                FillRectangleImage(args[0], args[1], args[2], args[3], (Uint32)args[4], command.Blend);
+                break;
+            case DrawCommand_SceneLayer:
+                SoftwareRenderer::DrawSceneLayer_ScanLines(command.Layer, command.LayerView);
+                break;
+        }
+    }
+
+    BandY1 = 0;
+    BandY2 = MAX_FRAMEBUFFER_HEIGHT;
+}
+static int DrawThreadFunc(void* data) {
+    int band = (int)(intptr_t)data;
+    while (true) {
+        SDL_SemWait(DrawThreadStart[band]);
+        if (DrawThreadsQuit)
+            break;
+
+        if (DrawThreadJob)
+            DrawThreadJob(band);
+        else {
+            ReplayDrawCommands(band, DrawThreadCount);
+            ReplayState = NULL;
+        }
+
+        SDL_SemPost(DrawThreadDone);
+    }
+    return 0;
+}
+// Runs a job on the first count draw threads at once, passing each its
+// index, and waits for all of them. Recorded draw calls must have been
+// flushed first, since the threads can't replay them in the meantime.
+static void RunDrawThreadJob(void (*job)(int index), int count) {
+    DrawThreadJob = job;
+    for (int i = 1; i < count; i++)
+        SDL_SemPost(DrawThreadStart[i]);
+
+    job(0);
+
+    for (int i = 1; i < count; i++)
+        SDL_SemWait(DrawThreadDone);
+    DrawThreadJob = NULL;
+}
+PRIVATE STATIC void SoftwareRenderer::StartDrawThreads() {
+    DrawThreadsStarted = true;
+
+    int count = 0;
+    Application::Settings->GetInteger("display", "softwareThreads", &count);
+    if (count > MAX_DRAW_THREADS)
+        count = MAX_DRAW_THREADS;
+    if (count < 2)
+        return;
+
+    DrawThreadDone = SDL_CreateSemaphore(0);
+    if (!DrawThreadDone)
+        return;
+
+    // The thread that renders the view draws the first band
+    DrawThreadCount = 1;
+    for (int i = 1; i < count; i++) {
+        DrawThreadStart[i] = SDL_CreateSemaphore(0);
+        if (!DrawThreadStart[i])
+            break;
+
+        DrawThreads[i] = SDL_CreateThread(DrawThreadFunc, "SoftwareRenderer::DrawThreadFunc", (void*)(intptr_t)i);
+        if (!DrawThreads[i]) {
+            SDL_DestroySemaphore(DrawThreadStart[i]);
+            break;
+        }
+
+        DrawThreadCount++;
+    }
+
+    Log::Print(Log::LOG_VERBOSE, "Software renderer threads: %d", DrawThreadCount);
+}
+PRIVATE STATIC void SoftwareRenderer::StopDrawThreads() {
+    DrawThreadsQuit = true;
+    for (int i = 1; i < DrawThreadCount; i++) {
+        SDL_SemPost(DrawThreadStart[i]);
+        SDL_WaitThread(DrawThreads[i], NULL);
+        SDL_DestroySemaphore(DrawThreadStart[i]);
+    }
+
+    if (DrawThreadDone)
+        SDL_DestroySemaphore(DrawThreadDone);
+
+    DrawThreadDone = NULL;
+    DrawThreadCount = 0;
+    DrawThreadsStarted = false;
+    DrawThreadsQuit = false;
+}
+
+// Frame pipelining
+// Instead of drawing the rest of its recorded calls at the end of a view,
+// the main thread leaves them to the other threads (one band each) and
+// returns right away, so the composite, Present and the next frame's update
+// run while they draw. The render target is uploaded once they're done,
+// which happens the next time anything needs the software renderer, so the
+// view is shown one frame late. Script callbacks and GL calls stay on the
+// main thread.
+static void ReplayFrameJob(int index) {
+    ReplayDrawCommands(index - 1, DrawThreadCount - 1);
+    ReplayState = NULL;
+}
+PRIVATE STATIC void SoftwareRenderer::StartFrame() {
+    DrawThreadJob = ReplayFrameJob;
+    for (int i = 1; i < DrawThreadCount; i++)
+        SDL_SemPost(DrawThreadStart[i]);
+
+    FramePending = true;
+    PendingTarget = Graphics::CurrentRenderTarget;
+}
+PUBLIC STATIC bool SoftwareRenderer::IsFramePending() {
+    return FramePending;
+}
+PUBLIC STATIC void SoftwareRenderer::WaitForFrame() {
+    if (!FramePending)
+        return;
+
+    for (int i = 1; i < DrawThreadCount; i++)
+        SDL_SemWait(DrawThreadDone);
+
+    DrawThreadJob = NULL;
+    FramePending = false;
+    DrawCommands.clear();
+    DrawCommandStates.clear();
+
+    Texture* target = PendingTarget;
+    PendingTarget = NULL;
+    if (!Graphics::NoInternalTextures)
+        Graphics::Internal.UpdateTexture(target, NULL, target->Pixels, target->Width * 4);
+}
+
+PUBLIC STATIC void SoftwareRenderer::FlushCommands() {
+    if (ReplayState)
+        return;
+
+    SoftwareRenderer::WaitForFrame();
+    if (DrawCommands.empty())
+        return;
+
+    for (int i = 1; i < DrawThreadCount; i++)
+        SDL_SemPost(DrawThreadStart[i]);
+
+    // This thread's own state has to survive replaying the first band
+    DrawCommandState savedState;
+    CaptureDrawCommandState(&savedState);
+    bool useSpriteDeform = SoftwareRenderer::UseSpriteDeform;
+
+    ReplayDrawCommands(0, DrawThreadCount);
+
+    ApplyDrawCommandState(&savedState);
+    SoftwareRenderer::UseSpriteDeform = useSpriteDeform;
+    ReplayState = NULL;
+
+    for (int i = 1; i < DrawThreadCount; i++)
+        SDL_SemWait(DrawThreadDone);
+
+    DrawCommands.clear();
+    DrawCommandStates.clear();
+}
+
+// Span blending
+// BlendSpan blends a row of pixels at once. Where the CPU supports it
+// (SSE2 on x86, NEON on ARM), four pixels are blended per iteration; the
+// results are the same as the pixel functions above, bit for bit.
+// A pixel is drawn if its byte in mask is set, or, when there is no mask,
+// if its alpha isn't zero.
+PUBLIC STATIC bool SoftwareRenderer::DetectSIMD() {
+#if defined(SOFTWARE_SIMD_SSE2)
+    #if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    return true;
+    #elif defined(__GNUC__)
+    return __builtin_cpu_supports("sse2");
+    #elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] >> 26) & 1;
+    #else
+    return false;
+    #endif
+#elif defined(SOFTWARE_SIMD_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void BlendSpanScalar(int blendMode, Uint32* src, Uint8* mask, Uint32* dst, int count, BlendState& state) {
+    PixelFunction pixelFunction = PixelNoFiltFunctions[blendMode];
+    int* multTableAt = &SoftwareRenderer::MultTable[state.Opacity << 8];
+    int* multSubTableAt = &SoftwareRenderer::MultSubTable[state.Opacity << 8];
+    for (int i = 0; i < count; i++) {
+        if (mask ? mask[i] : (src[i] & 0xFF000000U))
+            pixelFunction(&src[i], &dst[i], state, multTableAt, multSubTableAt);
+    }
+}
+
+#if defined(SOFTWARE_SIMD_SSE2)
+SSE2_TARGET static inline __m128i MultiplySSE2(__m128i color, __m128i amount, __m128i zero) {
+    __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(color, zero), amount), 8);
+    __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(color, zero), amount), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+// Same as MultiplySSE2, but rounds up (matches MultSubTable)
+SSE2_TARGET static inline __m128i MultiplyCeilSSE2(__m128i color, __m128i amount, __m128i zero) {
+    __m128i round = _mm_set1_epi16(0xFF);
+    __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(color, zero), amount), round), 8);
+    __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(color, zero), amount), round), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+SSE2_TARGET static int BlendSpanSSE2(int blendMode, Uint32* src, Uint8* mask, Uint32* dst, int count, BlendState& state) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i ones = _mm_set1_epi32(-1);
+    __m128i alphaMask = _mm_set1_epi32((int)0xFF000000U);
+    __m128i matchMask = _mm_set1_epi32(0xFCFCFC);
+    __m128i compare = _mm_set1_epi32(SoftwareRenderer::CompareColor & 0xFCFCFC);
+    __m128i opacity = _mm_set1_epi16(state.Opacity);
+    __m128i opacityInv = _mm_set1_epi16(state.Opacity ^ 0xFF);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((__m128i*)&src[i]);
+        __m128i d = _mm_loadu_si128((__m128i*)&dst[i]);
+
+        __m128i draw;
+        if (mask) {
+            Uint32 bytes;
+            memcpy(&bytes, &mask[i], 4);
+            __m128i m = _mm_cvtsi32_si128((int)bytes);
+            m = _mm_unpacklo_epi16(_mm_unpacklo_epi8(m, zero), zero);
+            draw = _mm_cmpgt_epi32(m, zero);
+        }
+        else {
+            draw = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask), zero), ones);
+        }
+
+        __m128i result;
+        switch (blendMode) {
+            case BlendFlag_TRANSPARENT:
+                result = _mm_or_si128(_mm_add_epi8(MultiplySSE2(s, opacity, zero), MultiplySSE2(d, opacityInv, zero)), alphaMask);
+                break;
+            case BlendFlag_ADDITIVE:
+                result = _mm_or_si128(_mm_adds_epu8(d, MultiplySSE2(s, opacity, zero)), alphaMask);
+                break;
+            case BlendFlag_SUBTRACT:
+                result = _mm_or_si128(_mm_subs_epu8(d, MultiplyCeilSSE2(_mm_xor_si128(s, ones), opacity, zero)), alphaMask);
+                break;
+            case BlendFlag_MATCH_EQUAL:
+                draw = _mm_and_si128(draw, _mm_cmpeq_epi32(_mm_and_si128(d, matchMask), compare));
+                result = s;
+                break;
+            case BlendFlag_MATCH_NOT_EQUAL:
+                draw = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(d, matchMask), compare), draw);
+                result = s;
+                break;
+            default:
+                result = s;
+                break;
+        }
+
+        result = _mm_or_si128(_mm_and_si128(draw, result), _mm_andnot_si128(draw, d));
+        _mm_storeu_si128((__m128i*)&dst[i], result);
+    }
+    return i;
+}
+#elif defined(SOFTWARE_SIMD_NEON)
+static inline uint8x16_t MultiplyNEON(uint8x16_t color, uint8x8_t amount) {
+    uint16x8_t lo = vmull_u8(vget_low_u8(color), amount);
+    uint16x8_t hi = vmull_u8(vget_high_u8(color), amount);
+    return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+// Same as MultiplyNEON, but rounds up (matches MultSubTable)
+static inline uint8x16_t MultiplyCeilNEON(uint8x16_t color, uint8x8_t amount) {
+    uint16x8_t round = vdupq_n_u16(0xFF);
+    uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(color), amount), round);
+    uint16x8_t hi = vaddq_u16(vmull_u8(vget_high_u8(color), amount), round);
+    return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+static int BlendSpanNEON(int blendMode, Uint32* src, Uint8* mask, Uint32* dst, int count, BlendState& state) {
+    uint32x4_t alphaMask = vdupq_n_u32(0xFF000000U);
+    uint32x4_t matchMask = vdupq_n_u32(0xFCFCFC);
+    uint32x4_t compare = vdupq_n_u32(SoftwareRenderer::CompareColor & 0xFCFCFC);
+    uint8x8_t opacity = vdup_n_u8(state.Opacity);
+    uint8x8_t opacityInv = vdup_n_u8(state.Opacity ^ 0xFF);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t s = vld1q_u32(&src[i]);
+        uint32x4_t d = vld1q_u32(&dst[i]);
+        uint8x16_t s8 = vreinterpretq_u8_u32(s);
+        uint8x16_t d8 = vreinterpretq_u8_u32(d);
+
+        uint32x4_t draw;
+        if (mask) {
+            Uint32 bytes[4] = { mask[i], mask[i + 1], mask[i + 2], mask[i + 3] };
+            draw = vtstq_u32(vld1q_u32(bytes), vdupq_n_u32(0xFF));
+        }
+        else {
+            draw = vtstq_u32(s, alphaMask);
+        }
+
+        uint32x4_t result;
+        switch (blendMode) {
+            case BlendFlag_TRANSPARENT:
+                result = vorrq_u32(vreinterpretq_u32_u8(vaddq_u8(MultiplyNEON(s8, opacity), MultiplyNEON(d8, opacityInv))), alphaMask);
+                break;
+            case BlendFlag_ADDITIVE:
+                result = vorrq_u32(vreinterpretq_u32_u8(vqaddq_u8(d8, MultiplyNEON(s8, opacity))), alphaMask);
+                break;
+            case BlendFlag_SUBTRACT:
+                result = vorrq_u32(vreinterpretq_u32_u8(vqsubq_u8(d8, MultiplyCeilNEON(vmvnq_u8(s8), opacity))), alphaMask);
+                break;
+            case BlendFlag_MATCH_EQUAL:
+                draw = vandq_u32(draw, vceqq_u32(vandq_u32(d, matchMask), compare));
+                result = s;
+                break;
+            case BlendFlag_MATCH_NOT_EQUAL:
+                draw = vbicq_u32(draw, vceqq_u32(vandq_u32(d, matchMask), compare));
+                result = s;
+                break;
+            default:
+                result = s;
+                break;
+        }
+
+        vst1q_u32(&dst[i], vbslq_u32(draw, result, d));
+    }
+    return i;
+}
+#endif
+
+static void BlendSpan(int blendMode, Uint32* src, Uint8* mask, Uint32* dst, int count, BlendState& state) {
+    int done = 0;
+    if (UseSIMD) {
+#if defined(SOFTWARE_SIMD_SSE2)
+        done = BlendSpanSSE2(blendMode, src, mask, dst, count, state);
+#elif defined(SOFTWARE_SIMD_NEON)
+        done = BlendSpanNEON(blendMode, src, mask, dst, count, state);
+#endif
+    }
+
+    if (done < count)
+        BlendSpanScalar(blendMode, src + done, mask ? mask + done : NULL, dst + done, count - done, state);
+}
+
+// Clears the bytes in mask for pixels that the dot mask or the stencil
+// test rejects, and updates the stencil buffer like PixelStencil does.
+static void ApplySpanMasks(Uint8* mask, Uint32* dst, int count) {
+    Texture* renderTarget = GetRenderTarget();
+    Uint32* pixels = (Uint32*)renderTarget->Pixels;
+    size_t pos = dst - pixels;
+    int width = renderTarget->Width;
+    int x = pos % width;
+    int y = pos / width;
+    Uint8* stencil = UseStencil ? &GetRenderTargetView()->StencilBuffer[pos] : NULL;
+
+    if (DotMaskV && ((y + DotMaskOffsetV) & DotMaskV)) {
+        memset(mask, 0, count);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!mask[i])
+            continue;
+
+        if (DotMaskH && ((x + i + DotMaskOffsetH) & DotMaskH)) {
+            mask[i] = 0;
+            continue;
+        }
+
+        if (stencil) {
+            if (StencilFuncTest(&stencil[i], StencilValue, StencilMask))
+                StencilFuncPass(&stencil[i], StencilValue);
+            else {
+                StencilFuncFail(&stencil[i], StencilValue);
+                mask[i] = 0;
+            }
+        }
+    }
+}
+
+#define SPAN_CHUNK 256
+
+// Draws a row that may need tinting, a stencil or a dot mask. src and mask
+// may be modified.
+static void DrawSpan(int blendFlag, Uint32* src, Uint8* mask, Uint32* dst, int count, BlendState& state, bool useMasks) {
+    if (useMasks)
+        ApplySpanMasks(mask, dst, count);
+
+    if (blendFlag & BlendFlag_TINT_BIT) {
+        for (int i = 0; i < count; i++) {
+            if (mask[i])
+                src[i] = 0xFF000000U | CurrentTintFunction(&src[i], &dst[i], state.Tint.Color, state.Tint.Amount);
+        }
+    }
+
+    BlendSpan(blendFlag & BlendFlag_MODE_MASK, src, mask, dst, count, state);
+}
+// Reads a sprite row into colors and mask, applying the palette and
+// horizontal flip, then draws it.
+static void DrawSpriteRow(int blendFlag, Uint32* src, bool flipX, Uint32* palette, Uint32* dst, int count, BlendState& state, bool useMasks) {
+    // Nothing to gather; blend straight from the texture
+    if (!flipX && !palette && !useMasks && !(blendFlag & BlendFlag_TINT_BIT)) {
+        BlendSpan(blendFlag & BlendFlag_MODE_MASK, src, NULL, dst, count, state);
+        return;
+    }
+
+    Uint32 colors[SPAN_CHUNK];
+    Uint8  mask[SPAN_CHUNK];
+
+    while (count > 0) {
+        int n = count < SPAN_CHUNK ? count : SPAN_CHUNK;
+        for (int i = 0; i < n; i++) {
+            Uint32 color = flipX ? src[-i] : src[i];
+            if (palette) {
+                mask[i] = color != 0;
+                colors[i] = palette[color];
+            }
+            else {
+                mask[i] = (color & 0xFF000000U) != 0;
+                colors[i] = color;
+            }
+        }
+
+        DrawSpan(blendFlag, colors, mask, dst, n, state, useMasks);
+
+        src += flipX ? -n : n;
+        dst += n;
+        count -= n;
+    }
+}
+
 // TODO: Material support
 static int CalcVertexColor(Scene3D* scene, VertexAttribute *vertex, int normalY) {
     int col_r = GET_R(vertex->Color);
@@ -928,7 +1753,52 @@ PUBLIC STATIC void     SoftwareRenderer::BindScene3D(Uint32 sceneIndex) {
     else
         polygonRenderer.ClipPolygonsByFrustum = false;
 }
+
+// Per-face setup for DrawScene3D, split between the draw threads
+#define MIN_FACES_PER_DRAW_THREAD 256
+
+static struct {
+    VertexBuffer* Buffer;
+    Uint32        DrawMode;
+    bool          ConvertColors;
+    bool          AverageDepth;
+    int           JobCount;
+} FaceSetup;
+
+static void FaceSetupJob(int index) {
+    VertexBuffer* vertexBuffer = FaceSetup.Buffer;
+
+    // Convert vertex colors to native format
+    if (FaceSetup.ConvertColors) {
+        Uint32 start = (Uint32)((Uint64)vertexBuffer->VertexCount * index / FaceSetup.JobCount);
+        Uint32 end = (Uint32)((Uint64)vertexBuffer->VertexCount * (index + 1) / FaceSetup.JobCount);
+        VertexAttribute* vertex = &vertexBuffer->Vertices[start];
+        for (Uint32 i = start; i < end; i++, vertex++)
+            Graphics::ConvertFromARGBtoNative(&vertex->Color, 1);
+    }
+
+    Uint32 start = (Uint32)((Uint64)vertexBuffer->FaceCount * index / FaceSetup.JobCount);
+    Uint32 end = (Uint32)((Uint64)vertexBuffer->FaceCount * (index + 1) / FaceSetup.JobCount);
+    FaceInfo* faceInfoPtr = &vertexBuffer->FaceInfoBuffer[start];
+    for (Uint32 f = start; f < end; f++, faceInfoPtr++) {
+        // Average the Z coordinates of the face
+        if (FaceSetup.AverageDepth) {
+            Uint32 vertexCount = faceInfoPtr->NumVertices;
+            VertexAttribute* vertex = &vertexBuffer->Vertices[faceInfoPtr->VerticesStartIndex];
+            Sint64 depth = vertex[0].Position.Z;
+            for (Uint32 i = 1; i < vertexCount; i++)
+                depth += vertex[i].Position.Z;
+
+            faceInfoPtr->Depth = depth / vertexCount;
+        }
+
+        faceInfoPtr->DrawMode |= FaceSetup.DrawMode;
+    }
+}
+
 PUBLIC STATIC void     SoftwareRenderer::DrawScene3D(Uint32 sceneIndex, Uint32 drawMode) {
+    SoftwareRenderer::FlushCommands();
+
     if (sceneIndex < 0 || sceneIndex >= MAX_3D_SCENES)
         return;
 
@@ -958,7 +1828,7 @@ PUBLIC STATIC void     SoftwareRenderer::DrawScene3D(Uint32 sceneIndex, Uint32 d
 
 #define SET_BLENDFLAG_AND_OPACITY(face) \
     blendState = {0}; \
-    if (!Graphics::TextureBlend) { \
+    if (!GetTextureBlend()) { \
         blendState.Mode = BlendFlag_OPAQUE; \
         blendState.Opacity = 0xFF; \
     } else { \
@@ -974,45 +1844,51 @@ PUBLIC STATIC void     SoftwareRenderer::DrawScene3D(Uint32 sceneIndex, Uint32 d
     PolygonRasterizer::SetUseDepthBuffer(useDepthBuffer)
 
     VertexBuffer* vertexBuffer = scene->Buffer;
-    VertexAttribute* vertexAttribsPtr = vertexBuffer->Vertices; // R
     FaceInfo* faceInfoPtr = vertexBuffer->FaceInfoBuffer; // RW
 
     bool sortFaces = !doDepthTest && vertexBuffer->FaceCount > 1;
-    if (Graphics::TextureBlend)
+    if (GetTextureBlend())
         sortFaces = true;
 
-    // Convert vertex colors to native format
-    if (Graphics::PreferredPixelFormat != SDL_PIXELFORMAT_ARGB8888) {
-        VertexAttribute* vertex = vertexAttribsPtr;
-        for (Uint32 i = 0; i < vertexBuffer->VertexCount; i++, vertex++)
-            Graphics::ConvertFromARGBtoNative(&vertex->Color, 1);
-    }
+    // If every face is opaque and depth tested, the order they're drawn in
+    // doesn't matter, and drawing the nearest ones first lets the rasterizer
+    // skip more of what's behind them. Every face is opaque here, since
+    // faces are only blended with texture blending on, which sorts them back
+    // to front instead. Lines and points ignore the depth buffer, so they
+    // have to stay in order.
+    bool sortOpaqueFaces = SortOpaqueFaces && !sortFaces && doDepthTest && vertexBuffer->FaceCount > 1;
 
-    // Get the face depth and vertices' start index
+    // Get the vertices' start index
     Uint32 verticesStartIndex = 0;
-    for (Uint32 f = 0; f < vertexBuffer->FaceCount; f++) {
-        Uint32 vertexCount = faceInfoPtr->NumVertices;
-
-        // Average the Z coordinates of the face
-        if (sortFaces) {
-            Sint64 depth = vertexAttribsPtr[0].Position.Z;
-            for (Uint32 i = 1; i < vertexCount; i++)
-                depth += vertexAttribsPtr[i].Position.Z;
-
-            faceInfoPtr->Depth = depth / vertexCount;
-            vertexAttribsPtr += vertexCount;
-        }
-
-        faceInfoPtr->DrawMode |= drawMode;
+    for (Uint32 f = 0; f < vertexBuffer->FaceCount; f++, faceInfoPtr++) {
         faceInfoPtr->VerticesStartIndex = verticesStartIndex;
-        verticesStartIndex += vertexCount;
+        verticesStartIndex += faceInfoPtr->NumVertices;
+
+        if ((faceInfoPtr->DrawMode | drawMode) & (DrawMode_LINES | DrawMode_POINTS))
+            sortOpaqueFaces = false;
+    }
 
-        faceInfoPtr++;
+    // Every face can be set up on its own, so large scenes are split
+    // between the draw threads.
+    FaceSetup.Buffer = vertexBuffer;
+    FaceSetup.DrawMode = drawMode;
+    FaceSetup.ConvertColors = Graphics::PreferredPixelFormat != SDL_PIXELFORMAT_ARGB8888;
+    FaceSetup.AverageDepth = sortFaces || sortOpaqueFaces;
+    FaceSetup.JobCount = vertexBuffer->FaceCount / MIN_FACES_PER_DRAW_THREAD;
+    if (FaceSetup.JobCount > DrawThreadCount)
+        FaceSetup.JobCount = DrawThreadCount;
+    if (FaceSetup.JobCount > 1)
+        RunDrawThreadJob(FaceSetupJob, FaceSetup.JobCount);
+    else {
+        FaceSetup.JobCount = 1;
+        FaceSetupJob(0);
     }
 
     // Sort face infos by depth
     if (sortFaces)
-        qsort(vertexBuffer->FaceInfoBuffer, vertexBuffer->FaceCount, sizeof(FaceInfo), PolygonRenderer::FaceSortFunction);
+        PolygonRenderer::SortFaces(vertexBuffer->FaceInfoBuffer, vertexBuffer->FaceCount, false);
+    else if (sortOpaqueFaces)
+        PolygonRenderer::SortFaces(vertexBuffer->FaceInfoBuffer, vertexBuffer->FaceCount, true);
 
     // sas
     for (Uint32 f = 0; f < vertexBuffer->FaceCount; f++) {
@@ -1063,6 +1939,21 @@ PUBLIC STATIC void     SoftwareRenderer::DrawScene3D(Uint32 sceneIndex, Uint32 d
         else
             PolygonRasterizer::SetUseFog(false);
 
+        switch (faceInfoPtr->DrawMode & DrawMode_SubdivideMask) {
+            case DrawMode_SUBDIVIDE_8:
+                PolygonRasterizer::SetPerspectiveSubdivision(8);
+                break;
+            case DrawMode_SUBDIVIDE_16:
+                PolygonRasterizer::SetPerspectiveSubdivision(16);
+                break;
+            case DrawMode_SUBDIVIDE_32:
+                PolygonRasterizer::SetPerspectiveSubdivision(32);
+                break;
+            default:
+                PolygonRasterizer::SetPerspectiveSubdivision(0);
+                break;
+        }
+
         switch (faceInfoPtr->DrawMode & DrawMode_FillTypeMask) {
             // Lines, Solid Colored
             case DrawMode_LINES:
@@ -1384,22 +2275,32 @@ PRIVATE STATIC bool     SoftwareRenderer::SetupPolygonRenderer(Matrix4x4* modelM
 }
 
 PUBLIC STATIC void     SoftwareRenderer::DrawPolygon3D(void* data, int vertexCount, int vertexFlag, Texture* texture, Matrix4x4* modelMatrix, Matrix4x4* normalMatrix) {
+    SoftwareRenderer::FlushCommands();
+
     if (SetupPolygonRenderer(modelMatrix, normalMatrix))
         polygonRenderer.DrawPolygon3D((VertexAttribute*)data, vertexCount, vertexFlag, texture);
 }
 PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer3D(void* layer, int sx, int sy, int sw, int sh, Matrix4x4* modelMatrix, Matrix4x4* normalMatrix) {
+    SoftwareRenderer::FlushCommands();
+
     if (SetupPolygonRenderer(modelMatrix, normalMatrix))
         polygonRenderer.DrawSceneLayer3D((SceneLayer*)layer, sx, sy, sw, sh);
 }
 PUBLIC STATIC void     SoftwareRenderer::DrawModel(void* model, Uint16 animation, Uint32 frame, Matrix4x4* modelMatrix, Matrix4x4* normalMatrix) {
+    SoftwareRenderer::FlushCommands();
+
     if (SetupPolygonRenderer(modelMatrix, normalMatrix))
         polygonRenderer.DrawModel((IModel*)model, animation, frame);
 }
 PUBLIC STATIC void     SoftwareRenderer::DrawModelSkinned(void* model, Uint16 armature, Matrix4x4* modelMatrix, Matrix4x4* normalMatrix) {
+    SoftwareRenderer::FlushCommands();
+
     if (SetupPolygonRenderer(modelMatrix, normalMatrix))
         polygonRenderer.DrawModelSkinned((IModel*)model, armature);
 }
 PUBLIC STATIC void     SoftwareRenderer::DrawVertexBuffer(Uint32 vertexBufferIndex, Matrix4x4* modelMatrix, Matrix4x4* normalMatrix) {
+    SoftwareRenderer::FlushCommands();
+
     if (Graphics::CurrentScene3D < 0 || vertexBufferIndex < 0 || vertexBufferIndex >= MAX_VERTEX_BUFFERS)
         return;
 
@@ -1495,6 +2396,8 @@ PUBLIC STATIC void     SoftwareRenderer::SetLineWidth(float n) {
 
 }
 PUBLIC STATIC void     SoftwareRenderer::StrokeLine(float x1, float y1, float x2, float y2) {
+    SoftwareRenderer::FlushCommands();
+
     int x = 0, y = 0;
     Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
     Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
@@ -1540,6 +2443,8 @@ PUBLIC STATIC void     SoftwareRenderer::StrokeLine(float x1, float y1, float x2
     DoLineStrokeBounded(dst_x1, dst_y1, dst_x2, dst_y2, minX, maxX, minY, maxY, pixelFunction, ColRGB, blendState, multTableAt, multSubTableAt, dstPx, dstStride);
 }
 PUBLIC STATIC void     SoftwareRenderer::StrokeCircle(float x, float y, float rad) {
+    SoftwareRenderer::FlushCommands();
+
     Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
     Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
 
@@ -1631,6 +2536,8 @@ PUBLIC STATIC void     SoftwareRenderer::StrokeEllipse(float x, float y, float w
 
 }
 PUBLIC STATIC void     SoftwareRenderer::StrokeRectangle(float x, float y, float w, float h) {
+    SoftwareRenderer::FlushCommands();
+
     Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
     Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
 
@@ -1699,6 +2606,8 @@ PUBLIC STATIC void     SoftwareRenderer::StrokeRectangle(float x, float y, float
 }
 
 PUBLIC STATIC void     SoftwareRenderer::FillCircle(float x, float y, float rad) {
+    SoftwareRenderer::FlushCommands();
+
     // just checks to see if the pixel is within a radius range, uses a bounding box constructed by the diameter
 
     Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
@@ -1830,27 +2739,18 @@ PUBLIC STATIC void     SoftwareRenderer::FillCircle(float x, float y, float rad)
 PUBLIC STATIC void     SoftwareRenderer::FillEllipse(float x, float y, float w, float h) {
 
 }
-PUBLIC STATIC void     SoftwareRenderer::FillRectangle(float x, float y, float w, float h) {
-    Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
-    Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
-
-    View* currentView = Graphics::CurrentView;
-    if (!currentView)
+void FillRectangleImage(int dst_x1, int dst_y1, int dst_x2, int dst_y2, Uint32 col, BlendState blendState) {
+    if (ShouldRecordCommand()) {
+        DrawCommand* command = AddDrawCommand(DrawCommand_Rectangle);
+        int args[] = { dst_x1, dst_y1, dst_x2, dst_y2, (int)col };
+        memcpy(command->Args, args, sizeof(args));
+        command->Blend = blendState;
         return;
+    }
 
-    int cx = (int)std::floor(currentView->X);
-    int cy = (int)std::floor(currentView->Y);
-
-    Matrix4x4* out = Graphics::ModelViewMatrix;
-    x += out->Values[12];
-    y += out->Values[13];
-    x -= cx;
-    y -= cy;
-
-    int dst_x1 = x;
-    int dst_y1 = y;
-    int dst_x2 = x + w;
-    int dst_y2 = y + h;
+    Texture* renderTarget = GetRenderTarget();
+    Uint32* dstPx = (Uint32*)renderTarget->Pixels;
+    Uint32  dstStride = renderTarget->Width;
 
     int clip_x1, clip_y1, clip_x2, clip_y2;
     GetClipRegion(clip_x1, clip_y1, clip_x2, clip_y2);
@@ -1869,19 +2769,17 @@ PUBLIC STATIC void     SoftwareRenderer::FillRectangle(float x, float y, float w
     if (dst_x2 < 0 || dst_y2 < 0 || dst_x1 >= dst_x2 || dst_y1 >= dst_y2)
         return;
 
-    BlendState blendState = GetBlendState();
-    if (!AlterBlendState(blendState))
+    if (!SoftwareRenderer::AlterBlendState(blendState))
         return;
 
-    Uint32 col = ColRGB;
     int blendFlag = blendState.Mode;
     int opacity = blendState.Opacity;
 
     if (blendFlag & (BlendFlag_TINT_BIT | BlendFlag_FILTER_BIT))
-        SetTintFunction(blendFlag);
+        SoftwareRenderer::SetTintFunction(blendFlag);
 
-    int* multTableAt = &MultTable[opacity << 8];
-    int* multSubTableAt = &MultSubTable[opacity << 8];
+    int* multTableAt = &SoftwareRenderer::MultTable[opacity << 8];
+    int* multSubTableAt = &SoftwareRenderer::MultSubTable[opacity << 8];
     int dst_strideY = dst_y1 * dstStride;
 
     if (!UseStencil && (blendFlag & (BlendFlag_MODE_MASK | BlendFlag_TINT_BIT) == BlendFlag_OPAQUE)) {
@@ -1890,8 +2788,30 @@ PUBLIC STATIC void     SoftwareRenderer::FillRectangle(float x, float y, float w
             dst_strideY += dstStride;
         }
     }
+    else if (UseSIMD) {
+        PixelFunction pixelFunction = SoftwareRenderer::GetPixelFunction(blendFlag);
+        bool useMasks = pixelFunction != CurrentPixelFunction;
+
+        Uint32 colors[SPAN_CHUNK];
+        Uint8  mask[SPAN_CHUNK];
+        for (int dst_y = dst_y1; dst_y < dst_y2; dst_y++) {
+            for (int dst_x = dst_x1; dst_x < dst_x2; dst_x += SPAN_CHUNK) {
+                int count = dst_x2 - dst_x;
+                if (count > SPAN_CHUNK)
+                    count = SPAN_CHUNK;
+
+                // DrawSpan may tint the colors in place
+                for (int i = 0; i < count; i++)
+                    colors[i] = col;
+                memset(mask, 1, count);
+
+                DrawSpan(blendFlag, colors, mask, &dstPx[dst_x + dst_strideY], count, blendState, useMasks);
+            }
+            dst_strideY += dstStride;
+        }
+    }
     else {
-        PixelFunction pixelFunction = GetPixelFunction(blendFlag);
+        PixelFunction pixelFunction = SoftwareRenderer::GetPixelFunction(blendFlag);
 
         for (int dst_y = dst_y1; dst_y < dst_y2; dst_y++) {
             for (int dst_x = dst_x1; dst_x < dst_x2; dst_x++) {
@@ -1901,7 +2821,25 @@ PUBLIC STATIC void     SoftwareRenderer::FillRectangle(float x, float y, float w
         }
     }
 }
+PUBLIC STATIC void     SoftwareRenderer::FillRectangle(float x, float y, float w, float h) {
+    View* currentView = Graphics::CurrentView;
+    if (!currentView)
+        return;
+
+    int cx = (int)std::floor(currentView->X);
+    int cy = (int)std::floor(currentView->Y);
+
+    Matrix4x4* out = Graphics::ModelViewMatrix;
+    x += out->Values[12];
+    y += out->Values[13];
+    x -= cx;
+    y -= cy;
+
+    FillRectangleImage(x, y, x + w, y + h, ColRGB, GetBlendState());
+}
 PUBLIC STATIC void     SoftwareRenderer::FillTriangle(float x1, float y1, float x2, float y2, float x3, float y3) {
+    SoftwareRenderer::FlushCommands();
+
     View* currentView = Graphics::CurrentView;
     if (!currentView)
         return;
@@ -1924,6 +2862,8 @@ PUBLIC STATIC void     SoftwareRenderer::FillTriangle(float x1, float y1, float
     PolygonRasterizer::DrawBasic(vectors, ColRGB, 3, GetBlendState());
 }
 PUBLIC STATIC void     SoftwareRenderer::FillTriangleBlend(float x1, float y1, float x2, float y2, float x3, float y3, int c1, int c2, int c3) {
+    SoftwareRenderer::FlushCommands();
+
     View* currentView = Graphics::CurrentView;
     if (!currentView)
         return;
@@ -1947,6 +2887,8 @@ PUBLIC STATIC void     SoftwareRenderer::FillTriangleBlend(float x1, float y1, f
     PolygonRasterizer::DrawBasicBlend(vectors, colors, 3, GetBlendState());
 }
 PUBLIC STATIC void     SoftwareRenderer::FillQuadBlend(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, int c1, int c2, int c3, int c4) {
+    SoftwareRenderer::FlushCommands();
+
     View* currentView = Graphics::CurrentView;
     if (!currentView)
         return;
@@ -1972,12 +2914,22 @@ PUBLIC STATIC void     SoftwareRenderer::FillQuadBlend(float x1, float y1, float
 }
 
 void DrawSpriteImage(Texture* texture, int x, int y, int w, int h, int sx, int sy, int flipFlag, BlendState blendState) {
+    if (ShouldRecordCommand()) {
+        DrawCommand* command = AddDrawCommand(DrawCommand_SpriteImage);
+        int args[] = { x, y, w, h, sx, sy, flipFlag };
+        memcpy(command->Args, args, sizeof(args));
+        command->Source = texture;
+        command->Blend = blendState;
+        return;
+    }
+
     Uint32* srcPx = (Uint32*)texture->Pixels;
     Uint32  srcStride = texture->Width;
     Uint32* srcPxLine;
 
-    Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
-    Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
+    Texture* renderTarget = GetRenderTarget();
+    Uint32* dstPx = (Uint32*)renderTarget->Pixels;
+    Uint32  dstStride = renderTarget->Width;
     Uint32* dstPxLine;
 
     int src_x1 = sx;
@@ -1990,7 +2942,7 @@ void DrawSpriteImage(Texture* texture, int x, int y, int w, int h, int sx, int s
     int dst_x2 = x + w;
     int dst_y2 = y + h;
 
-    if (!Graphics::TextureBlend) {
+    if (!GetTextureBlend()) {
         blendState.Mode = BlendMode_NORMAL;
         blendState.Opacity = 0xFF;
     }
@@ -2126,7 +3078,68 @@ void DrawSpriteImage(Texture* texture, int x, int y, int w, int h, int sx, int s
     int* multSubTableAt = &SoftwareRenderer::MultSubTable[opacity << 8];
     Sint32* deformValues = &SoftwareRenderer::SpriteDeformBuffer[dst_y1];
 
-    if (Graphics::UsePalettes && texture->Paletted) {
+    bool paletted = GetUsePalettes() && texture->Paletted;
+
+    // Without a stencil or dot mask, draw whole rows with a span kernel.
+    // With SIMD, rows that blend (or need masking) go through DrawSpriteRow.
+    bool useMasks = pixelFunction != CurrentPixelFunction;
+    bool useRows = false;
+    if (UseSIMD) {
+        switch (blendFlag & (BlendFlag_MODE_MASK | BlendFlag_TINT_BIT)) {
+            case BlendFlag_TRANSPARENT:
+            case BlendFlag_ADDITIVE:
+            case BlendFlag_SUBTRACT:
+                useRows = true;
+                break;
+            default:
+                useRows = useMasks;
+                break;
+        }
+    }
+
+    if (!useMasks || useRows) {
+        bool flipX = flipFlag & 1;
+        SpriteSpanFunction spanFunction = SpriteSpanFunctions[blendFlag & BlendFlag_MODE_MASK][!!(blendFlag & BlendFlag_TINT_BIT)][paletted][flipX];
+
+        int srcLineX = flipX ? src_x2 : src_x1;
+        src_strideY = ((flipFlag & 2) ? src_y2 : src_y1) * srcStride;
+        int srcLineStep = (flipFlag & 2) ? -(int)srcStride : (int)srcStride;
+        dst_strideY = dst_y1 * dstStride;
+        index = NULL;
+
+        for (int dst_y = dst_y1; dst_y < dst_y2; dst_y++) {
+            int span_x1 = dst_x1;
+            int span_x2 = dst_x2;
+            int src_x = srcLineX;
+
+            // Deforming shifts the whole row, which is then clipped again
+            if (SoftwareRenderer::UseSpriteDeform) {
+                span_x1 += *deformValues;
+                span_x2 += *deformValues;
+                if (span_x1 < clip_x1) {
+                    src_x += flipX ? span_x1 - clip_x1 : clip_x1 - span_x1;
+                    span_x1 = clip_x1;
+                }
+                if (span_x2 > clip_x2)
+                    span_x2 = clip_x2;
+            }
+
+            if (paletted)
+                index = &Graphics::PaletteColors[Graphics::PaletteIndexLines[dst_y]][0];
+
+            if (span_x1 < span_x2) {
+                if (useRows)
+                    DrawSpriteRow(blendFlag, srcPx + src_strideY + src_x, flipX, index, dstPx + dst_strideY + span_x1, span_x2 - span_x1, blendState, useMasks);
+                else
+                    spanFunction(srcPx + src_strideY + src_x, dstPx + dst_strideY + span_x1, span_x2 - span_x1, index, blendState, multTableAt, multSubTableAt);
+            }
+
+            dst_strideY += dstStride;
+            src_strideY += srcLineStep;
+            deformValues++;
+        }
+    }
+    else if (paletted) {
         switch (flipFlag) {
             case 0:
                 dst_strideY = dst_y1 * dstStride;
@@ -2183,11 +3196,21 @@ void DrawSpriteImage(Texture* texture, int x, int y, int w, int h, int sx, int s
     #undef DRAW_FLIPXY
 }
 void DrawSpriteImageTransformed(Texture* texture, int x, int y, int offx, int offy, int w, int h, int sx, int sy, int sw, int sh, int flipFlag, int rotation, BlendState blendState) {
+    if (ShouldRecordCommand()) {
+        DrawCommand* command = AddDrawCommand(DrawCommand_SpriteImageTransformed);
+        int args[] = { x, y, offx, offy, w, h, sx, sy, sw, sh, flipFlag, rotation };
+        memcpy(command->Args, args, sizeof(args));
+        command->Source = texture;
+        command->Blend = blendState;
+        return;
+    }
+
     Uint32* srcPx = (Uint32*)texture->Pixels;
     Uint32  srcStride = texture->Width;
 
-    Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
-    Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
+    Texture* renderTarget = GetRenderTarget();
+    Uint32* dstPx = (Uint32*)renderTarget->Pixels;
+    Uint32  dstStride = renderTarget->Width;
     Uint32* dstPxLine;
 
     int src_x;
@@ -2220,7 +3243,7 @@ void DrawSpriteImageTransformed(Texture* texture, int x, int y, int offx, int of
     int dst_x2 = _x2;
     int dst_y2 = _y2;
 
-    if (!Graphics::TextureBlend) {
+    if (!GetTextureBlend()) {
         blendState.Mode = BlendMode_NORMAL;
         blendState.Opacity = 0xFF;
     }
@@ -2445,7 +3468,61 @@ void DrawSpriteImageTransformed(Texture* texture, int x, int y, int offx, int of
     int* multSubTableAt = &SoftwareRenderer::MultSubTable[opacity << 8];
     Sint32* deformValues = &SoftwareRenderer::SpriteDeformBuffer[dst_y1];
 
-    if (Graphics::UsePalettes && texture->Paletted) {
+    bool paletted = GetUsePalettes() && texture->Paletted;
+
+    // Without a stencil or dot mask, draw whole rows with a span kernel
+    if (pixelFunction == CurrentPixelFunction) {
+        SpriteTransformSpanFunction spanFunction = SpriteTransformSpanFunctions[blendFlag & BlendFlag_MODE_MASK][!!(blendFlag & BlendFlag_TINT_BIT)][paletted];
+
+        SpriteTransformRow row;
+        row.X1 = _x1;
+        row.Y1 = _y1;
+        row.X2 = _x2;
+        row.Y2 = _y2;
+        row.SrcX = (flipFlag & 1) ? src_x2 : src_x1;
+        row.SrcY = (flipFlag & 2) ? src_y2 : src_y1;
+        row.DirX = (flipFlag & 1) ? -1 : 1;
+        row.DirY = (flipFlag & 2) ? -1 : 1;
+        row.SrcW = sw;
+        row.SrcH = sh;
+        row.DstW = w;
+        row.DstH = h;
+        row.SrcPx = srcPx;
+        row.SrcStride = srcStride;
+        row.Cos = rcos;
+        row.Sin = rsin;
+
+        dst_strideY = dst_y1 * dstStride;
+        index = NULL;
+
+        for (int dst_y = dst_y1, i_y = dst_y1 - y; dst_y < dst_y2; dst_y++, i_y++) {
+            int span_x1 = dst_x1;
+            int span_x2 = dst_x2;
+            int i_x = dst_x1 - x;
+
+            // Deforming shifts the whole row, which is then clipped again
+            if (SoftwareRenderer::UseSpriteDeform) {
+                span_x1 += *deformValues;
+                span_x2 += *deformValues;
+                if (span_x1 < clip_x1) {
+                    i_x += clip_x1 - span_x1;
+                    span_x1 = clip_x1;
+                }
+                if (span_x2 > clip_x2)
+                    span_x2 = clip_x2;
+            }
+
+            if (paletted)
+                index = &Graphics::PaletteColors[Graphics::PaletteIndexLines[dst_y]][0];
+
+            if (span_x1 < span_x2)
+                spanFunction(row, i_x, i_y, dstPx + dst_strideY + span_x1, span_x2 - span_x1, index, blendState, multTableAt, multSubTableAt);
+
+            dst_strideY += dstStride;
+            deformValues++;
+        }
+    }
+    else if (paletted) {
         switch (flipFlag) {
             case 0:
                 dst_strideY = dst_y1 * dstStride;
@@ -2820,7 +3897,7 @@ PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer_HorizontalParallax(Scene
 
     BlendState blendState = GetBlendState();
 
-    if (!Graphics::TextureBlend) {
+    if (!GetTextureBlend()) {
         blendState.Mode = BlendMode_NORMAL;
         blendState.Opacity = 0xFF;
     }
@@ -2855,7 +3932,7 @@ PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer_HorizontalParallax(Scene
         Texture* texture = info.Sprite->Spritesheets[frameStr.SheetNumber];
         srcStrides[i] = srcStride = texture->Width;
         tileSources[i] = (&((Uint32*)texture->Pixels)[frameStr.X + frameStr.Y * srcStride]);
-        isPalettedSources[i] = Graphics::UsePalettes && texture->Paletted;
+        isPalettedSources[i] = GetUsePalettes() && texture->Paletted;
     }
 
     Uint32 DRAW_COLLISION = 0;
@@ -3135,6 +4212,140 @@ PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer_HorizontalParallax(Scene
         dst_strideY += dstStride;
     }
 }
+// Layers using a render cache have their tiles drawn into it ahead of time,
+// so drawing them only copies the lines out of it. This is done here and not
+// when the layer is drawn, since that can happen in several threads at once.
+PRIVATE STATIC void    SoftwareRenderer::PrepareLayerCache(SceneLayer* layer, View* currentView) {
+    if (!layer->UseRenderCache) {
+        if (layer->RenderCache) {
+            delete layer->RenderCache;
+            layer->RenderCache = NULL;
+        }
+        return;
+    }
+
+    if (!layer->RenderCache)
+        layer->RenderCache = new TileLayerCache();
+
+    TileLayerCache* cache = layer->RenderCache;
+    cache->Ready = false;
+
+    // Only plain repeating layers can be cached
+    if (!layer->Repeat || Scene::ShowTileCollisionFlag)
+        return;
+    if (layer->DrawBehavior != DrawBehavior_HorizontalParallax && layer->DrawBehavior != DrawBehavior_PGZ1_BG)
+        return;
+
+    int clip_x1, clip_y1, clip_x2, clip_y2;
+    GetClipRegion(clip_x1, clip_y1, clip_x2, clip_y2);
+    if (!CheckClipRegion(clip_x1, clip_y1, clip_x2, clip_y2))
+        return;
+
+    int span = ((int)currentView->Stride >> 4) << 4;
+    cache->Ready = cache->Update(layer, &TileScanLineBuffer[clip_y1], &Graphics::PaletteIndexLines[clip_y1], clip_y2 - clip_y1, span, GetUsePalettes());
+}
+PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer_Cached(SceneLayer* layer, View* currentView) {
+    int dst_x1 = 0;
+    int dst_y1 = 0;
+    int dst_x2 = (int)Graphics::CurrentRenderTarget->Width;
+    int dst_y2 = (int)Graphics::CurrentRenderTarget->Height;
+
+    Uint32* dstPx = (Uint32*)Graphics::CurrentRenderTarget->Pixels;
+    Uint32  dstStride = Graphics::CurrentRenderTarget->Width;
+
+    int clip_x1, clip_y1, clip_x2, clip_y2;
+    GetClipRegion(clip_x1, clip_y1, clip_x2, clip_y2);
+    if (!CheckClipRegion(clip_x1, clip_y1, clip_x2, clip_y2))
+        return;
+
+    if (dst_x1 < clip_x1)
+        dst_x1 = clip_x1;
+    if (dst_y1 < clip_y1)
+        dst_y1 = clip_y1;
+    if (dst_x2 > clip_x2)
+        dst_x2 = clip_x2;
+    if (dst_y2 > clip_y2)
+        dst_y2 = clip_y2;
+
+    if (dst_x2 < 0 || dst_y2 < 0 || dst_x1 >= dst_x2 || dst_y1 >= dst_y2)
+        return;
+
+    BlendState blendState = GetBlendState();
+
+    if (!GetTextureBlend()) {
+        blendState.Mode = BlendMode_NORMAL;
+        blendState.Opacity = 0xFF;
+    }
+
+    if (!AlterBlendState(blendState))
+        return;
+
+    int blendFlag = blendState.Mode;
+    int opacity = blendState.Opacity;
+    if (blendFlag & (BlendFlag_TINT_BIT | BlendFlag_FILTER_BIT))
+        SetTintFunction(blendFlag);
+
+    int* multTableAt = &MultTable[opacity << 8];
+    int* multSubTableAt = &MultSubTable[opacity << 8];
+
+    PixelFunction pixelFunction = GetPixelFunction(blendFlag);
+    bool canCopy = pixelFunction == SoftwareRenderer::PixelNoFiltSetOpaque;
+
+    TileLayerCache* cache = layer->RenderCache;
+    int span = ((int)currentView->Stride >> 4) << 4;
+
+    TileScanLine* tScanLine = &TileScanLineBuffer[dst_y1];
+    for (int dst_y = dst_y1; dst_y < dst_y2; dst_y++, tScanLine++) {
+        int srcX = (int)(tScanLine->SrcX >> 16);
+        int srcY = (int)(tScanLine->SrcY >> 16);
+
+        // Same amount of pixels a scanline of tiles would cover
+        int count = span - (srcX & 15);
+        if (count > dst_x2 - dst_x1)
+            count = dst_x2 - dst_x1;
+
+        bool isOpaque;
+        Uint32* cacheLine = cache->GetRow(srcY, &isOpaque);
+        int cacheX = cache->GetColumn(srcX);
+        Uint32* index = &Graphics::PaletteColors[Graphics::PaletteIndexLines[dst_y]][0];
+        Uint32* dst = &dstPx[dst_y * dstStride + dst_x1];
+
+        while (count > 0) {
+            int length = cache->Width - cacheX;
+            if (length > count)
+                length = count;
+
+            Uint32* src = &cacheLine[cacheX];
+            if (cache->Indexed) {
+                if (canCopy && isOpaque) {
+                    for (int i = 0; i < length; i++)
+                        dst[i] = index[src[i]];
+                }
+                else {
+                    for (int i = 0; i < length; i++) {
+                        if (src[i])
+                            pixelFunction(&index[src[i]], &dst[i], blendState, multTableAt, multSubTableAt);
+                    }
+                }
+            }
+            else {
+                if (canCopy && isOpaque) {
+                    memcpy(dst, src, length * sizeof(Uint32));
+                }
+                else {
+                    for (int i = 0; i < length; i++) {
+                        if (src[i])
+                            pixelFunction(&src[i], &dst[i], blendState, multTableAt, multSubTableAt);
+                    }
+                }
+            }
+
+            dst += length;
+            count -= length;
+            cacheX = 0;
+        }
+    }
+}
 PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer_VerticalParallax(SceneLayer* layer, View* currentView) {
 
 }
@@ -3193,7 +4404,7 @@ PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer_CustomTileScanLines(Scen
         texture = info.Sprite->Spritesheets[frameStr.SheetNumber];
         srcStrides[i] = srcStride = texture->Width;
         tileSources[i] = (&((Uint32*)texture->Pixels)[frameStr.X + frameStr.Y * srcStride]);
-        isPalettedSources[i] = Graphics::UsePalettes && texture->Paletted;
+        isPalettedSources[i] = GetUsePalettes() && texture->Paletted;
     }
 
     TileScanLine* scanLine = &TileScanLineBuffer[dst_y1];
@@ -3211,7 +4422,7 @@ PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer_CustomTileScanLines(Scen
         PixelFunction linePixelFunction = NULL;
 
         BlendState blendState = GetBlendState();
-        if (Graphics::TextureBlend) {
+        if (GetTextureBlend()) {
             blendState.Opacity -= 0xFF - scanLine->Opacity;
             if (blendState.Opacity < 0)
                 blendState.Opacity = 0;
@@ -3298,6 +4509,26 @@ PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer(SceneLayer* layer, View*
         SoftwareRenderer::DrawSceneLayer_InitTileScanLines(layer, currentView);
     }
 
+    SoftwareRenderer::PrepareLayerCache(layer, currentView);
+
+    if (ShouldRecordCommand()) {
+        DrawCommand* command = AddDrawCommand(DrawCommand_SceneLayer);
+        command->Layer = layer;
+        command->LayerView = currentView;
+
+        // The scanlines get overwritten by the next layer
+        SoftwareRenderer::FlushCommands();
+        return;
+    }
+
+    SoftwareRenderer::DrawSceneLayer_ScanLines(layer, currentView);
+}
+PUBLIC STATIC void     SoftwareRenderer::DrawSceneLayer_ScanLines(SceneLayer* layer, View* currentView) {
+    if (layer->RenderCache && layer->RenderCache->Ready) {
+        SoftwareRenderer::DrawSceneLayer_Cached(layer, currentView);
+        return;
+    }
+
     switch (layer->DrawBehavior) {
         case DrawBehavior_PGZ1_BG:
 		case DrawBehavior_HorizontalParallax:
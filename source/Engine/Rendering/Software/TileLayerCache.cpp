@@ -0,0 +1,326 @@
+#if INTERFACE
+#include <Engine/Includes/Standard.h>
+#include <Engine/Rendering/Enums.h>
+
+need_t SceneLayer;
+
+class TileLayerCache {
+private:
+    vector<Uint32*> Sources;
+    vector<Uint32>  SourceStrides;
+    vector<Uint8>   SourcePaletted;
+    Uint32          Palette[0x100];
+    int             PaletteIndex = -1;
+    Uint32          TileVersion = 0;
+    int             LayerWidth = 0;
+    int             LayerHeight = 0;
+    bool            Valid = false;
+
+public:
+    Uint32*         Pixels = NULL;
+    int*            RowGaps = NULL;
+    int             Width = 0;
+    int             Height = 0;
+    int             CellX = 0;
+    int             CellY = 0;
+    int             Column = 0;
+    int             Row = 0;
+    bool            Indexed = false;
+    bool            Ready = false;
+};
+#endif
+
+#include <Engine/Rendering/Software/TileLayerCache.h>
+#include <Engine/Diagnostics/Memory.h>
+#include <Engine/Graphics.h>
+#include <Engine/Scene.h>
+#include <Engine/Scene/SceneLayer.h>
+
+// Tiles kept on each side of the visible area, so that a scrolling layer
+// only needs to draw the few tiles coming into view.
+#define TILE_CACHE_MARGIN 4
+// Layers that would need a cache larger than this are drawn normally.
+#define TILE_CACHE_MAX_PIXELS (2048 * 1024)
+
+// The cache is a window into the layer, wrapping around in both directions
+// like a ring buffer: CellX/CellY is the layer tile at the window's top-left,
+// and Column/Row is where that tile is in the cache. Scrolling moves the
+// window and only draws the tiles that came into it.
+//
+// When every tile is paletted, the cache holds the palette indexes instead of
+// colors, so that palette changes don't need the tiles to be drawn again.
+// A value of 0 is a transparent pixel either way.
+static int WrapValue(int value, int size) {
+    value %= size;
+    if (value < 0)
+        value += size;
+    return value;
+}
+static int WrapDistance(int value, int size) {
+    value = WrapValue(value, size);
+    if (value >= (size + 1) / 2)
+        value -= size;
+    return value;
+}
+
+PUBLIC TileLayerCache::~TileLayerCache() {
+    Memory::Free(Pixels);
+    Memory::Free(RowGaps);
+}
+
+PRIVATE void TileLayerCache::Resize(int width, int height) {
+    Memory::Free(Pixels);
+    Memory::Free(RowGaps);
+
+    Width = width;
+    Height = height;
+    Pixels = (Uint32*)Memory::TrackedCalloc("TileLayerCache::Pixels", Width * Height, sizeof(Uint32));
+    RowGaps = (int*)Memory::TrackedMalloc("TileLayerCache::RowGaps", Height * sizeof(int));
+    for (int i = 0; i < Height; i++)
+        RowGaps[i] = Width;
+}
+
+PRIVATE void TileLayerCache::DrawTile(SceneLayer* layer, int cellX, int cellY) {
+    int cellsW = Width >> 4;
+    int cellsH = Height >> 4;
+    int cacheX = ((WrapValue(cellX - CellX, LayerWidth >> 4) + Column) % cellsW) << 4;
+    int cacheY = ((WrapValue(cellY - CellY, LayerHeight >> 4) + Row) % cellsH) << 4;
+
+    Uint32 tile = layer->Tiles[cellX + (cellY << layer->WidthInBits)];
+    Uint32 tileID = tile & TILE_IDENT_MASK;
+    bool isEmpty = tileID == (Uint32)Scene::EmptyTile || tileID >= Sources.size();
+    bool flipX = !!(tile & TILE_FLIPX_MASK);
+    int flipY = (tile & TILE_FLIPY_MASK) ? 15 : 0;
+
+    for (int y = 0; y < 16; y++) {
+        Uint32* dst = &Pixels[(cacheY + y) * Width + cacheX];
+        int gaps = 0;
+        for (int x = 0; x < 16; x++)
+            gaps -= !dst[x];
+
+        if (isEmpty) {
+            memset(dst, 0, 16 * sizeof(Uint32));
+        }
+        else {
+            Uint32* color = &Sources[tileID][(y ^ flipY) * SourceStrides[tileID]];
+            for (int x = 0; x < 16; x++) {
+                Uint32 px = color[flipX ? 15 - x : x];
+                if (SourcePaletted[tileID])
+                    dst[x] = (px && !Indexed) ? Palette[px] : px;
+                else
+                    dst[x] = (px & 0xFF000000U) ? px : 0;
+            }
+        }
+
+        for (int x = 0; x < 16; x++)
+            gaps += !dst[x];
+        RowGaps[cacheY + y] += gaps;
+    }
+}
+PRIVATE void TileLayerCache::DrawTiles(SceneLayer* layer, int cellX, int cellY, int cellsW, int cellsH) {
+    for (int y = 0; y < cellsH; y++) {
+        for (int x = 0; x < cellsW; x++)
+            DrawTile(layer, WrapValue(cellX + x, LayerWidth >> 4), WrapValue(cellY + y, LayerHeight >> 4));
+    }
+}
+PRIVATE void TileLayerCache::DrawAll(SceneLayer* layer) {
+    DrawTiles(layer, CellX, CellY, Width >> 4, Height >> 4);
+}
+
+// Moves the window so that it starts at the given cell, drawing the tiles
+// that weren't in it before.
+PRIVATE void TileLayerCache::ScrollX(SceneLayer* layer, int cellX) {
+    int cellsW = Width >> 4;
+    int shift = WrapDistance(cellX - CellX, LayerWidth >> 4);
+    if (shift == 0)
+        return;
+
+    if (shift >= cellsW || -shift >= cellsW) {
+        CellX = WrapValue(cellX, LayerWidth >> 4);
+        DrawAll(layer);
+        return;
+    }
+
+    int oldCellX = CellX;
+    Column = WrapValue(Column + shift, cellsW);
+    CellX = WrapValue(cellX, LayerWidth >> 4);
+    if (shift > 0)
+        DrawTiles(layer, oldCellX + cellsW, CellY, shift, Height >> 4);
+    else
+        DrawTiles(layer, CellX, CellY, -shift, Height >> 4);
+}
+PRIVATE void TileLayerCache::ScrollY(SceneLayer* layer, int cellY) {
+    int cellsH = Height >> 4;
+    int shift = WrapDistance(cellY - CellY, LayerHeight >> 4);
+    if (shift == 0)
+        return;
+
+    if (shift >= cellsH || -shift >= cellsH) {
+        CellY = WrapValue(cellY, LayerHeight >> 4);
+        DrawAll(layer);
+        return;
+    }
+
+    int oldCellY = CellY;
+    Row = WrapValue(Row + shift, cellsH);
+    CellY = WrapValue(cellY, LayerHeight >> 4);
+    if (shift > 0)
+        DrawTiles(layer, CellX, oldCellY + cellsH, Width >> 4, shift);
+    else
+        DrawTiles(layer, CellX, CellY, Width >> 4, -shift);
+}
+
+// Returns the cells the window must start at for the given range of the
+// layer to be in it, or the current one if it already is.
+PRIVATE STATIC int TileLayerCache::GetWindowStart(int current, int start, int count, int windowSize, int layerSize) {
+    if (windowSize >= layerSize)
+        return 0;
+
+    int offset = WrapDistance(start - current, layerSize);
+    if (offset >= 0 && offset + count <= windowSize)
+        return current;
+
+    return WrapValue(start - (windowSize - count) / 2, layerSize);
+}
+
+// Gets the cache ready for the given scanlines, each of which shows "span"
+// pixels of the layer using the palette in paletteLines. Returns false if
+// the cache can't be used for them.
+PUBLIC bool TileLayerCache::Update(SceneLayer* layer, TileScanLine* scanLines, Uint8* paletteLines, int lineCount, int span, bool usePalettes) {
+    int layerWidth = layer->Width * 16;
+    int layerHeight = layer->Height * 16;
+    if (layerWidth <= 0 || layerHeight <= 0 || lineCount <= 0)
+        return false;
+
+    // Find the area of the layer the scanlines cover
+    int startX = WrapValue((int)(scanLines[0].SrcX >> 16), layerWidth);
+    int startY = WrapValue((int)(scanLines[0].SrcY >> 16), layerHeight);
+    int minX = 0, maxX = 0, minY = 0, maxY = 0;
+    for (int i = 1; i < lineCount; i++) {
+        int dx = WrapDistance((int)(scanLines[i].SrcX >> 16) - startX, layerWidth);
+        int dy = WrapDistance((int)(scanLines[i].SrcY >> 16) - startY, layerHeight);
+        if (minX > dx) minX = dx;
+        if (maxX < dx) maxX = dx;
+        if (minY > dy) minY = dy;
+        if (maxY < dy) maxY = dy;
+    }
+
+    int cellX1 = (startX + minX) >> 4;
+    int cellY1 = (startY + minY) >> 4;
+    int cellsNeededW = ((startX + maxX + span + 15) >> 4) - cellX1;
+    int cellsNeededH = ((startY + maxY + 16) >> 4) - cellY1;
+
+    int cellsW = cellsNeededW + TILE_CACHE_MARGIN * 2;
+    int cellsH = cellsNeededH + TILE_CACHE_MARGIN * 2;
+    if (cellsW > layer->Width)
+        cellsW = layer->Width;
+    if (cellsH > layer->Height)
+        cellsH = layer->Height;
+    if (cellsW < cellsNeededW && cellsW != layer->Width)
+        return false;
+    if (cellsH < cellsNeededH && cellsH != layer->Height)
+        return false;
+    if (cellsW * cellsH * 256 > TILE_CACHE_MAX_PIXELS)
+        return false;
+
+    // Check what the tiles look like now
+    size_t tileCount = Scene::TileSpriteInfos.size();
+    bool indexed = usePalettes;
+    vector<Uint32*> sources(tileCount);
+    vector<Uint32> sourceStrides(tileCount);
+    vector<Uint8> sourcePaletted(tileCount);
+    for (size_t i = 0; i < tileCount; i++) {
+        TileSpriteInfo info = Scene::TileSpriteInfos[i];
+        AnimFrame frameStr = info.Sprite->Animations[info.AnimationIndex].Frames[info.FrameIndex];
+        Texture* texture = info.Sprite->Spritesheets[frameStr.SheetNumber];
+        sourceStrides[i] = texture->Width;
+        sources[i] = &((Uint32*)texture->Pixels)[frameStr.X + frameStr.Y * texture->Width];
+        sourcePaletted[i] = usePalettes && texture->Paletted;
+        if (!sourcePaletted[i])
+            indexed = false;
+    }
+
+    // Non-indexed caches have the palette baked in. Those can only be used
+    // when every line has the same palette.
+    int paletteIndex = paletteLines[0];
+    if (!indexed) {
+        for (int i = 1; i < lineCount; i++) {
+            if (paletteLines[i] != paletteIndex)
+                return false;
+        }
+    }
+
+    bool redraw = !Valid
+        || layerWidth != LayerWidth
+        || layerHeight != LayerHeight
+        || layer->TileVersion != TileVersion
+        || indexed != Indexed
+        || tileCount != Sources.size();
+    if (!indexed && (paletteIndex != PaletteIndex || memcmp(Palette, Graphics::PaletteColors[paletteIndex], sizeof(Palette))))
+        redraw = true;
+
+    // Tiles that changed their frame since they were drawn
+    vector<Uint8> changedTiles;
+    if (!redraw) {
+        for (size_t i = 0; i < tileCount; i++) {
+            if (sources[i] != Sources[i] || sourcePaletted[i] != SourcePaletted[i]) {
+                changedTiles.resize(tileCount);
+                changedTiles[i] = 1;
+            }
+        }
+    }
+
+    Sources.swap(sources);
+    SourceStrides.swap(sourceStrides);
+    SourcePaletted.swap(sourcePaletted);
+    memcpy(Palette, Graphics::PaletteColors[paletteIndex], sizeof(Palette));
+    PaletteIndex = paletteIndex;
+    TileVersion = layer->TileVersion;
+    LayerWidth = layerWidth;
+    LayerHeight = layerHeight;
+    Indexed = indexed;
+
+    if (Width < cellsW * 16 || Height < cellsH * 16 || Width > layerWidth || Height > layerHeight) {
+        Resize(cellsW * 16, cellsH * 16);
+        redraw = true;
+    }
+
+    int windowX = GetWindowStart(CellX, cellX1, cellsNeededW, Width >> 4, layer->Width);
+    int windowY = GetWindowStart(CellY, cellY1, cellsNeededH, Height >> 4, layer->Height);
+
+    if (redraw) {
+        CellX = windowX;
+        CellY = windowY;
+        Column = Row = 0;
+        DrawAll(layer);
+        Valid = true;
+        return true;
+    }
+
+    if (changedTiles.size()) {
+        for (int y = 0; y < (Height >> 4); y++) {
+            for (int x = 0; x < (Width >> 4); x++) {
+                int cellX = WrapValue(CellX + x, layer->Width);
+                int cellY = WrapValue(CellY + y, layer->Height);
+                Uint32 tileID = layer->Tiles[cellX + (cellY << layer->WidthInBits)] & TILE_IDENT_MASK;
+                if (tileID < tileCount && changedTiles[tileID])
+                    DrawTile(layer, cellX, cellY);
+            }
+        }
+    }
+
+    ScrollX(layer, windowX);
+    ScrollY(layer, windowY);
+    return true;
+}
+
+// Gets the cached row showing the given line of the layer.
+PUBLIC Uint32* TileLayerCache::GetRow(int y, bool* opaque) {
+    int row = (WrapValue(y - (CellY << 4), LayerHeight) + (Row << 4)) % Height;
+    *opaque = RowGaps[row] == 0;
+    return &Pixels[row * Width];
+}
+// Gets the cached column showing the given column of the layer.
+PUBLIC int     TileLayerCache::GetColumn(int x) {
+    return (WrapValue(x - (CellX << 4), LayerWidth) + (Column << 4)) % Width;
+}
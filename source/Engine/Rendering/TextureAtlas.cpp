@@ -0,0 +1,267 @@
+#if INTERFACE
+#include <Engine/Includes/Standard.h>
+#include <Engine/Rendering/Texture.h>
+
+class TextureAtlas {
+private:
+    struct SkylineNode {
+        int X;
+        int Y;
+        int Width;
+    };
+    struct Page {
+        Texture*            PageTexture;
+        vector<SkylineNode> Skyline;
+    };
+    struct Region {
+        Texture*            PageTexture;
+        int                 X;
+        int                 Y;
+        int                 Width;
+        int                 Height;
+    };
+
+    static vector<Page>                            Pages;
+    static vector<Region>                          Regions;
+    static std::unordered_map<std::string, size_t> RegionsByName;
+    static int                                     PageWidth;
+    static int                                     PageHeight;
+
+public:
+    static bool                                    Enabled;
+};
+#endif
+
+#include <Engine/Rendering/TextureAtlas.h>
+
+#include <Engine/Application.h>
+#include <Engine/Graphics.h>
+#include <Engine/Diagnostics/Log.h>
+#include <Engine/Diagnostics/Memory.h>
+#include <Engine/Rendering/Software/SoftwareRenderer.h>
+
+// Size of each atlas page, if the renderer allows it
+#define TEXTURE_ATLAS_PAGE_SIZE 2048
+// Images larger than this fraction of a page are kept as their own textures
+#define TEXTURE_ATLAS_MAX_IMAGE_DIVISOR 2
+// Empty space left around each image so filtering doesn't pick up its neighbors
+#define TEXTURE_ATLAS_PADDING 2
+
+vector<TextureAtlas::Page>              TextureAtlas::Pages;
+vector<TextureAtlas::Region>            TextureAtlas::Regions;
+std::unordered_map<std::string, size_t> TextureAtlas::RegionsByName;
+int                                     TextureAtlas::PageWidth = TEXTURE_ATLAS_PAGE_SIZE;
+int                                     TextureAtlas::PageHeight = TEXTURE_ATLAS_PAGE_SIZE;
+bool                                    TextureAtlas::Enabled = true;
+
+// Sprite sheets are packed into large shared pages as they are loaded, so
+// that sprites which are drawn together also share a texture. Pages are
+// filled with a bottom-left skyline packer, since images arrive one at a
+// time and a page can't be repacked once frames point into it.
+PUBLIC STATIC void     TextureAtlas::Init() {
+    Application::Settings->GetBool("display", "spriteAtlas", &Enabled);
+
+    PageWidth = TEXTURE_ATLAS_PAGE_SIZE;
+    PageHeight = TEXTURE_ATLAS_PAGE_SIZE;
+    if (Graphics::GfxFunctions != &SoftwareRenderer::BackendFunctions) {
+        if (PageWidth > (int)Graphics::MaxTextureWidth)
+            PageWidth = (int)Graphics::MaxTextureWidth;
+        if (PageHeight > (int)Graphics::MaxTextureHeight)
+            PageHeight = (int)Graphics::MaxTextureHeight;
+    }
+}
+PUBLIC STATIC void     TextureAtlas::Dispose() {
+    for (size_t i = 0; i < Pages.size(); i++)
+        Graphics::DisposeTexture(Pages[i].PageTexture);
+
+    Pages.clear();
+    Regions.clear();
+    RegionsByName.clear();
+}
+
+PRIVATE STATIC int     TextureAtlas::FitSkyline(Page* page, size_t index, int width, int height) {
+    int x = page->Skyline[index].X;
+    if (x + width > PageWidth)
+        return -1;
+
+    int y = 0;
+    int widthLeft = width;
+    for (size_t i = index; widthLeft > 0; i++) {
+        if (y < page->Skyline[i].Y)
+            y = page->Skyline[i].Y;
+        if (y + height > PageHeight)
+            return -1;
+
+        widthLeft -= page->Skyline[i].Width;
+    }
+    return y;
+}
+PRIVATE STATIC void    TextureAtlas::AddSkylineLevel(Page* page, size_t index, int x, int y, int width, int height) {
+    SkylineNode node;
+    node.X = x;
+    node.Y = y + height;
+    node.Width = width;
+    page->Skyline.insert(page->Skyline.begin() + index, node);
+
+    // Trim or remove the nodes now underneath the new one
+    for (size_t i = index + 1; i < page->Skyline.size(); i++) {
+        SkylineNode* prev = &page->Skyline[i - 1];
+        SkylineNode* cur = &page->Skyline[i];
+        if (cur->X >= prev->X + prev->Width)
+            break;
+
+        int shrink = prev->X + prev->Width - cur->X;
+        cur->X += shrink;
+        cur->Width -= shrink;
+        if (cur->Width > 0)
+            break;
+
+        page->Skyline.erase(page->Skyline.begin() + i);
+        i--;
+    }
+
+    // Merge neighbors at the same height
+    for (size_t i = 0; i + 1 < page->Skyline.size(); i++) {
+        if (page->Skyline[i].Y == page->Skyline[i + 1].Y) {
+            page->Skyline[i].Width += page->Skyline[i + 1].Width;
+            page->Skyline.erase(page->Skyline.begin() + i + 1);
+            i--;
+        }
+    }
+}
+PRIVATE STATIC bool    TextureAtlas::Insert(Page* page, int width, int height, int* outX, int* outY) {
+    int bestY = INT_MAX;
+    int bestWidth = INT_MAX;
+    int bestIndex = -1;
+    for (size_t i = 0; i < page->Skyline.size(); i++) {
+        int y = FitSkyline(page, i, width, height);
+        if (y < 0)
+            continue;
+
+        // Prefer the lowest spot, then the narrowest ledge
+        if (y + height < bestY || (y + height == bestY && page->Skyline[i].Width < bestWidth)) {
+            bestY = y + height;
+            bestWidth = page->Skyline[i].Width;
+            bestIndex = (int)i;
+            *outX = page->Skyline[i].X;
+            *outY = y;
+        }
+    }
+    if (bestIndex < 0)
+        return false;
+
+    AddSkylineLevel(page, bestIndex, *outX, *outY, width, height);
+    return true;
+}
+PRIVATE STATIC bool    TextureAtlas::AddPage() {
+    Texture* texture = Graphics::CreateTexture(SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, PageWidth, PageHeight);
+    if (!texture)
+        return false;
+
+    // Clear the whole page once, so the padding between images is transparent
+    SDL_Rect rect = { 0, 0, PageWidth, PageHeight };
+    Graphics::UpdateTextureRect(texture, &rect, texture->Pixels, PageWidth * sizeof(Uint32));
+
+    Page page;
+    page.PageTexture = texture;
+    page.Skyline.push_back(SkylineNode { 0, 0, PageWidth });
+    Pages.push_back(page);
+
+    Log::Print(Log::LOG_VERBOSE, "Created texture atlas page %d (%d x %d)", (int)Pages.size() - 1, PageWidth, PageHeight);
+
+    return true;
+}
+
+// Packs an RGBA image into an atlas page and returns that page, or NULL if
+// the image should get its own texture. If a filename is given, later calls
+// to Find with it will return the same region.
+PUBLIC STATIC Texture* TextureAtlas::Add(const char* filename, Uint32* pixels, int width, int height, int* outX, int* outY) {
+    if (!Enabled || !pixels || width <= 0 || height <= 0)
+        return NULL;
+    if (width > PageWidth / TEXTURE_ATLAS_MAX_IMAGE_DIVISOR || height > PageHeight / TEXTURE_ATLAS_MAX_IMAGE_DIVISOR)
+        return NULL;
+
+    int paddedWidth = width + TEXTURE_ATLAS_PADDING;
+    int paddedHeight = height + TEXTURE_ATLAS_PADDING;
+
+    Page* page = NULL;
+    int x = 0, y = 0;
+    for (size_t i = 0; i < Pages.size(); i++) {
+        if (Insert(&Pages[i], paddedWidth, paddedHeight, &x, &y)) {
+            page = &Pages[i];
+            break;
+        }
+    }
+    if (!page) {
+        if (!AddPage())
+            return NULL;
+
+        page = &Pages.back();
+        if (!Insert(page, paddedWidth, paddedHeight, &x, &y))
+            return NULL;
+    }
+
+    SDL_Rect rect = { x, y, width, height };
+    Graphics::UpdateTextureRect(page->PageTexture, &rect, pixels, width * sizeof(Uint32));
+
+    Region region;
+    region.PageTexture = page->PageTexture;
+    region.X = x;
+    region.Y = y;
+    region.Width = width;
+    region.Height = height;
+    if (filename)
+        RegionsByName[filename] = Regions.size();
+    Regions.push_back(region);
+
+    *outX = x;
+    *outY = y;
+    return page->PageTexture;
+}
+PUBLIC STATIC Texture* TextureAtlas::Find(const char* filename, int* outX, int* outY) {
+    auto it = RegionsByName.find(filename);
+    if (it == RegionsByName.end())
+        return NULL;
+
+    Region* region = &Regions[it->second];
+    *outX = region->X;
+    *outY = region->Y;
+    return region->PageTexture;
+}
+PUBLIC STATIC bool     TextureAtlas::IsPage(Texture* texture) {
+    if (!texture)
+        return false;
+
+    for (size_t i = 0; i < Pages.size(); i++) {
+        if (Pages[i].PageTexture == texture)
+            return true;
+    }
+    return false;
+}
+
+// Copies an image back out of an atlas page into a texture of its own.
+PUBLIC STATIC Texture* TextureAtlas::Extract(Texture* page, int x, int y) {
+    Region* region = NULL;
+    for (size_t i = 0; i < Regions.size(); i++) {
+        if (Regions[i].PageTexture == page && Regions[i].X == x && Regions[i].Y == y) {
+            region = &Regions[i];
+            break;
+        }
+    }
+    if (!region)
+        return NULL;
+
+    int width = region->Width;
+    int height = region->Height;
+    Uint32* pixels = (Uint32*)Memory::Malloc(width * height * sizeof(Uint32));
+    if (!pixels)
+        return NULL;
+
+    Uint32* src = (Uint32*)page->Pixels + x + y * page->Width;
+    for (int py = 0; py < height; py++)
+        memcpy(&pixels[py * width], &src[py * page->Width], width * sizeof(Uint32));
+
+    Texture* texture = Graphics::CreateTextureFromPixels(width, height, pixels, width * sizeof(Uint32));
+    Memory::Free(pixels);
+    return texture;
+}
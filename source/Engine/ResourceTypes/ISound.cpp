@@ -13,6 +13,9 @@ public:
 
     SoundFormat*      SoundData = NULL;
 
+    Uint8*            DeviceSamples = NULL;
+    Uint32            DeviceSampleCount = 0;
+
     char              Filename[256];
     bool              LoadFailed = false;
     bool              StreamFromFile = false;
@@ -24,6 +27,7 @@ public:
 #include <Engine/Diagnostics/Log.h>
 #include <Engine/Diagnostics/Memory.h>
 #include <Engine/Audio/AudioIncludes.h>
+#include <Engine/Audio/AudioManager.h>
 #include <Engine/Utilities/StringUtils.h>
 // Import sound formats
 #include <Engine/ResourceTypes/SoundFormats/OGG.h>
@@ -93,10 +97,110 @@ PUBLIC AudioPlayback* ISound::CreatePlayer() {
     AudioPlayback* playback = new AudioPlayback(Format, requiredSamples, BytesPerSample, AudioManager::BytesPerSample);
     playback->SoundData = SoundData;
     playback->OwnsSoundData = false;
+    playback->SharedSamples = DeviceSamples;
+    playback->SharedSampleCount = DeviceSampleCount;
+    if (DeviceSamples || !SoundData)
+        return playback;
+
+    // Give the player sound data of its own, so that it can be decoded on
+    // the decoder thread while this sound is played elsewhere.
+    SoundFormat* soundData = NULL;
+    if (SoundData->Samples.size() < (size_t)SoundData->TotalPossibleSamples) {
+        if (StringUtils::StrCaseStr(Filename, ".ogg"))
+            soundData = OGG::Load(Filename);
+        else if (StringUtils::StrCaseStr(Filename, ".wav"))
+            soundData = WAV::Load(Filename);
+    }
+    else {
+        // The samples themselves are still this sound's
+        soundData = new SoundFormat;
+        SoundData->CopySamples(soundData);
+    }
+
+    if (soundData) {
+        playback->SoundData = soundData;
+        playback->OwnsSoundData = true;
+    }
 
     return playback;
 }
 
+// Decodes short sounds fully and converts them to the device format once,
+// so that every channel playing them reads those samples directly instead
+// of copying and converting them again each time they're played.
+PUBLIC bool ISound::PreDecode() {
+    if (LoadFailed || !SoundData || DeviceSamples)
+        return false;
+    if (!AudioManager::AudioEnabled || AudioManager::PreDecodeLimit <= 0 || Format.freq <= 0)
+        return false;
+
+    size_t deviceSampleCount = (size_t)((Uint64)SoundData->TotalPossibleSamples * AudioManager::DeviceFormat.freq / Format.freq) + 1;
+    if (deviceSampleCount * AudioManager::BytesPerSample > (size_t)AudioManager::PreDecodeLimit * 1024)
+        return false;
+
+    double ticks = Clock::GetTicks();
+
+    SoundData->LoadAllSamples();
+    SoundData->Close();
+
+    size_t sampleCount = SoundData->Samples.size();
+    if (sampleCount == 0)
+        return false;
+
+    // Samples aren't always kept together, so gather them first
+    size_t inputSize = sampleCount * BytesPerSample;
+    Uint8* input = (Uint8*)Memory::Malloc(inputSize);
+    if (!input)
+        return false;
+
+    for (size_t i = 0; i < sampleCount; i++)
+        memcpy(input + i * BytesPerSample, SoundData->Samples[i], BytesPerSample);
+
+    Uint8* output = NULL;
+    size_t outputSize = 0;
+    if (Format.freq == AudioManager::DeviceFormat.freq
+    && Format.format == AudioManager::DeviceFormat.format
+    && Format.channels == AudioManager::DeviceFormat.channels) {
+        output = input;
+        outputSize = inputSize;
+        input = NULL;
+    }
+    else {
+        SDL_AudioStream* stream = SDL_NewAudioStream(Format.format, Format.channels, Format.freq,
+            AudioManager::DeviceFormat.format, AudioManager::DeviceFormat.channels, AudioManager::DeviceFormat.freq);
+        if (stream) {
+            if (SDL_AudioStreamPut(stream, input, (int)inputSize) == 0 && SDL_AudioStreamFlush(stream) == 0) {
+                outputSize = (size_t)SDL_AudioStreamAvailable(stream);
+                output = (Uint8*)Memory::Malloc(outputSize);
+                if (output)
+                    outputSize = (size_t)SDL_AudioStreamGet(stream, output, (int)outputSize);
+            }
+            SDL_FreeAudioStream(stream);
+        }
+        Memory::Free(input);
+
+        if (!output || outputSize == 0 || outputSize == (size_t)-1) {
+            Log::Print(Log::LOG_WARN, "Could not convert \"%s\" to the audio device format!", Filename);
+            Memory::Free(output);
+            return false;
+        }
+    }
+
+    DeviceSamples = output;
+    DeviceSampleCount = (Uint32)(outputSize / AudioManager::BytesPerSample);
+    Memory::Track(DeviceSamples, outputSize, "ISound::DeviceSamples");
+
+    Log::Print(Log::LOG_VERBOSE, "Sound pre-decode took %.3f ms (%u bytes)", Clock::GetTicks() - ticks, (Uint32)outputSize);
+    return true;
+}
+
 PUBLIC void ISound::Dispose() {
+    if (DeviceSamples) {
+        // Channels may still be reading from them
+        AudioManager::AudioStop(this);
 
+        Memory::Free(DeviceSamples);
+        DeviceSamples = NULL;
+        DeviceSampleCount = 0;
+    }
 }
@@ -9,6 +9,8 @@ public:
 
     Texture*          Spritesheets[32];
     bool              SpritesheetsBorrowed[32];
+    int               SpritesheetsAtlasX[32];
+    int               SpritesheetsAtlasY[32];
     char              SpritesheetsFilenames[128][32];
     int               SpritesheetCount = 0;
     int               CollisionBoxCount = 0;
@@ -23,6 +25,7 @@ public:
 
 #include <Engine/Application.h>
 #include <Engine/Graphics.h>
+#include <Engine/Rendering/TextureAtlas.h>
 
 #include <Engine/ResourceTypes/ImageFormats/GIF.h>
 #include <Engine/ResourceTypes/ImageFormats/JPEG.h>
@@ -40,11 +43,15 @@ public:
 PUBLIC ISprite::ISprite() {
     memset(Spritesheets, 0, sizeof(Spritesheets));
     memset(SpritesheetsBorrowed, 0, sizeof(SpritesheetsBorrowed));
+    memset(SpritesheetsAtlasX, 0, sizeof(SpritesheetsAtlasX));
+    memset(SpritesheetsAtlasY, 0, sizeof(SpritesheetsAtlasY));
     memset(Filename, 0, 256);
 }
 PUBLIC ISprite::ISprite(const char* filename) {
     memset(Spritesheets, 0, sizeof(Spritesheets));
     memset(SpritesheetsBorrowed, 0, sizeof(SpritesheetsBorrowed));
+    memset(SpritesheetsAtlasX, 0, sizeof(SpritesheetsAtlasX));
+    memset(SpritesheetsAtlasY, 0, sizeof(SpritesheetsAtlasY));
     memset(Filename, 0, 256);
 
     strncpy(Filename, filename, 255);
@@ -52,6 +59,11 @@ PUBLIC ISprite::ISprite(const char* filename) {
 }
 
 PUBLIC STATIC Texture* ISprite::AddSpriteSheet(const char* filename) {
+    return AddSpriteSheet(filename, NULL, NULL);
+}
+// If atlasX and atlasY are given, the sheet may be packed into a texture atlas
+// page instead, and they are set to where the sheet is in the returned texture.
+PUBLIC STATIC Texture* ISprite::AddSpriteSheet(const char* filename, int* atlasX, int* atlasY) {
     Texture* texture = NULL;
     Uint32*  data = NULL;
     Uint32   width = 0;
@@ -61,6 +73,16 @@ PUBLIC STATIC Texture* ISprite::AddSpriteSheet(const char* filename) {
 
     const char* altered = filename;
 
+    bool useAtlas = atlasX && atlasY;
+    if (useAtlas) {
+        *atlasX = 0;
+        *atlasY = 0;
+
+        texture = TextureAtlas::Find(altered, atlasX, atlasY);
+        if (texture)
+            return texture;
+    }
+
     if (Graphics::SpriteSheetTextureMap->Exists(altered)) {
         texture = Graphics::SpriteSheetTextureMap->Get(altered);
         return texture;
@@ -144,6 +166,16 @@ PUBLIC STATIC Texture* ISprite::AddSpriteSheet(const char* filename) {
 
     bool forceSoftwareTextures = false;
     Application::Settings->GetBool("display", "forceSoftwareTextures", &forceSoftwareTextures);
+
+    // Paletted sheets keep their own textures, since a page can only have one palette
+    if (useAtlas && !paletteColors && !forceSoftwareTextures) {
+        texture = TextureAtlas::Add(altered, data, width, height, atlasX, atlasY);
+        if (texture) {
+            Memory::Free(data);
+            return texture;
+        }
+    }
+
     if (forceSoftwareTextures)
         Graphics::NoInternalTextures = true;
 
@@ -189,8 +221,8 @@ PUBLIC void ISprite::AddFrame(int animID, int duration, int left, int top, int w
     AnimFrame anfrm;
     anfrm.Advance = id;
     anfrm.Duration = duration;
-    anfrm.X = left;
-    anfrm.Y = top;
+    anfrm.X = left + SpritesheetsAtlasX[0];
+    anfrm.Y = top + SpritesheetsAtlasY[0];
     anfrm.Width = width;
     anfrm.Height = height;
     anfrm.OffsetX = pivotX;
@@ -209,14 +241,48 @@ PUBLIC void ISprite::RemoveFrames(int animID) {
     Animations[animID].Frames.clear();
 }
 
+// Gives a sheet packed into an atlas page a texture of its own again, so that
+// changing it won't touch the other sheets on that page.
+PUBLIC void ISprite::DetachFromAtlas(int sheet) {
+    if (!TextureAtlas::IsPage(Spritesheets[sheet]))
+        return;
+
+    int atlasX = SpritesheetsAtlasX[sheet];
+    int atlasY = SpritesheetsAtlasY[sheet];
+    Texture* texture = TextureAtlas::Extract(Spritesheets[sheet], atlasX, atlasY);
+    if (!texture)
+        return;
+
+    Spritesheets[sheet] = texture;
+    SpritesheetsBorrowed[sheet] = false;
+    SpritesheetsAtlasX[sheet] = 0;
+    SpritesheetsAtlasY[sheet] = 0;
+
+    for (size_t a = 0; a < Animations.size(); a++) {
+        for (size_t i = 0; i < Animations[a].Frames.size(); i++) {
+            AnimFrame* anfrm = &Animations[a].Frames[i];
+            if (anfrm->SheetNumber != sheet)
+                continue;
+
+            anfrm->X -= atlasX;
+            anfrm->Y -= atlasY;
+
+            Graphics::DeleteFrameBufferID(anfrm);
+            Graphics::MakeFrameBufferID(this, anfrm);
+        }
+    }
+}
+
 PUBLIC void ISprite::ConvertToRGBA() {
     for (int a = 0; a < SpritesheetCount; a++) {
-        if (Spritesheets[a])
+        // Atlas pages are never paletted
+        if (Spritesheets[a] && !TextureAtlas::IsPage(Spritesheets[a]))
             Graphics::ConvertTextureToRGBA(Spritesheets[a]);
     }
 }
 PUBLIC void ISprite::ConvertToPalette(unsigned paletteNumber) {
     for (int a = 0; a < SpritesheetCount; a++) {
+        DetachFromAtlas(a);
         if (Spritesheets[a])
             Graphics::ConvertTextureToPalette(Spritesheets[a], paletteNumber);
     }
@@ -272,7 +338,9 @@ PUBLIC bool ISprite::LoadAnimation(const char* filename) {
         if (Graphics::SpriteSheetTextureMap->Exists(altered))
             SpritesheetsBorrowed[i] = true;
 
-        Spritesheets[i] = AddSpriteSheet(altered);
+        Spritesheets[i] = AddSpriteSheet(altered, &SpritesheetsAtlasX[i], &SpritesheetsAtlasY[i]);
+        if (TextureAtlas::IsPage(Spritesheets[i]))
+            SpritesheetsBorrowed[i] = true;
         // Spritesheets[i] = Image::LoadTextureFromResource(altered);
     }
 
@@ -328,6 +396,11 @@ PUBLIC bool ISprite::LoadAnimation(const char* filename) {
             anfrm.OffsetX = reader->ReadInt16();
             anfrm.OffsetY = reader->ReadInt16();
 
+            if (anfrm.SheetNumber < SpritesheetCount) {
+                anfrm.X += SpritesheetsAtlasX[anfrm.SheetNumber];
+                anfrm.Y += SpritesheetsAtlasY[anfrm.SheetNumber];
+            }
+
             anfrm.BoxCount = this->CollisionBoxCount;
             if (anfrm.BoxCount) {
                 anfrm.Boxes = (CollisionBox*)Memory::Malloc(anfrm.BoxCount * sizeof(CollisionBox));
@@ -421,6 +494,10 @@ PUBLIC bool ISprite::SaveAnimation(const char* filename) {
 
         for (size_t i = 0; i < an.Frames.size(); i++) {
             AnimFrame anfrm = an.Frames[i];
+            if (anfrm.SheetNumber < SpritesheetCount) {
+                anfrm.X -= SpritesheetsAtlasX[anfrm.SheetNumber];
+                anfrm.Y -= SpritesheetsAtlasY[anfrm.SheetNumber];
+            }
             stream->WriteByte(anfrm.SheetNumber);
             stream->WriteUInt16(anfrm.Duration);
             stream->WriteUInt16(anfrm.Advance);
@@ -24,10 +24,20 @@ public:
 #include <Engine/IO/Stream.h>
 #include <Engine/Application.h>
 
+#if defined(LINUX)
+    #define USE_MAPPED_DATA_PACKS
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
 #define KEEP_DATA_PACKS_IN_MEMORY
 
 struct      StreamNode {
     Stream*            Table;
+    Uint8*             Mapping;
+    size_t             MappingSize;
     struct StreamNode* Next;
 };
 StreamNode* StreamNodeHead = NULL;
@@ -38,6 +48,8 @@ struct  ResourceRegistryItem {
     Uint64  Size;
     Uint32  DataFlag;
     Uint64  CompressedSize;
+    Uint8*  Mapping;
+    size_t  MappingSize;
 };
 HashMap<ResourceRegistryItem>* ResourceRegistry = NULL;
 
@@ -93,6 +105,39 @@ PUBLIC STATIC void   ResourceManager::Init(const char* filename) {
         }
     }
 }
+// Maps the whole data pack into memory, so that resources stored in it as-is
+// can be read in place rather than copied out of it.
+PRIVATE STATIC Uint8* ResourceManager::MapDataPack(const char* path, size_t* size) {
+#ifdef USE_MAPPED_DATA_PACKS
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the file is closed
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    *size = (size_t)st.st_size;
+    return (Uint8*)mapping;
+#else
+    return NULL;
+#endif
+}
+PRIVATE STATIC void   ResourceManager::UnmapDataPack(Uint8* mapping, size_t size) {
+#ifdef USE_MAPPED_DATA_PACKS
+    if (mapping)
+        munmap(mapping, size);
+#endif
+}
+
 PUBLIC STATIC void   ResourceManager::Load(const char* filename) {
     if (!ResourceRegistry)
         return;
@@ -124,9 +169,14 @@ PUBLIC STATIC void   ResourceManager::Load(const char* filename) {
     // Add stream to list for closure on disposal
     StreamNode* streamNode = new StreamNode;
     streamNode->Table = dataTableStream;
+    streamNode->MappingSize = 0;
+    streamNode->Mapping = ResourceManager::MapDataPack(resourcePath, &streamNode->MappingSize);
     streamNode->Next = StreamNodeHead;
     StreamNodeHead = streamNode;
 
+    if (streamNode->Mapping)
+        Log::Print(Log::LOG_VERBOSE, "Mapped \"%s\" into memory (%u bytes)", filename, (Uint32)streamNode->MappingSize);
+
     fileCount = dataTableStream->ReadUInt16();
     Log::Print(Log::LOG_VERBOSE, "Loading resource table from \"%s\"...", filename);
     for (int i = 0; i < fileCount; i++) {
@@ -136,7 +186,7 @@ PUBLIC STATIC void   ResourceManager::Load(const char* filename) {
         Uint32 dataFlag = dataTableStream->ReadUInt32();
         Uint64 compressedSize = dataTableStream->ReadUInt64();
 
-        ResourceRegistryItem item { dataTableStream, offset, size, dataFlag, compressedSize };
+        ResourceRegistryItem item { dataTableStream, offset, size, dataFlag, compressedSize, streamNode->Mapping, streamNode->MappingSize };
         ResourceRegistry->Put(crc32, item);
         // Log::Print(Log::LOG_VERBOSE, "%08X: Offset: %08llX Size: %08llX Comp Size: %08llX Data Flag: %08X", crc32, offset, size, compressedSize, dataFlag);
     }
@@ -272,6 +322,28 @@ PUBLIC STATIC bool   ResourceManager::LoadResource(const char* filename, Uint8**
     *size = rwSize;
     return true;
 }
+// Gets a read-only view of a resource inside a mapped data pack, if it is
+// stored there uncompressed and unencrypted. The memory belongs to the data
+// pack and must not be freed. Returns false if the resource has to be
+// loaded with LoadResource instead.
+PUBLIC STATIC bool   ResourceManager::MapResource(const char* filename, Uint8** out, size_t* size) {
+    if (ResourceManager::UsingDataFolder && !ResourceManager::UsingModPack)
+        return false;
+
+    if (!ResourceRegistry || !ResourceRegistry->Exists(filename))
+        return false;
+
+    ResourceRegistryItem item = ResourceRegistry->Get(filename);
+    if (!item.Mapping || item.Size != item.CompressedSize || item.DataFlag == 2)
+        return false;
+
+    if (item.Offset > item.MappingSize || item.Size > item.MappingSize - item.Offset)
+        return false;
+
+    *out = item.Mapping + item.Offset;
+    *size = (size_t)item.Size;
+    return true;
+}
 PUBLIC STATIC bool   ResourceManager::ResourceExists(const char* filename) {
     char resourcePath[256];
     if (ResourceManager::UsingDataFolder && !ResourceManager::UsingModPack)
@@ -302,6 +374,7 @@ PUBLIC STATIC void   ResourceManager::Dispose() {
             streamNode = streamNode->Next;
 
             old->Table->Close();
+            ResourceManager::UnmapDataPack(old->Mapping, old->MappingSize);
             delete old;
         }
     }
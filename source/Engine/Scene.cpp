@@ -20,6 +20,7 @@
 #include <Engine/Scene/TileAnimation.h>
 
 #include <Engine/Scene/View.h>
+#include <Engine/Scene/SpatialGrid.h>
 #include <Engine/Diagnostics/PerformanceTypes.h>
 
 need_t Entity;
@@ -47,6 +48,8 @@ public:
     static Entity*                   ObjectFirst;
     static Entity*                   ObjectLast;
 
+    static SpatialGrid               EntityGrid;
+
     static int                       BasePriorityPerLayer;
     static int                       PriorityPerLayer;
     static DrawGroupList*            PriorityLists;
@@ -211,6 +214,8 @@ int                       Scene::ObjectCount = 0;
 Entity*                   Scene::ObjectFirst = NULL;
 Entity*                   Scene::ObjectLast = NULL;
 
+SpatialGrid               Scene::EntityGrid;
+
 // Tile variables
 vector<Tileset>           Scene::Tilesets;
 vector<TileSpriteInfo>    Scene::TileSpriteInfos;
@@ -602,6 +607,9 @@ PUBLIC STATIC void Scene::AddToScene(Entity* obj) {
 
     Scene::ObjectLast = obj;
     Scene::ObjectCount++;
+
+    if (!Scene::EntityGrid.NeedsRebuild)
+        Scene::EntityGrid.Insert(obj);
 }
 PUBLIC STATIC void Scene::RemoveFromScene(Entity* obj) {
     if (Scene::ObjectFirst == obj)
@@ -617,6 +625,8 @@ PUBLIC STATIC void Scene::RemoveFromScene(Entity* obj) {
     obj->PrevSceneEntity = obj->NextSceneEntity = NULL;
 
     Scene::ObjectCount--;
+
+    Scene::EntityGrid.Remove(obj);
 }
 PRIVATE STATIC void Scene::RemoveObject(Entity* obj) {
     // Remove from proper list
@@ -636,6 +646,15 @@ PRIVATE STATIC void Scene::RemoveObject(Entity* obj) {
     // won't be in any object list or draw groups at this point.
     obj->Remove();
 }
+// Finds entities whose hitbox overlaps a box. The grid is rebuilt from the
+// entities' positions at most once per frame, on the first query, and
+// entities that move out of their cells after that are moved on later ones.
+PUBLIC STATIC void Scene::GetEntitiesInBox(float left, float top, float right, float bottom, ObjectList* list, Entity* exclude, vector<Entity*>* results) {
+    if (Scene::EntityGrid.NeedsRebuild)
+        Scene::EntityGrid.Build(Scene::ObjectFirst);
+
+    Scene::EntityGrid.Query(left, top, right, bottom, list, exclude, results);
+}
 PUBLIC STATIC void Scene::Clear(Entity** first, Entity** last, int* count) {
     (*first) = NULL;
     (*last) = NULL;
@@ -762,6 +781,9 @@ PUBLIC STATIC void Scene::ResetPerf() {
     }
 }
 PUBLIC STATIC void Scene::Update() {
+    // Entities have moved since the last frame
+    Scene::EntityGrid.Clear();
+
     // Animate tiles
     Scene::RunTileAnimations();
 
@@ -1385,8 +1407,10 @@ PUBLIC STATIC void Scene::Restart() {
 
     if (Scene::AnyLayerTileChange) {
         // Copy backup tiles into main tiles
-        for (int l = 0; l < (int)Layers.size(); l++)
+        for (int l = 0; l < (int)Layers.size(); l++) {
             memcpy(Layers[l].Tiles, Layers[l].TilesBackup, Layers[l].DataSize);
+            Layers[l].TileVersion++;
+        }
         Scene::AnyLayerTileChange = false;
     }
 
@@ -2577,6 +2601,7 @@ PUBLIC STATIC void Scene::Dispose() {
     Scene::ObjectCount = 0;
     Scene::ObjectFirst = NULL;
     Scene::ObjectLast = NULL;
+    Scene::EntityGrid.Clear();
 
     // Free Priority Lists
     Scene::FreePriorityLists();
@@ -2642,6 +2667,8 @@ PUBLIC STATIC void Scene::SetTile(int layer, int x, int y, int tileID, int flip_
         *tile |= TILE_FLIPY_MASK;
     *tile |= collA << 28;
     *tile |= collB << 26;
+
+    Scene::Layers[layer].TileVersion++;
 }
 
 // Tile Collision
@@ -5,6 +5,8 @@
 #include <Engine/Scene/ScrollingInfo.h>
 #include <Engine/Scene/ScrollingIndex.h>
 
+need_t TileLayerCache;
+
 class SceneLayer {
 public:
     char              Name[50];
@@ -63,6 +65,10 @@ public:
     int               VertexCount = 0;
     void*             TileBatches = NULL;
 
+    bool              UseRenderCache = false;
+    Uint32            TileVersion = 0;
+    TileLayerCache*   RenderCache = NULL;
+
     enum {
         FLAGS_COLLIDEABLE = 1,
         FLAGS_NO_REPEAT_X = 2,
@@ -74,6 +80,7 @@ public:
 #include <Engine/Scene/SceneLayer.h>
 #include <Engine/Diagnostics/Memory.h>
 #include <Engine/Math/Math.h>
+#include <Engine/Rendering/Software/TileLayerCache.h>
 
 PUBLIC         SceneLayer::SceneLayer() {
 
@@ -125,6 +132,9 @@ PUBLIC void    SceneLayer::Dispose() {
     if (ScrollInfosSplitIndexes)
         Memory::Free(ScrollInfosSplitIndexes);
 
+    if (RenderCache)
+        delete RenderCache;
+
     Memory::Free(Tiles);
     Memory::Free(TilesBackup);
     Memory::Free(ScrollIndexes);
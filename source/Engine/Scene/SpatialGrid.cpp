@@ -0,0 +1,215 @@
+#if INTERFACE
+#include <Engine/Includes/Standard.h>
+
+need_t Entity;
+need_t ObjectList;
+
+class SpatialGrid {
+private:
+    struct Placement {
+        float Left;
+        float Top;
+        float Right;
+        float Bottom;
+        bool  InCells;
+        bool  Oversized;
+    };
+
+    vector<Entity*>     Entities;
+    vector<Placement>   Placements;
+    vector<Uint32>      QueryMarks;
+    vector<vector<int>> Buckets;
+    vector<int>         Oversized;
+    Uint32              QueryMark = 0;
+
+public:
+    float               CellSize = 64.0f;
+    bool                NeedsRebuild = true;
+};
+#endif
+
+#include <Engine/Scene/SpatialGrid.h>
+#include <Engine/Types/Entity.h>
+
+// Must be a power of two
+#define SPATIAL_GRID_BUCKETS 1024
+// Entities spanning more cells than this are kept in a separate list
+// that every query looks at.
+#define SPATIAL_GRID_MAX_CELLS 64
+// How far (in pixels) an entity can move after the grid is built and still
+// be found in the cells it was put in.
+#define SPATIAL_GRID_MARGIN 16.0f
+
+// Entities are hashed into a fixed number of buckets by the cells their
+// hitbox covers, so the grid has no bounds and doesn't need to know the
+// size of the scene. Hash collisions only add candidates; queries always
+// test the entity's current hitbox before returning it.
+//
+// Scripts write entity positions and hitboxes directly, so the grid can't
+// be told when they change. Instead, every query first puts entities whose
+// hitbox has left the area they were bucketed for into the cells they cover
+// now. Their old bucket entries are left behind as extra candidates.
+PUBLIC SpatialGrid::SpatialGrid() {
+    Buckets.resize(SPATIAL_GRID_BUCKETS);
+}
+
+PRIVATE STATIC bool SpatialGrid::GetHitbox(Entity* ent, float* left, float* top, float* right, float* bottom) {
+    if (ent->HitboxW == 0.0f || ent->HitboxH == 0.0f)
+        return false;
+
+    float cx = ent->X + ent->HitboxOffX;
+    float cy = ent->Y + ent->HitboxOffY;
+    float hw = fabs(ent->HitboxW) * 0.5f;
+    float hh = fabs(ent->HitboxH) * 0.5f;
+    *left = cx - hw;
+    *top = cy - hh;
+    *right = cx + hw;
+    *bottom = cy + hh;
+    return true;
+}
+PRIVATE int SpatialGrid::GetCell(float value) {
+    return (int)floor(value / CellSize);
+}
+PRIVATE STATIC Uint32 SpatialGrid::GetBucket(int cellX, int cellY) {
+    return (((Uint32)cellX * 73856093U) ^ ((Uint32)cellY * 19349663U)) & (SPATIAL_GRID_BUCKETS - 1);
+}
+
+PUBLIC void SpatialGrid::Clear() {
+    for (size_t i = 0; i < Entities.size(); i++) {
+        if (Entities[i])
+            Entities[i]->SpatialGridIndex = -1;
+    }
+    for (size_t i = 0; i < Buckets.size(); i++)
+        Buckets[i].clear();
+
+    Entities.clear();
+    Placements.clear();
+    QueryMarks.clear();
+    Oversized.clear();
+    NeedsRebuild = true;
+}
+PUBLIC void SpatialGrid::Build(Entity* first) {
+    Clear();
+    for (Entity* ent = first; ent; ent = ent->NextSceneEntity)
+        Insert(ent);
+    NeedsRebuild = false;
+}
+PUBLIC void SpatialGrid::Insert(Entity* ent) {
+    int index = (int)Entities.size();
+    Entities.push_back(ent);
+    QueryMarks.push_back(QueryMark);
+    ent->SpatialGridIndex = index;
+
+    Placement placement;
+    placement.InCells = false;
+    placement.Oversized = false;
+    Placements.push_back(placement);
+
+    Place(index);
+}
+PRIVATE void SpatialGrid::Place(int index) {
+    Placement* placement = &Placements[index];
+    float left, top, right, bottom;
+    if (!GetHitbox(Entities[index], &left, &top, &right, &bottom))
+        return;
+
+    placement->Left = left - SPATIAL_GRID_MARGIN;
+    placement->Top = top - SPATIAL_GRID_MARGIN;
+    placement->Right = right + SPATIAL_GRID_MARGIN;
+    placement->Bottom = bottom + SPATIAL_GRID_MARGIN;
+
+    int cellX1 = GetCell(placement->Left);
+    int cellY1 = GetCell(placement->Top);
+    int cellX2 = GetCell(placement->Right);
+    int cellY2 = GetCell(placement->Bottom);
+
+    if (((Sint64)cellX2 - cellX1 + 1) * ((Sint64)cellY2 - cellY1 + 1) > SPATIAL_GRID_MAX_CELLS) {
+        placement->Oversized = true;
+        Oversized.push_back(index);
+        return;
+    }
+
+    placement->InCells = true;
+    for (int cy = cellY1; cy <= cellY2; cy++) {
+        for (int cx = cellX1; cx <= cellX2; cx++)
+            Buckets[GetBucket(cx, cy)].push_back(index);
+    }
+}
+PRIVATE void SpatialGrid::Refresh() {
+    for (size_t i = 0; i < Entities.size(); i++) {
+        Entity* ent = Entities[i];
+        Placement* placement = &Placements[i];
+        if (!ent || placement->Oversized)
+            continue;
+
+        float left, top, right, bottom;
+        if (!GetHitbox(ent, &left, &top, &right, &bottom))
+            continue;
+
+        if (placement->InCells
+            && left >= placement->Left && right <= placement->Right
+            && top >= placement->Top && bottom <= placement->Bottom)
+            continue;
+
+        Place((int)i);
+    }
+}
+PUBLIC void SpatialGrid::Remove(Entity* ent) {
+    int index = ent->SpatialGridIndex;
+    if (index < 0 || (size_t)index >= Entities.size() || Entities[index] != ent)
+        return;
+
+    Entities[index] = NULL;
+    ent->SpatialGridIndex = -1;
+}
+
+PRIVATE void SpatialGrid::TestCandidate(int index, float left, float top, float right, float bottom, ObjectList* list, Entity* exclude, vector<Entity*>* results) {
+    if (QueryMarks[index] == QueryMark)
+        return;
+    QueryMarks[index] = QueryMark;
+
+    Entity* ent = Entities[index];
+    if (!ent || ent == exclude || !ent->Active || ent->Removed)
+        return;
+    if (list && ent->List != list)
+        return;
+
+    float entLeft, entTop, entRight, entBottom;
+    if (!GetHitbox(ent, &entLeft, &entTop, &entRight, &entBottom))
+        return;
+
+    if (entLeft < right && entRight > left && entTop < bottom && entBottom > top)
+        results->push_back(ent);
+}
+// Adds every active entity whose hitbox overlaps the given box to results,
+// optionally only those in the given object list.
+PUBLIC void SpatialGrid::Query(float left, float top, float right, float bottom, ObjectList* list, Entity* exclude, vector<Entity*>* results) {
+    if (++QueryMark == 0) {
+        std::fill(QueryMarks.begin(), QueryMarks.end(), 0);
+        QueryMark = 1;
+    }
+
+    Refresh();
+
+    int cellX1 = GetCell(left);
+    int cellY1 = GetCell(top);
+    int cellX2 = GetCell(right);
+    int cellY2 = GetCell(bottom);
+
+    // A box this large touches most buckets anyway
+    if (((Sint64)cellX2 - cellX1 + 1) * ((Sint64)cellY2 - cellY1 + 1) > SPATIAL_GRID_BUCKETS) {
+        for (size_t i = 0; i < Entities.size(); i++)
+            TestCandidate((int)i, left, top, right, bottom, list, exclude, results);
+        return;
+    }
+
+    for (int cy = cellY1; cy <= cellY2; cy++) {
+        for (int cx = cellX1; cx <= cellX2; cx++) {
+            vector<int>& bucket = Buckets[GetBucket(cx, cy)];
+            for (size_t i = 0; i < bucket.size(); i++)
+                TestCandidate(bucket[i], left, top, right, bottom, list, exclude, results);
+        }
+    }
+    for (size_t i = 0; i < Oversized.size(); i++)
+        TestCandidate(Oversized[i], left, top, right, bottom, list, exclude, results);
+}
@@ -104,6 +104,7 @@ public:
     int          CollisionMode = 0;
     
     int          SlotID = -1;
+    int          SpatialGridIndex = -1;
 
     bool         Removed = false;
 